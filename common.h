@@ -27,6 +27,11 @@
 
 #define TEX_MATRICES  0
 
+#define TRANSFORM_THREADS       256
+#define TRANSFORM_SSBO_OBJECTS  0
+#define TRANSFORM_SSBO_ORDER    1
+#define TRANSFORM_SSBO_MATRICES 2
+
 #if defined(GL_core_profile) || defined(GL_compatibility_profile) || defined(GL_es_profile)
 
 #extension GL_ARB_bindless_texture : enable
@@ -49,6 +54,15 @@ struct SceneData {
   vec4  viewDir;
 };
 
+// input of transform.comp.glsl, one per object
+struct TransformObject {
+  vec4  rows[3];  // local matrix relative to the parent, rows of the affine part
+  int   parent;   // within the chunk, -1 for roots
+  float spin;     // relative speed of the rotation around the local y axis
+  int   _pad0;
+  int   _pad1;
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,8 +36,19 @@ layout(binding=CULLSYS_SSBO_MATRICES, std430) readonly buffer matricesBuffer {
 layout(binding=CULLSYS_SSBO_BBOXES, std430) readonly buffer bboxBuffer {
   BboxData bboxes[];
 };
+layout(binding=CULLSYS_SSBO_INPUT_BBOX, std430) readonly buffer bboxIndexBuffer {
+  int bboxIndices[];
+};
+#else
+layout(binding=CULLSYS_SSBO_INPUT_BBOX, std430) readonly buffer bboxBuffer {
+  BboxData bboxes[];
+};
 #endif
 
+layout(binding=CULLSYS_SSBO_INPUT_MATRIX, std430) readonly buffer matrixIndexBuffer {
+  int matrixIndices[];
+};
+
 layout(std430,binding=CULLSYS_SSBO_OUT_VIS) writeonly buffer visibleBuffer {
   int visibles[];
 };
@@ -48,24 +59,21 @@ layout(binding=CULLSYS_TEX_DEPTH) uniform sampler2D depthTex;
 
 //////////////////////////////////////////////
 
+void main (){
+  bool isVisible = false;
+  int  objectID  = gl_VertexID;
+  
+  int  matrixIndex = matrixIndices[objectID];
 #ifdef DUALINDEX
-layout(location=0) in int  bboxIndex;
-layout(location=2) in int  matrixIndex;
-
-uniform samplerBuffer     bboxesTex;
-vec4 bboxMin = texelFetch(bboxesTex, bboxIndex*2+0);
-vec4 bboxMax = texelFetch(bboxesTex, bboxIndex*2+1);
+  int  bboxIndex   = bboxIndices[objectID];
 #else
-layout(location=0) in vec4 bboxMin;
-layout(location=1) in vec4 bboxMax;
-layout(location=2) in int  matrixIndex;
+  int  bboxIndex   = objectID;
 #endif
 
-//////////////////////////////////////////////
-
-void main (){
-  bool isVisible = false;
-  mat4 worldTM = matrices[matrixIndex].worldTM;
+  vec4 bboxMin     = getBboxMin(bboxes[bboxIndex]);
+  vec4 bboxMax     = getBboxMax(bboxes[bboxIndex]);
+  
+  mat4 worldTM = getWorldTM(matrices[matrixIndex]);
     
   mat4 worldViewProjTM = (view.viewProjTM * worldTM);
   
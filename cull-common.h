@@ -18,21 +18,51 @@
  */
 
 
+// 1: 48 instead of 128 bytes per object in MatrixData and the
+// matrix texture of the scene, at the cost of an inverse when needed
+#ifndef CULLSYS_MATRIX_COMPACT
+#define CULLSYS_MATRIX_COMPACT 0
+#endif
+
+// 1: 16 instead of 32 bytes per BboxData, object-space boxes are stored
+// as 16-bit integers within a frame (min, scale) shared by all boxes
+// of a job, which is passed as uniform
+#ifndef CULLSYS_BBOX_QUANTIZED
+#define CULLSYS_BBOX_QUANTIZED 0
+#endif
+
+#define CULLSYS_UNIFORM_BBOX_FRAME  8
+
 #ifdef __cplusplus
 namespace cullsys_glsl
 {
   using namespace glm;
 #endif
 
+#if CULLSYS_MATRIX_COMPACT
+// affine world matrix only, stored as its first three rows,
+// the inverse is reconstructed on demand
+struct MatrixData {
+  vec4    worldRows[3];
+};
+#else
 struct MatrixData {
   mat4    worldTM;
   mat4    worldInvTransTM;
 };
+#endif
 
+#if CULLSYS_BBOX_QUANTIZED
+// min.x | min.y << 16, min.z | max.x << 16, max.y | max.z << 16, unused
+struct BboxData {
+  uvec4   bboxPacked;
+};
+#else
 struct BboxData {
   vec4    bboxMin;
   vec4    bboxMax;
 };
+#endif
 
 struct ViewData {
   mat4    viewProjTM;
@@ -99,6 +129,75 @@ struct ViewData {
     vec2 dim = (clipmax.xy - clipmin.xy) * 0.5 * viewSize;;
     return  max(dim.x, dim.y) < viewCullThreshold;
   }
+  
+  // only the upper 3x3 of an affine matrix needs a real inverse
+  mat4 getAffineInvTrans(mat4 worldTM)
+  {
+    mat3 linearInv  = inverse(mat3(worldTM));
+    mat3 linearInvT = transpose(linearInv);
+    vec3 transInv   = -(linearInv * worldTM[3].xyz);
+    return mat4(vec4(linearInvT[0], transInv.x),
+                vec4(linearInvT[1], transInv.y),
+                vec4(linearInvT[2], transInv.z),
+                vec4(0,0,0,1));
+  }
+  
+  mat4 getWorldTM(MatrixData data)
+  {
+  #if CULLSYS_MATRIX_COMPACT
+    return transpose(mat4(data.worldRows[0], data.worldRows[1], data.worldRows[2], vec4(0,0,0,1)));
+  #else
+    return data.worldTM;
+  #endif
+  }
+  
+  mat4 getWorldInvTransTM(MatrixData data)
+  {
+  #if CULLSYS_MATRIX_COMPACT
+    return getAffineInvTrans(getWorldTM(data));
+  #else
+    return data.worldInvTransTM;
+  #endif
+  }
+  
+#if CULLSYS_BBOX_QUANTIZED
+  layout(location=CULLSYS_UNIFORM_BBOX_FRAME) uniform vec4 bboxFrame[2];
+#endif
+  
+  vec4 getBboxMin(BboxData data)
+  {
+  #if CULLSYS_BBOX_QUANTIZED
+    vec3 q = vec3(data.bboxPacked.x & 0xFFFFu, data.bboxPacked.x >> 16, data.bboxPacked.y & 0xFFFFu);
+    return vec4(bboxFrame[0].xyz + q * bboxFrame[1].xyz, 1);
+  #else
+    return data.bboxMin;
+  #endif
+  }
+  
+  vec4 getBboxMax(BboxData data)
+  {
+  #if CULLSYS_BBOX_QUANTIZED
+    vec3 q = vec3(data.bboxPacked.y >> 16, data.bboxPacked.z & 0xFFFFu, data.bboxPacked.z >> 16);
+    return vec4(bboxFrame[0].xyz + q * bboxFrame[1].xyz, 1);
+  #else
+    return data.bboxMax;
+  #endif
+  }
+  
+  MatrixData makeMatrixData(mat4 worldTM)
+  {
+    MatrixData data;
+  #if CULLSYS_MATRIX_COMPACT
+    mat4 rows = transpose(worldTM);
+    data.worldRows[0] = rows[0];
+    data.worldRows[1] = rows[1];
+    data.worldRows[2] = rows[2];
+  #else
+    data.worldTM         = worldTM;
+    data.worldInvTransTM = getAffineInvTrans(worldTM);
+  #endif
+    return data;
+  }
 #endif
 
 #define CULLSYS_UBO_VIEW            0
@@ -62,7 +62,7 @@ void main()
   uint directionIndex = IN[0].direction_matrixIndex;
   uint matrixIndex    = IN[0].direction_matrixIndex >> 3;
 
-  mat4 worldTM = matrices[matrixIndex].worldTM;
+  mat4 worldTM = getWorldTM(matrices[matrixIndex]);
 
   vec3 faceNormal = vec3(0);
   vec3 edgeBasis0 = vec3(0);
@@ -75,8 +75,8 @@ void main()
   int  bboxIndex   = objectID;
 #endif
 
-  vec4 bboxMin     = bboxes[bboxIndex].bboxMin;
-  vec4 bboxMax     = bboxes[bboxIndex].bboxMax;
+  vec4 bboxMin     = getBboxMin(bboxes[bboxIndex]);
+  vec4 bboxMax     = getBboxMax(bboxes[bboxIndex]);
   
   vec3 ctr =((bboxMin + bboxMax)*0.5).xyz;
   vec3 dim =((bboxMax - bboxMin)*0.5).xyz;
@@ -90,7 +90,7 @@ void main()
   // side faces will be visible, must treat object as 
   // visible
   
-  mat4 worldInvTransTM = matrices[matrixIndex].worldInvTransTM;
+  mat4 worldInvTransTM = getWorldInvTransTM(matrices[matrixIndex]);
     
   vec3 localViewPos = (vec4(view.viewPos,1) * worldInvTransTM).xyz;
   localViewPos -= ctr;
@@ -103,11 +103,14 @@ void main()
   else {
   // this could be disabled if you don't need it
   #if 1
-    #if 1
+    #if CULLSYS_MATRIX_COMPACT
+      // the compact data is loaded already, no inverse needed
+      mat4 worldTM = getWorldTM(matrices[matrixIndex]);
+    #elif 1
       // avoid loading data again (for precision you might prefer below)
       mat4 worldTM = inverse(transpose(worldInvTransTM));
     #else
-      mat4 worldTM = matrices[matrixIndex].worldTM;
+      mat4 worldTM = getWorldTM(matrices[matrixIndex]);
     #endif
       mat4 worldViewProjTM = view.viewProjTM * worldTM;
   
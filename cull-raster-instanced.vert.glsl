@@ -53,9 +53,11 @@ layout(binding=CULLSYS_SSBO_INPUT_MATRIX, std430) readonly buffer matrixIndexBuf
   int matrixIndices[];
 };
 
+#ifndef QUERIES
 layout(std430,binding=CULLSYS_SSBO_OUT_VIS) writeonly buffer visibleBuffer {
   int visibles[];
 };
+#endif
 
 //////////////////////////////////////////////
 
@@ -87,28 +89,38 @@ void main()
   int  bboxIndex   = objectID;
 #endif
 
-  vec4 bboxMin     = bboxes[bboxIndex].bboxMin;
-  vec4 bboxMax     = bboxes[bboxIndex].bboxMax;
+  vec4 bboxMin     = getBboxMin(bboxes[bboxIndex]);
+  vec4 bboxMax     = getBboxMax(bboxes[bboxIndex]);
 
   vec3 ctr =((bboxMin + bboxMax)*0.5).xyz;
   vec3 dim =((bboxMax - bboxMin)*0.5).xyz;
   
-  mat4 worldInvTransTM = matrices[matrixIndex].worldInvTransTM;
+  mat4 worldInvTransTM = getWorldInvTransTM(matrices[matrixIndex]);
     
   vec3 localViewPos = (vec4(view.viewPos,1) * worldInvTransTM).xyz;
   localViewPos -= ctr;
   if (all(lessThan(abs(localViewPos),dim))){
     // inside bbox
+  #ifdef QUERIES
+    // the occlusion query is the only result, so force samples to pass:
+    // triangles (2,3,7) and (7,6,2) of the index buffer become a
+    // full-screen quad on the near plane, the others degenerate.
+    gl_Position = vec4(vec2(boxVertexID & 1, (boxVertexID >> 2) & 1) * 4.0 - 1.0, -1, 1);
+  #else
     visibles[objectID] = 1;
     // skip rasterization of this box
     gl_Position = vec4(-2,-2,-2,1);
+  #endif
   }
   else {
-  #if 1
+  #if CULLSYS_MATRIX_COMPACT
+    // the compact data is loaded already, no inverse needed
+    mat4 worldTM = getWorldTM(matrices[matrixIndex]);
+  #elif 1
     // avoid loading data again (for precision you might prefer below)
     mat4 worldTM = inverse(transpose(worldInvTransTM));
   #else
-    mat4 worldTM = matrices[matrixIndex].worldTM;
+    mat4 worldTM = getWorldTM(matrices[matrixIndex]);
   #endif
     mat4 worldViewProjTM = view.viewProjTM * worldTM;
   
@@ -111,7 +111,7 @@ void main()
   uint objectRead      = isValid ? objectID : IN.baseID;
   int  matrixIndex     = matrixIndices[objectRead];
   
-  mat4 worldTM         = matrices[matrixIndex].worldTM;
+  mat4 worldTM         = getWorldTM(matrices[matrixIndex]);
   mat4 worldViewProjTM = view.viewProjTM * worldTM;
   
 #ifdef DUALINDEX
@@ -120,8 +120,8 @@ void main()
   int  bboxIndex   = int(objectRead);
 #endif
 
-  vec4 bboxMin     = bboxes[bboxIndex].bboxMin;
-  vec4 bboxMax     = bboxes[bboxIndex].bboxMax;
+  vec4 bboxMin     = getBboxMin(bboxes[bboxIndex]);
+  vec4 bboxMax     = getBboxMax(bboxes[bboxIndex]);
   
   // 4 threads per box (32/8)
   // needs two iterations for all 8 vertices
@@ -94,13 +94,13 @@ void main()
   int  bboxIndex   = int(objectRead);
 #endif
 
-  vec4 bboxMin     = bboxes[bboxIndex].bboxMin;
-  vec4 bboxMax     = bboxes[bboxIndex].bboxMax;
+  vec4 bboxMin     = getBboxMin(bboxes[bboxIndex]);
+  vec4 bboxMax     = getBboxMax(bboxes[bboxIndex]);
 
   vec3 ctr =((bboxMin + bboxMax)*0.5).xyz;
   vec3 dim =((bboxMax - bboxMin)*0.5).xyz;
   
-  mat4 worldInvTransTM = matrices[matrixIndex].worldInvTransTM;
+  mat4 worldInvTransTM = getWorldInvTransTM(matrices[matrixIndex]);
     
   vec3 localViewPos = (vec4(view.viewPos,1) * worldInvTransTM).xyz;
   localViewPos -= ctr;
@@ -113,11 +113,14 @@ void main()
       isValid = false;
     }
     else {
-    #if 1
+    #if CULLSYS_MATRIX_COMPACT
+      // the compact data is loaded already, no inverse needed
+      mat4 worldTM = getWorldTM(matrices[matrixIndex]);
+    #elif 1
       // avoid loading data again (for precision you might prefer below)
       mat4 worldTM = inverse(transpose(worldInvTransTM));
     #else
-      mat4 worldTM = matrices[matrixIndex].worldTM;
+      mat4 worldTM = getWorldTM(matrices[matrixIndex]);
     #endif
       mat4 worldViewProjTM = view.viewProjTM * worldTM;
     
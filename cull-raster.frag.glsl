@@ -24,9 +24,11 @@
 
 layout(early_fragment_tests) in;
 
+#ifndef QUERIES
 layout(std430,binding=CULLSYS_SSBO_OUT_VIS) buffer visibleBuffer {
   int visibles[];
 };
+#endif
 
 #if CULLSYS_DEBUG_VISIBLEBOXES
 layout(location=0,index=0) out vec4 out_Color;
@@ -37,7 +39,10 @@ layout(location=0) in Interpolant {
 } IN;
 
 void main (){
+#ifndef QUERIES
+  // with QUERIES the occlusion query of the drawcall provides the result
   visibles[IN.f_objectID] = 1;
+#endif
 #if CULLSYS_DEBUG_VISIBLEBOXES
   out_Color = unpackUnorm4x8(uint(IN.f_objectID) ^ uint(IN.f_objectID << 4));
 #endif
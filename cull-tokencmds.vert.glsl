@@ -22,17 +22,14 @@
 #version 440
 /**/
 
-#define SCAN_BATCHSIZE 2048
-
 layout(location=0) in uint  cmdOffset;
 layout(location=1) in uint  cmdCullSize;
 layout(location=2) in uint  cmdCullScan;
+layout(location=3) in uint  cmdSequence;
 
-uniform uint startOffset;
-uniform int  startID;
-uniform uint endOffset;
-uniform int  endID;
 uniform uint terminateCmd;
+// cullScan did not restart per sequence (ScanSystem fallback)
+uniform bool globalScan;
 
 layout(std430,binding=0)  writeonly buffer outputBuffer {
   uint outcmds[];
@@ -50,48 +47,44 @@ layout(std430,binding=3)  readonly buffer cullScanBuffer {
   uint cullScan[];
 };
 
-layout(std430,binding=4)  readonly buffer cullScanOffsetBuffer {
-  uint cullScanOffsets[];
+struct Sequence {
+  uint  offset;
+  uint  endoffset;
+  int   first;
+  int   num;
 };
 
-uint getOffset( int id, uint scan, uint size, bool exclusive)
-{
-  int scanBatch = id / SCAN_BATCHSIZE;
-  uint  scanOffset  = scan;
-        scanOffset += scanBatch > 0 ? cullScanOffsets[ scanBatch-1] : 0;
-  
-  if (exclusive){
-    scanOffset -= size;
-  }
-  return scanOffset;
-}
+layout(std430,binding=4)  readonly buffer sequenceBuffer {
+  Sequence sequences[];
+};
 
-uint getOffset( int id, bool exclusive)
-{
-  return getOffset(id, cullScan[id], cullSizes[id], exclusive);
-}
+// used 32-bit words of outcmds, including terminators
+layout(std430,binding=5)  buffer usedBuffer {
+  uint usedWords;
+};
 
-uint rebaseOffset(uint cullOffset)
+// cullScan is the inclusive prefix sum of cullSizes,
+// restarting at every sequence
+uint getOffset( uint scan, uint size, bool exclusive)
 {
-  // where the current sequence starts
-  uint startCullOffset = getOffset(startID, true);
-
-  // rebase from where it should start
-  uint outOffset    = startOffset + (cullOffset - startCullOffset);
-  
-  return outOffset;
+  return exclusive ? scan - size : scan;
 }
 
 #define DEBUG 0
 
 void main ()
 {
+  Sequence sequence = sequences[cmdSequence];
+  
+  uint scan = cmdCullScan;
+  if (globalScan && sequence.first > 0)
+  {
+    scan -= cullScan[sequence.first - 1];
+  }
+
   if (cmdCullSize > 0)
   {
-    // cullOffset goes across "stateobject" sequences
-    uint cullOffset = getOffset(gl_VertexID,cmdCullScan,cmdCullSize,true);
-  
-    uint outOffset  = rebaseOffset(cullOffset);
+    uint outOffset = sequence.offset + getOffset(scan,cmdCullSize,true);
     
   #if DEBUG
     outcmds[(gl_VertexID)*2+0] = outOffset;
@@ -109,19 +102,16 @@ void main ()
   }
 #endif
 
-  if (gl_VertexID == startID)
+  if (gl_VertexID == sequence.first + sequence.num - 1)
   {
     // add terminator if sequence not original
-    uint lastOffset = rebaseOffset( getOffset(endID, false) );
-    if (lastOffset != endOffset) {
+    uint lastOffset = sequence.offset + getOffset(scan,cmdCullSize,false);
+    if (lastOffset != sequence.endoffset) {
 #if !DEBUG
       outcmds[lastOffset] = terminateCmd;
 #endif
+      lastOffset++;
     }
-    
-#if DEBUG && 0
-    outcmds[(startID)*2+0] = lastOffset;
-    outcmds[(startID)*2+1] = endOffset;
-#endif
+    atomicMax(usedWords, lastOffset);
   }
 }
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2014-2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+
+#version 440
+/**/
+
+layout(location=0) in uint  cmdOffset;
+layout(location=1) in uint  cmdSize;
+layout(location=2) in int   cmdObject;
+
+uniform uint nopCmd;
+
+layout(std430,binding=0)  writeonly buffer outputBuffer {
+  uint outcmds[];
+};
+
+layout(std430,binding=1)  readonly buffer visibleBuffer {
+  int visibles[];
+};
+
+layout(std430,binding=2)  buffer visibleCounterBuffer {
+  uint visibleCount;
+};
+
+// outcmds starts as a copy of the original stream, only the tokens
+// of invisible objects are overwritten, each 32-bit becomes a NOP token
+
+void main ()
+{
+  if (cmdObject < 0) return;
+
+  if ((visibles[cmdObject/32] & (1<<(cmdObject%32))) != 0){
+    atomicAdd(visibleCount, 1);
+  }
+  else {
+    for (uint i = 0; i < cmdSize; i++){
+      outcmds[cmdOffset+i] = nopCmd;
+    }
+  }
+}
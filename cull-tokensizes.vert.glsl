@@ -33,12 +33,20 @@ layout(std430,binding=1)  readonly buffer visibleBuffer {
   int visibles[];
 };
 
+layout(std430,binding=2)  buffer visibleCounterBuffer {
+  uint visibleCount;
+};
+
 #define DEBUG false
 
 void main ()
 {
   if (cmdObject >= 0 && !DEBUG){
-    outsizes[gl_VertexID] = (visibles[cmdObject/32] & (1<<(cmdObject%32))) != 0 ? cmdSize : 0;
+    bool visible = (visibles[cmdObject/32] & (1<<(cmdObject%32))) != 0;
+    outsizes[gl_VertexID] = visible ? cmdSize : 0;
+    if (visible){
+      atomicAdd(visibleCount, 1);
+    }
   }
   else{
     outsizes[gl_VertexID] = cmdSize;
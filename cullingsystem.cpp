@@ -21,6 +21,7 @@
 /* Contact ckubisch@nvidia.com (Christoph Kubisch) for feedback */
 
 #include "cullingsystem.hpp"
+#include "uploadring.hpp"
 #include <assert.h>
 #include <string.h>
 
@@ -38,11 +39,13 @@ inline unsigned int minDivide(unsigned int val, unsigned int alignment)
 void CullingSystem::init(const Programs& programs, bool useDualIndex, RasterType rasterType, bool hasRepresentativeTest)
 {
   update(programs, useDualIndex, rasterType, hasRepresentativeTest);
+  m_queryLatency = 0;
   glGenFramebuffers(1, &m_fbo);
   glGenBuffers(1, &m_ubo);
   glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
   glBufferData(GL_UNIFORM_BUFFER, sizeof(View), nullptr, GL_DYNAMIC_DRAW);
   glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_uboAlignment);
 
   // The instanced renderer uses pre-computed uint16_t index buffer for bboxes
   // uint16_t indices provide extra performance on current NVIDIA hardware.
@@ -91,6 +94,19 @@ void CullingSystem::update(const Programs& programs, bool useDualIndex, RasterTy
 void CullingSystem::deinit()
 {
   glDeleteFramebuffers(1, &m_fbo);
+  glDeleteBuffers(1, &m_ubo);
+}
+
+void CullingSystem::deinitJob(Job& job)
+{
+  QueryPool& pool = job.m_queryPool;
+  if(pool.capacity)
+  {
+    glDeleteQueries(QUERY_FRAMES * pool.capacity, pool.queries);
+    free(pool.queries);
+    free(pool.results);
+  }
+  memset(&pool, 0, sizeof(pool));
 }
 
 void CullingSystem::buildDepthMipmaps(GLuint textureDepth, int width, int height)
@@ -143,7 +159,7 @@ void CullingSystem::buildDepthMipmaps(GLuint textureDepth, int width, int height
 }
 
 
-void CullingSystem::testBboxes(Job& job, bool raster)
+void CullingSystem::testBboxes(Job& job, bool raster, bool queries)
 {
   // send the scene's bboxes as points stream
   job.m_bufferVisOutput.BindBufferRange(GL_SHADER_STORAGE_BUFFER, CULLSYS_SSBO_OUT_VIS);
@@ -156,7 +172,11 @@ void CullingSystem::testBboxes(Job& job, bool raster)
   job.m_bufferObjectBbox.BindBufferRange(GL_SHADER_STORAGE_BUFFER, CULLSYS_SSBO_INPUT_BBOX);
   job.m_bufferObjectMatrix.BindBufferRange(GL_SHADER_STORAGE_BUFFER, CULLSYS_SSBO_INPUT_MATRIX);
 
-  if(raster && m_rasterType == RASTER_INSTANCED)
+#if CULLSYS_BBOX_QUANTIZED
+  glUniform4fv(CULLSYS_UNIFORM_BBOX_FRAME, 2, job.m_bboxFrame);
+#endif
+
+  if(raster && (queries || m_rasterType == RASTER_INSTANCED))
   {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_iboInstanced);
   }
@@ -178,7 +198,13 @@ void CullingSystem::testBboxes(Job& job, bool raster)
     glEnable(GL_RASTERIZER_DISCARD);
   }
 
-  if(raster && m_rasterType == RASTER_INSTANCED)
+  if(raster && queries)
+  {
+    issueQueries(job);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
+  else if(raster && m_rasterType == RASTER_INSTANCED)
   {
     int instanceCount = job.m_numObjects / CULLSYS_INSTANCED_BBOXES;
     int tailCount     = job.m_numObjects % CULLSYS_INSTANCED_BBOXES;
@@ -267,8 +293,19 @@ void CullingSystem::resultClient(Job& job)
 
 void CullingSystem::buildOutput(MethodType method, Job& job, const View& view)
 {
-  glBindBufferBase(GL_UNIFORM_BUFFER, CULLSYS_UBO_VIEW, m_ubo);
-  glBufferSubData(GL_UNIFORM_BUFFER, CULLSYS_UBO_VIEW, sizeof(View), &view);
+  // every job may use a different view, so each call gets its own range
+  size_t ringOffset;
+  void*  ringData = m_uploadRing ? m_uploadRing->alloc(sizeof(View), m_uboAlignment, ringOffset) : nullptr;
+  if(ringData)
+  {
+    memcpy(ringData, &view, sizeof(View));
+    glBindBufferRange(GL_UNIFORM_BUFFER, CULLSYS_UBO_VIEW, m_uploadRing->getBuffer(), ringOffset, sizeof(View));
+  }
+  else
+  {
+    glBindBufferBase(GL_UNIFORM_BUFFER, CULLSYS_UBO_VIEW, m_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(View), &view);
+  }
 
   switch(method)
   {
@@ -317,6 +354,18 @@ void CullingSystem::buildOutput(MethodType method, Job& job, const View& view)
       glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
     }
     break;
+    case METHOD_QUERIES: {
+      glUseProgram(m_programs.object_raster_query);
+
+      glEnable(GL_POLYGON_OFFSET_FILL);
+      glPolygonOffset(-1, -1);
+      testBboxes(job, true, true);
+      glPolygonOffset(0, 0);
+      glDisable(GL_POLYGON_OFFSET_FILL);
+
+      collectQueries(job);
+    }
+    break;
   }
 
   glBindBufferBase(GL_UNIFORM_BUFFER, CULLSYS_UBO_VIEW, 0);
@@ -336,6 +385,108 @@ void CullingSystem::setRasterType(RasterType rasterType)
   m_rasterType = rasterType;
 }
 
+void CullingSystem::setQueryLatency(int latency)
+{
+  m_queryLatency = latency < 0 ? 0 : (latency >= QUERY_FRAMES ? QUERY_FRAMES - 1 : latency);
+}
+
+void CullingSystem::setUploadRing(UploadRing* ring)
+{
+  m_uploadRing = ring;
+}
+
+void CullingSystem::issueQueries(Job& job)
+{
+  QueryPool& pool = job.m_queryPool;
+
+  if(job.m_numObjects > pool.capacity)
+  {
+    if(pool.capacity)
+    {
+      glDeleteQueries(QUERY_FRAMES * pool.capacity, pool.queries);
+      free(pool.queries);
+      free(pool.results);
+    }
+    pool.capacity = job.m_numObjects;
+    pool.queries  = (GLuint*)malloc(sizeof(GLuint) * QUERY_FRAMES * pool.capacity);
+    pool.results  = (uint32_t*)malloc(sizeof(uint32_t) * pool.capacity);
+    glCreateQueries(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, QUERY_FRAMES * pool.capacity, pool.queries);
+    memset(pool.issued, 0, sizeof(pool.issued));
+  }
+
+  int     slot    = pool.frame % QUERY_FRAMES;
+  GLuint* queries = pool.queries + slot * pool.capacity;
+
+  // the classic way, one drawcall and query per box
+  // (the instanced shader computes objectID from its objectOffset uniform)
+  for(int i = 0; i < job.m_numObjects; i++)
+  {
+    glUniform1i(0, i);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, queries[i]);
+    glDrawElements(GL_TRIANGLES, CULLSYS_INSTANCED_INDICES, GL_UNSIGNED_SHORT, nullptr);
+    glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+  }
+
+  pool.issued[slot] = job.m_numObjects;
+}
+
+void CullingSystem::collectQueries(Job& job)
+{
+  QueryPool& pool  = job.m_queryPool;
+  int        frame = pool.frame - m_queryLatency;
+  int        slot  = frame % QUERY_FRAMES;
+
+  pool.frame++;
+
+  if(frame < 0 || pool.issued[slot] != job.m_numObjects)
+  {
+    // nothing valid in flight, everything is visible
+    for(int i = 0; i < job.m_numObjects; i++)
+    {
+      pool.results[i] = 1;
+    }
+  }
+  else
+  {
+    GLuint* queries = pool.queries + slot * pool.capacity;
+
+    // queries complete in order, if the last is available all are
+    GLuint available = 1;
+    if(m_queryLatency)
+    {
+      glGetQueryObjectuiv(queries[job.m_numObjects - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+
+    for(int i = 0; i < job.m_numObjects; i++)
+    {
+      if(!available)
+      {
+        GLuint ready = 0;
+        glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &ready);
+        if(!ready)
+        {
+          pool.results[i] = 1;
+          continue;
+        }
+      }
+      // blocking if latency is 0
+      glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT, &pool.results[i]);
+    }
+  }
+
+  // same format as the shader-based methods, bitsFromOutput does the rest
+  if(m_uploadRing)
+  {
+    m_uploadRing->upload(job.m_bufferVisOutput.buffer, job.m_bufferVisOutput.offset, sizeof(uint32_t) * job.m_numObjects,
+                         pool.results);
+  }
+  else
+  {
+    glNamedBufferSubData(job.m_bufferVisOutput.buffer, job.m_bufferVisOutput.offset, sizeof(uint32_t) * job.m_numObjects,
+                         pool.results);
+  }
+}
+
 void CullingSystem::JobIndirectUnordered::resultFromBits(const Buffer& bufferVisBitsCurrent)
 {
   glUseProgram(m_program_indirect_compact);
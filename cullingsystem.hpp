@@ -25,6 +25,7 @@
 #include <cstdint>
 #include <nvgl/extensions_gl.hpp>
 
+class UploadRing;
 
 class CullingSystem
 {
@@ -58,6 +59,8 @@ public:
     GLuint object_raster_instanced;
     GLuint object_raster_geo;
     GLuint object_raster_mesh;
+    // instanced raster shaders built with QUERIES define
+    GLuint object_raster_query;
 
     GLuint bit_temporallast;
     GLuint bit_temporalnew;
@@ -70,6 +73,7 @@ public:
     METHOD_FRUSTUM,  // test boxes against frustum only
     METHOD_HIZ,      // test boxes against hiz texture
     METHOD_RASTER,   // test boxes against current dept-buffer of current fbo
+    METHOD_QUERIES,  // classic occlusion query per box against current depth-buffer (for comparison)
     NUM_METHODS,
   };
 
@@ -80,6 +84,9 @@ public:
     RASTER_MESH_SHADER,
   };
 
+  // the query pool holds results of up to this many frames in flight
+  static const int QUERY_FRAMES = 4;
+
   enum BitType
   {
     BITS_CURRENT,
@@ -134,18 +141,31 @@ public:
     }
   };
 
+  // METHOD_QUERIES only, one occlusion query per object and frame in flight
+  struct QueryPool
+  {
+    GLuint*   queries;  // QUERY_FRAMES * capacity
+    uint32_t* results;  // capacity
+    int       capacity;
+    int       issued[QUERY_FRAMES];
+    int       frame;
+  };
+
   class Job
   {
   public:
     int m_numObjects;
-    // world-space matrices {mat4 world, mat4 worldInverseTranspose}
+    // world-space matrices {mat4 world, mat4 worldInverseTranspose},
+    // or the first three rows of world with CULLSYS_MATRIX_COMPACT
     Buffer m_bufferMatrices;
-    Buffer m_bufferBboxes;  // only used in dualindex mode (2 x vec4)
+    Buffer m_bufferBboxes;  // only used in dualindex mode (BboxData)
                             // 1 32-bit integer per object (index)
     Buffer m_bufferObjectMatrix;
-    // object-space bounding box (2 x vec4)
+    // object-space bounding box (BboxData, 2 x vec4 unless quantized)
     // or 1 32-bit integer per object (dualindex mode)
     Buffer m_bufferObjectBbox;
+    // CULLSYS_BBOX_QUANTIZED only, min.xyz and scale.xyz of the boxes
+    float m_bboxFrame[8] = {0, 0, 0, 0, 1, 1, 1, 0};
 
     // 1 32-bit integer per object
     Buffer m_bufferVisOutput;
@@ -157,6 +177,9 @@ public:
     // for HiZ
     GLuint m_textureDepthWithMipmaps;
 
+    // every job keeps its own queries, so multiple jobs can be culled per frame
+    QueryPool m_queryPool = {};
+
     // derive from this class and implement this function how you want to
     // deal with the results that are provided in the buffer
     virtual void resultFromBits(const Buffer& bufferVisBitsCurrent) = 0;
@@ -244,6 +267,8 @@ public:
 
   void init(const Programs& programs, bool useDualIndex, RasterType rasterType, bool hasRepresentativeTest);
   void deinit();
+  // releases the queries of the job
+  void deinitJob(Job& job);
   void update(const Programs& programs, bool useDualIndex, RasterType rasterType, bool hasRepresentativeTest);
 
   // helper function for HiZ method, leaves fbo bound to 0
@@ -274,18 +299,35 @@ public:
 
   void setRasterType(RasterType rasterType);
 
+  // METHOD_QUERIES only
+  // 0 means results are fetched blocking within the same frame,
+  // otherwise the results of queries issued "latency" frames ago are used.
+  // Objects whose queries are not yet available are treated as visible.
+  void setQueryLatency(int latency);
+
+  // per-frame data (view and query results) is staged in the ring,
+  // without one it is written with implicitly synchronized updates
+  void setUploadRing(UploadRing* ring);
+
 private:
   // perform occlusion test for all bounding boxes provided in the job
-  void testBboxes(Job& job, bool raster);
+  void testBboxes(Job& job, bool raster, bool queries = false);
+  // one occlusion query per bounding box
+  void issueQueries(Job& job);
+  // query results into job.m_bufferVisOutput
+  void collectQueries(Job& job);
 
   Programs m_programs;
 
-  GLuint m_ubo;
-  GLuint m_fbo;
+  GLuint      m_ubo;
+  GLint       m_uboAlignment;
+  UploadRing* m_uploadRing = nullptr;
+  GLuint      m_fbo;
   GLuint m_iboInstanced;
   bool   m_useDualIndex;
   bool   m_useRepesentativeTest;
   RasterType   m_rasterType;
+  int          m_queryLatency;
 };
 
 #endif
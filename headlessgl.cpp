@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2014-2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2022 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+/* Contact ckubisch@nvidia.com (Christoph Kubisch) for feedback */
+
+#include "headlessgl.hpp"
+
+#include <nvgl/extensions_gl.hpp>
+#include <nvh/nvprint.hpp>
+
+#if HEADLESS_EGL
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <string.h>
+
+static bool hasExtension(const char* extensions, const char* name)
+{
+  size_t length = strlen(name);
+  for(const char* found = extensions ? strstr(extensions, name) : nullptr; found; found = strstr(found + length, name))
+  {
+    if((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == 0))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void* getProcAddress(const char* name)
+{
+  return (void*)eglGetProcAddress(name);
+}
+
+static EGLDisplay getDisplay()
+{
+  const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+  if(hasExtension(clientExtensions, "EGL_EXT_platform_device"))
+  {
+    auto queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    EGLDeviceEXT device;
+    EGLint       numDevices = 0;
+    if(queryDevices && getPlatformDisplay && queryDevices(1, &device, &numDevices) && numDevices > 0)
+    {
+      EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+      if(display != EGL_NO_DISPLAY)
+      {
+        return display;
+      }
+    }
+  }
+
+  if(hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+  {
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(getPlatformDisplay)
+    {
+      EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+      if(display != EGL_NO_DISPLAY)
+      {
+        return display;
+      }
+    }
+  }
+
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool HeadlessGL::init(int major, int minor, bool debug)
+{
+  EGLDisplay display = getDisplay();
+  EGLint     eglMajor;
+  EGLint     eglMinor;
+  if(display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor))
+  {
+    LOGE("headless: no EGL display\n");
+    return false;
+  }
+  m_display = display;
+
+  if(!eglBindAPI(EGL_OPENGL_API))
+  {
+    LOGE("headless: EGL %d.%d without desktop OpenGL\n", eglMajor, eglMinor);
+    deinit();
+    return false;
+  }
+
+  bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+  const EGLint configAttribs[] = {EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig    config;
+  EGLint       numConfigs = 0;
+  if(!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+  {
+    LOGE("headless: no EGL config\n");
+    deinit();
+    return false;
+  }
+
+  const EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                   major,
+                                   EGL_CONTEXT_MINOR_VERSION,
+                                   minor,
+                                   EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                   EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+                                   EGL_CONTEXT_OPENGL_DEBUG,
+                                   debug ? EGL_TRUE : EGL_FALSE,
+                                   EGL_NONE};
+  m_context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+  if(m_context == EGL_NO_CONTEXT)
+  {
+    LOGE("headless: could not create an OpenGL %d.%d context (0x%x)\n", major, minor, eglGetError());
+    deinit();
+    return false;
+  }
+
+  if(!surfaceless)
+  {
+    const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    m_surface                     = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    if(m_surface == EGL_NO_SURFACE)
+    {
+      LOGE("headless: could not create a pbuffer (0x%x)\n", eglGetError());
+      deinit();
+      return false;
+    }
+  }
+
+  EGLSurface surface = m_surface ? (EGLSurface)m_surface : EGL_NO_SURFACE;
+  if(!eglMakeCurrent(display, surface, surface, (EGLContext)m_context))
+  {
+    LOGE("headless: could not make the context current (0x%x)\n", eglGetError());
+    deinit();
+    return false;
+  }
+
+  load_GL(getProcAddress);
+  m_deviceName = (const char*)glGetString(GL_RENDERER);
+  LOGI("headless: %s, %s\n", m_deviceName, surfaceless ? "surfaceless" : "pbuffer");
+
+  return true;
+}
+
+void HeadlessGL::deinit()
+{
+  if(!m_display)
+  {
+    return;
+  }
+
+  EGLDisplay display = (EGLDisplay)m_display;
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if(m_surface)
+  {
+    eglDestroySurface(display, (EGLSurface)m_surface);
+  }
+  if(m_context)
+  {
+    eglDestroyContext(display, (EGLContext)m_context);
+  }
+  eglTerminate(display);
+
+  m_display    = nullptr;
+  m_context    = nullptr;
+  m_surface    = nullptr;
+  m_deviceName = "";
+}
+
+#else
+
+bool HeadlessGL::init(int major, int minor, bool debug)
+{
+  LOGE("headless: not supported in this build, it requires EGL\n");
+  return false;
+}
+
+void HeadlessGL::deinit() {}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2014-2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2022 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+/* Contact ckubisch@nvidia.com (Christoph Kubisch) for feedback */
+
+#ifndef HEADLESSGL_H__
+#define HEADLESSGL_H__
+
+class HeadlessGL
+{
+  /*
+    OpenGL context without a window, created through EGL, so the
+    benchmark runs on machines without a display.
+
+    The display comes from EGL_EXT_platform_device (first device),
+    EGL_MESA_platform_surfaceless or the default display, in that order.
+    With EGL_KHR_surfaceless_context the context has no surface at all,
+    otherwise a 1x1 pbuffer is made current. Either way there is no
+    usable default framebuffer, rendering must go to FBOs.
+
+    Only available when built with HEADLESS_EGL (Linux with libEGL),
+    init returns false otherwise.
+  */
+
+public:
+  // creates and makes current a compatibility profile context,
+  // then loads the GL functions and extensions
+  bool init(int major, int minor, bool debug);
+  void deinit();
+
+  const char* getDeviceName() const { return m_deviceName; }
+
+private:
+  void*       m_display    = nullptr;
+  void*       m_context    = nullptr;
+  void*       m_surface    = nullptr;
+  const char* m_deviceName = "";
+};
+
+#endif
@@ -22,6 +22,9 @@
 
 #include "nvtoken.hpp"
 
+#include <stdio.h>
+#include <unordered_map>
+
 namespace nvtoken
 {
 
@@ -32,6 +35,9 @@ namespace nvtoken
   GLuint   s_nvcmdlist_headerSizes[NVTOKEN_TYPES] = {0};
   GLushort s_nvcmdlist_stages[NVTOKEN_STAGES] = {0};
   bool     s_nvcmdlist_bindless  = false;
+  bool     s_nvcmdlist_batchingSW = true;
+  bool     s_nvcmdlist_filterSW   = true;
+  NVTokenStatsSW s_nvcmdlist_statsSW = {0};
   
   static inline GLuint nvtokenHeaderSW(GLuint type, GLuint size){
     return type | (size<<16);
@@ -47,14 +53,65 @@ namespace nvtoken
     return header>>16;
   }
 
+  // header to command lookup via a perfect hash,
+  // the native headers are opaque values so a direct table is not possible
+  #define NVTOKEN_HASH_BITS_MAX 10
+
+  static GLuint   s_nvcmdlist_hashMul   = 0;
+  static GLuint   s_nvcmdlist_hashShift = 32;
+  static GLubyte  s_nvcmdlist_hashTypes[1 << NVTOKEN_HASH_BITS_MAX];
+
+  static inline GLuint nvtokenHeaderHash(GLuint header, GLuint mul, GLuint shift)
+  {
+    return (header * mul) >> shift;
+  }
+
+  // unknown headers (e.g. stale data in a readback) are treated as
+  // terminate, so every loop over a stream stops or stays in bounds
   static inline GLenum nvtokenHeaderCommand(GLuint header)
   {
-    for (int i = 0; i < NVTOKEN_TYPES; i++){
-      if (header == s_nvcmdlist_header[i]) return i;
+    GLenum type = s_nvcmdlist_hashTypes[nvtokenHeaderHash(header, s_nvcmdlist_hashMul, s_nvcmdlist_hashShift)];
+
+    // empty slots hold terminate as well, one compare covers both
+    if (s_nvcmdlist_header[type] != header){
+      return GL_TERMINATE_SEQUENCE_COMMAND_NV;
+    }
+    return type;
+  }
+
+  static void nvtokenBuildHeaderHash()
+  {
+    // search for a multiplier that maps all headers to distinct slots,
+    // using the smallest table possible
+    GLuint seed = 0x9E3779B9;
+    for (GLuint bits = 5; bits <= NVTOKEN_HASH_BITS_MAX; bits++){
+      GLuint shift = 32 - bits;
+      for (int attempt = 0; attempt < 4096; attempt++){
+        GLuint mul = seed | 1;
+        seed = seed * 1664525 + 1013904223;
+
+        memset(s_nvcmdlist_hashTypes, 0xFF, sizeof(s_nvcmdlist_hashTypes));
+        bool unique = true;
+        for (int i = 0; i < NVTOKEN_TYPES && unique; i++){
+          GLuint slot = nvtokenHeaderHash(s_nvcmdlist_header[i], mul, shift);
+          unique = s_nvcmdlist_hashTypes[slot] == 0xFF;
+          s_nvcmdlist_hashTypes[slot] = GLubyte(i);
+        }
+
+        if (unique){
+          for (GLuint slot = 0; slot < (1u << bits); slot++){
+            if (s_nvcmdlist_hashTypes[slot] == 0xFF){
+              s_nvcmdlist_hashTypes[slot] = GL_TERMINATE_SEQUENCE_COMMAND_NV;
+            }
+          }
+          s_nvcmdlist_hashMul   = mul;
+          s_nvcmdlist_hashShift = shift;
+          return;
+        }
+      }
     }
 
-    assert(0 && "can't find header");
-    return -1;
+    assert(0 && "can't build header hash");
   }
 
   template <class T>
@@ -112,6 +169,8 @@ namespace nvtoken
         s_nvcmdlist_stages[i] = i;
       }
     }
+
+    nvtokenBuildHeaderHash();
   }
 
 #define TOSTRING(a)  case a: return #a;
@@ -158,25 +217,371 @@ namespace nvtoken
   }
 
 
+  void nvtokenDecode( const void* NV_RESTRICT stream, size_t streamSize, NVTokenDecoded& decoded )
+  {
+    const GLubyte* NV_RESTRICT begin = (GLubyte*)stream;
+    const GLubyte* NV_RESTRICT current = begin;
+    const GLubyte* streamEnd = current + streamSize;
+
+    decoded.ops.clear();
+
+    while (current < streamEnd){
+      const GLuint*             header  = (const GLuint*)current;
+
+      NVTokenDecoded::Op op;
+      op.offset = GLuint(current - begin);
+      op.type   = nvtokenHeaderCommand(*header);
+      decoded.ops.push_back(op);
+
+      current += s_nvcmdlist_headerSizes[op.type];
+    }
+  }
+
+
   // Emulation related
 
+  struct NVTokenModesSW {
+    GLenum mode;
+    GLenum modeStrip;
+    GLenum modeSpecial;
+
+    NVTokenModesSW(GLenum basemode)
+    {
+      mode = basemode;
+
+      if      (mode == GL_LINES)                modeStrip = GL_LINE_STRIP;
+      else if (mode == GL_TRIANGLES)            modeStrip = GL_TRIANGLE_STRIP;
+      /* else if (mode == GL_QUADS)                modeStrip = GL_QUAD_STRIP; */
+      else if (mode == GL_LINES_ADJACENCY)      modeStrip = GL_LINE_STRIP_ADJACENCY;
+      else if (mode == GL_TRIANGLES_ADJACENCY)  modeStrip = GL_TRIANGLE_STRIP_ADJACENCY;
+      else    modeStrip = mode;
+
+      if      (mode == GL_LINES)      modeSpecial = GL_LINE_LOOP;
+      else if (mode == GL_TRIANGLES)  modeSpecial = GL_TRIANGLE_FAN;
+      else    modeSpecial = mode;
+    }
+  };
+
+  // Consecutive draw tokens are gathered into client-side indirect commands
+  // and submitted with one multi-draw. The batch is flushed right before
+  // a state change is issued, so all draws within it share the same bindings.
+  // NOPs and binds skipped by NVTokenShadowSW keep the batch going.
+  class NVTokenBatchSW {
+  public:
+    struct DrawElementsIndirect {
+      GLuint  count;
+      GLuint  instanceCount;
+      GLuint  firstIndex;
+      GLint   baseVertex;
+      GLuint  baseInstance;
+    };
+    struct DrawArraysIndirect {
+      GLuint  count;
+      GLuint  instanceCount;
+      GLuint  first;
+      GLuint  baseInstance;
+    };
+
+    void addElements(GLenum mode, GLenum type, GLuint count, GLuint instanceCount, GLuint firstIndex, GLint baseVertex, GLuint baseInstance)
+    {
+      if (!m_elements.empty() && (mode != m_mode || type != m_type)) flush();
+      if (!m_arrays.empty()) flush();
+
+      DrawElementsIndirect cmd = {count, instanceCount, firstIndex, baseVertex, baseInstance};
+      m_elements.push_back(cmd);
+      m_mode = mode;
+      m_type = type;
+
+      if (!s_nvcmdlist_batchingSW) flush();
+    }
+
+    void addArrays(GLenum mode, GLuint count, GLuint instanceCount, GLuint first, GLuint baseInstance)
+    {
+      if (!m_arrays.empty() && mode != m_mode) flush();
+      if (!m_elements.empty()) flush();
+
+      DrawArraysIndirect cmd = {count, instanceCount, first, baseInstance};
+      m_arrays.push_back(cmd);
+      m_mode = mode;
+
+      if (!s_nvcmdlist_batchingSW) flush();
+    }
+
+    void flush()
+    {
+      if (!m_elements.empty()){
+        glMultiDrawElementsIndirect(m_mode, m_type, m_elements.data(), GLsizei(m_elements.size()), 0);
+        m_elements.clear();
+      }
+      if (!m_arrays.empty()){
+        glMultiDrawArraysIndirect(m_mode, m_arrays.data(), GLsizei(m_arrays.size()), 0);
+        m_arrays.clear();
+      }
+    }
+
+  private:
+    GLenum                            m_mode;
+    GLenum                            m_type;
+    // kept around to avoid allocations per frame
+    std::vector<DrawElementsIndirect> m_elements;
+    std::vector<DrawArraysIndirect>   m_arrays;
+  };
+
+  static NVTokenBatchSW s_batchSW;
+
+  // Shadow of the bindings the address tokens modify, so binds that
+  // would not change anything are skipped. Only valid within one
+  // nvtokenDrawCommandsSW call, as the application may change bindings
+  // in between.
+  class NVTokenShadowSW {
+  public:
+    enum {
+      MAX_VERTEXBINDINGS  = 16,
+      MAX_UNIFORMBINDINGS = 16,
+    };
+
+    struct Range {
+      GLuint    buffer;
+      GLuint64  offset;   // or address
+      GLuint64  size;     // or stride
+    };
+
+    void reset(const StateSystem::State& state)
+    {
+      static const Range invalid = {~0u, ~GLuint64(0), ~GLuint64(0)};
+      m_element = invalid;
+      for (int i = 0; i < MAX_VERTEXBINDINGS; i++){
+        m_vertex[i] = invalid;
+        // stride is part of the vertex format and not sourced from the tokens
+        m_vertex[i].size = GLuint64(state.vertexformat.bindings[i].stride);
+      }
+      for (int i = 0; i < MAX_UNIFORMBINDINGS; i++){
+        m_uniform[i] = invalid;
+      }
+    }
+
+    // returns true if the binding must be issued
+    bool element(GLuint buffer, GLuint64 offset)
+    {
+      return update(m_element, buffer, offset, 0);
+    }
+    bool vertex(GLuint index, GLuint buffer, GLuint64 offset, GLuint64 stride)
+    {
+      return index >= MAX_VERTEXBINDINGS || update(m_vertex[index], buffer, offset, stride);
+    }
+    bool uniform(GLuint index, GLuint buffer, GLuint64 offset, GLuint64 size)
+    {
+      return index >= MAX_UNIFORMBINDINGS || update(m_uniform[index], buffer, offset, size);
+    }
+
+  private:
+    Range   m_element;
+    Range   m_vertex[MAX_VERTEXBINDINGS];
+    Range   m_uniform[MAX_UNIFORMBINDINGS];
+
+    static inline bool update(Range& range, GLuint buffer, GLuint64 offset, GLuint64 size)
+    {
+      if (s_nvcmdlist_filterSW && range.buffer == buffer && range.offset == offset && range.size == size){
+        s_nvcmdlist_statsSW.elided++;
+        return false;
+      }
+      range.buffer = buffer;
+      range.offset = offset;
+      range.size   = size;
+      s_nvcmdlist_statsSW.issued++;
+      return true;
+    }
+  };
+
+  static NVTokenShadowSW s_shadowSW;
+
+  static inline bool nvtokenIsDrawSW( GLenum cmdtype )
+  {
+    return  cmdtype == GL_DRAW_ELEMENTS_COMMAND_NV || cmdtype == GL_DRAW_ARRAYS_COMMAND_NV ||
+            cmdtype == GL_DRAW_ELEMENTS_STRIP_COMMAND_NV || cmdtype == GL_DRAW_ARRAYS_STRIP_COMMAND_NV ||
+            cmdtype == GL_DRAW_ELEMENTS_INSTANCED_COMMAND_NV || cmdtype == GL_DRAW_ARRAYS_INSTANCED_COMMAND_NV;
+  }
+
+  // returns false on terminate
+  static inline bool nvtokenExecuteSW( GLenum cmdtype, const GLubyte* NV_RESTRICT current, const NVTokenModesSW& modes, GLenum& type, const StateSystem::State& state )
+  {
+    // address tokens flush only if the bind is actually issued
+    if (!nvtokenIsDrawSW(cmdtype) && cmdtype != GL_NOP_COMMAND_NV && cmdtype != GL_TERMINATE_SEQUENCE_COMMAND_NV &&
+        cmdtype != GL_ELEMENT_ADDRESS_COMMAND_NV && cmdtype != GL_ATTRIBUTE_ADDRESS_COMMAND_NV && cmdtype != GL_UNIFORM_ADDRESS_COMMAND_NV){
+      s_batchSW.flush();
+    }
+
+    switch(cmdtype){
+    case GL_TERMINATE_SEQUENCE_COMMAND_NV:
+      {
+        return false;
+      }
+      break;
+    case GL_NOP_COMMAND_NV:
+      {
+      }
+      break;
+    case GL_DRAW_ELEMENTS_COMMAND_NV:
+      {
+        const DrawElementsCommandNV* cmd = (const DrawElementsCommandNV*)current;
+        s_batchSW.addElements(modes.mode, type, cmd->count, 1, cmd->firstIndex, cmd->baseVertex, 0);
+      }
+      break;
+    case GL_DRAW_ARRAYS_COMMAND_NV:
+      {
+        const DrawArraysCommandNV* cmd = (const DrawArraysCommandNV*)current;
+        s_batchSW.addArrays(modes.mode, cmd->count, 1, cmd->first, 0);
+      }
+      break;
+    case GL_DRAW_ELEMENTS_STRIP_COMMAND_NV:
+      {
+        const DrawElementsCommandNV* cmd = (const DrawElementsCommandNV*)current;
+        s_batchSW.addElements(modes.modeStrip, type, cmd->count, 1, cmd->firstIndex, cmd->baseVertex, 0);
+      }
+      break;
+    case GL_DRAW_ARRAYS_STRIP_COMMAND_NV:
+      {
+        const DrawArraysCommandNV* cmd = (const DrawArraysCommandNV*)current;
+        s_batchSW.addArrays(modes.modeStrip, cmd->count, 1, cmd->first, 0);
+      }
+      break;
+    case GL_DRAW_ELEMENTS_INSTANCED_COMMAND_NV:
+      {
+        const DrawElementsInstancedCommandNV* cmd = (const DrawElementsInstancedCommandNV*)current;
+
+        assert (cmd->mode == modes.mode || cmd->mode == modes.modeStrip || cmd->mode == modes.modeSpecial);
+
+        s_batchSW.addElements(cmd->mode, type, cmd->count, cmd->instanceCount, cmd->firstIndex, cmd->baseVertex, cmd->baseInstance);
+      }
+      break;
+    case GL_DRAW_ARRAYS_INSTANCED_COMMAND_NV:
+      {
+        const DrawArraysInstancedCommandNV* cmd = (const DrawArraysInstancedCommandNV*)current;
+
+        assert (cmd->mode == modes.mode || cmd->mode == modes.modeStrip || cmd->mode == modes.modeSpecial);
+
+        s_batchSW.addArrays(cmd->mode, cmd->count, cmd->instanceCount, cmd->first, cmd->baseInstance);
+      }
+      break;
+    case GL_ELEMENT_ADDRESS_COMMAND_NV:
+      {
+        const ElementAddressCommandNV* cmd = (const ElementAddressCommandNV*)current;
+        type = cmd->typeSizeInByte == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+        if (s_nvcmdlist_bindless){
+          GLuint64 address = GLuint64(cmd->addressLo) | (GLuint64(cmd->addressHi)<<32);
+          if (s_shadowSW.element(0, address)){
+            s_batchSW.flush();
+            glBufferAddressRangeNV(GL_ELEMENT_ARRAY_ADDRESS_NV, 0, address, 0x7FFFFFFF);
+          }
+        }
+        else{
+          const ElementAddressCommandEMU* cmd = (const ElementAddressCommandEMU*)current;
+          if (s_shadowSW.element(cmd->buffer, 0)){
+            s_batchSW.flush();
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cmd->buffer);
+          }
+        }
+      }
+      break;
+    case GL_ATTRIBUTE_ADDRESS_COMMAND_NV:
+      {
+        if (s_nvcmdlist_bindless){
+          const AttributeAddressCommandNV* cmd = (const AttributeAddressCommandNV*)current;
+          GLuint64 address = GLuint64(cmd->addressLo) | (GLuint64(cmd->addressHi)<<32);
+          if (s_shadowSW.vertex(cmd->index, 0, address, GLuint64(state.vertexformat.bindings[cmd->index].stride))){
+            s_batchSW.flush();
+            glBufferAddressRangeNV(GL_VERTEX_ATTRIB_ARRAY_ADDRESS_NV, cmd->index, address, 0x7FFFFFFF);
+          }
+        }
+        else{
+          const AttributeAddressCommandEMU* cmd = (const AttributeAddressCommandEMU*)current;
+          GLsizei stride = state.vertexformat.bindings[cmd->index].stride;
+          if (s_shadowSW.vertex(cmd->index, cmd->buffer, cmd->offset, GLuint64(stride))){
+            s_batchSW.flush();
+            glBindVertexBuffer(cmd->index, cmd->buffer, cmd->offset, stride);
+          }
+        }
+      }
+      break;
+    case GL_UNIFORM_ADDRESS_COMMAND_NV:
+      {
+         if (s_nvcmdlist_bindless){
+          const UniformAddressCommandNV* cmd = (const UniformAddressCommandNV*)current;
+          GLuint64 address = GLuint64(cmd->addressLo) | (GLuint64(cmd->addressHi)<<32);
+          if (s_shadowSW.uniform(cmd->index, 0, address, 0x10000)){
+            s_batchSW.flush();
+            glBufferAddressRangeNV(GL_UNIFORM_BUFFER_ADDRESS_NV, cmd->index, address, 0x10000);
+          }
+        }
+        else{
+          const UniformAddressCommandEMU* cmd = (const UniformAddressCommandEMU*)current;
+          if (s_shadowSW.uniform(cmd->index, cmd->buffer, GLuint64(cmd->offset256) * 256, GLuint64(cmd->size4) * 4)){
+            s_batchSW.flush();
+            glBindBufferRange(GL_UNIFORM_BUFFER,cmd->index, cmd->buffer, GLintptr(cmd->offset256) * 256, GLsizeiptr(cmd->size4) * 4);
+          }
+        }
+      }
+      break;
+    case GL_BLEND_COLOR_COMMAND_NV:
+      {
+        const BlendColorCommandNV* cmd = (const BlendColorCommandNV*)current;
+        glBlendColor(cmd->red,cmd->green,cmd->blue,cmd->alpha);
+      }
+      break;
+    case GL_STENCIL_REF_COMMAND_NV:
+      {
+        const StencilRefCommandNV* cmd = (const StencilRefCommandNV*)current;
+        glStencilFuncSeparate(GL_FRONT, state.stencil.funcs[StateSystem::FACE_FRONT].func, cmd->frontStencilRef, state.stencil.funcs[StateSystem::FACE_FRONT].mask);
+        glStencilFuncSeparate(GL_BACK,  state.stencil.funcs[StateSystem::FACE_BACK ].func, cmd->backStencilRef,  state.stencil.funcs[StateSystem::FACE_BACK ].mask);
+      }
+      break;
+
+    case GL_LINE_WIDTH_COMMAND_NV:
+      {
+        const LineWidthCommandNV* cmd = (const LineWidthCommandNV*)current;
+        glLineWidth(cmd->lineWidth);
+      }
+      break;
+    case GL_POLYGON_OFFSET_COMMAND_NV:
+      {
+        const PolygonOffsetCommandNV* cmd = (const PolygonOffsetCommandNV*)current;
+        glPolygonOffset(cmd->scale,cmd->bias);
+      }
+      break;
+    case GL_ALPHA_REF_COMMAND_NV:
+      {
+        const AlphaRefCommandNV* cmd = (const AlphaRefCommandNV*)current;
+        /* glAlphaFunc(state.alpha.mode, cmd->alphaRef); */
+      }
+      break;
+    case GL_VIEWPORT_COMMAND_NV:
+      {
+        const ViewportCommandNV* cmd = (const ViewportCommandNV*)current;
+        glViewport(cmd->x, cmd->y, cmd->width, cmd->height);
+      }
+      break;
+    case GL_SCISSOR_COMMAND_NV:
+      {
+        const ScissorCommandNV* cmd = (const ScissorCommandNV*)current;
+        glScissor(cmd->x,cmd->y,cmd->width,cmd->height);
+      }
+      break;
+    case GL_FRONT_FACE_COMMAND_NV:
+      {
+        FrontFaceCommandNV* cmd = (FrontFaceCommandNV*)current;
+        glFrontFace(cmd->frontFace?GL_CW:GL_CCW);
+      }
+      break;
+    }
+    return true;
+  }
+
   static inline GLenum nvtokenDrawCommandSequenceSW( const void* NV_RESTRICT stream, size_t streamSize, GLenum mode, GLenum type, const StateSystem::State& state )
   {
     const GLubyte* NV_RESTRICT current = (GLubyte*)stream;
     const GLubyte* streamEnd = current + streamSize;
 
-    GLenum modeStrip;
-    if      (mode == GL_LINES)                modeStrip = GL_LINE_STRIP;
-    else if (mode == GL_TRIANGLES)            modeStrip = GL_TRIANGLE_STRIP;
-    /* else if (mode == GL_QUADS)                modeStrip = GL_QUAD_STRIP; */
-    else if (mode == GL_LINES_ADJACENCY)      modeStrip = GL_LINE_STRIP_ADJACENCY;
-    else if (mode == GL_TRIANGLES_ADJACENCY)  modeStrip = GL_TRIANGLE_STRIP_ADJACENCY;
-    else    modeStrip = mode;
-
-    GLenum modeSpecial;
-    if      (mode == GL_LINES)      modeSpecial = GL_LINE_LOOP;
-    else if (mode == GL_TRIANGLES)  modeSpecial = GL_TRIANGLE_FAN;
-    else    modeSpecial = mode;
+    NVTokenModesSW modes(mode);
 
     while (current < streamEnd){
       const GLuint*             header  = (const GLuint*)current;
@@ -184,155 +589,170 @@ namespace nvtoken
       GLenum cmdtype = nvtokenHeaderCommand(*header);
       // if you always use emulation on non-native tokens you can use 
       // cmdtype = nvtokenHeaderCommandSW(header->encoded)
-      switch(cmdtype){
-      case GL_TERMINATE_SEQUENCE_COMMAND_NV:
-        {
-          return type;
-        }
+      if (!nvtokenExecuteSW(cmdtype, current, modes, type, state)){
         break;
-      case GL_NOP_COMMAND_NV:
-        {
-        }
-        break;
-      case GL_DRAW_ELEMENTS_COMMAND_NV:
-        {
-          const DrawElementsCommandNV* cmd = (const DrawElementsCommandNV*)current;
-          glDrawElementsBaseVertex(mode, cmd->count, type, (const GLvoid*)(cmd->firstIndex * sizeof(GLuint)), cmd->baseVertex);
-        }
-        break;
-      case GL_DRAW_ARRAYS_COMMAND_NV:
-        {
-          const DrawArraysCommandNV* cmd = (const DrawArraysCommandNV*)current;
-          glDrawArrays(mode, cmd->first, cmd->count);
-        }
-        break;
-      case GL_DRAW_ELEMENTS_STRIP_COMMAND_NV:
-        {
-          const DrawElementsCommandNV* cmd = (const DrawElementsCommandNV*)current;
-          glDrawElementsBaseVertex(modeStrip, cmd->count, type, (const GLvoid*)(cmd->firstIndex * sizeof(GLuint)), cmd->baseVertex);
-        }
-        break;
-      case GL_DRAW_ARRAYS_STRIP_COMMAND_NV:
-        {
-          const DrawArraysCommandNV* cmd = (const DrawArraysCommandNV*)current;
-          glDrawArrays(modeStrip, cmd->first, cmd->count);
-        }
-        break;
-      case GL_DRAW_ELEMENTS_INSTANCED_COMMAND_NV:
-        {
-          const DrawElementsInstancedCommandNV* cmd = (const DrawElementsInstancedCommandNV*)current;
+      }
 
-          assert (cmd->mode == mode || cmd->mode == modeStrip || cmd->mode == modeSpecial);
+      GLuint tokenSize = s_nvcmdlist_headerSizes[cmdtype];
+      assert(tokenSize);
 
-          glDrawElementsIndirect(cmd->mode, type, &cmd->count);
-        }
+      current += tokenSize;
+    }
+    s_batchSW.flush();
+    return type;
+  }
+
+  static inline GLenum nvtokenDrawCommandSequenceSW( const GLubyte* NV_RESTRICT stream, const NVTokenDecoded& decoded, size_t offset, size_t size, GLenum mode, GLenum type, const StateSystem::State& state )
+  {
+    NVTokenModesSW modes(mode);
+
+    // first token of the sequence
+    const NVTokenDecoded::Op* op    = decoded.ops.data();
+    const NVTokenDecoded::Op* opEnd = op + decoded.ops.size();
+    size_t lo = 0;
+    size_t hi = decoded.ops.size();
+    while (lo < hi){
+      size_t mid = (lo + hi) / 2;
+      if (op[mid].offset < offset) lo = mid + 1;
+      else hi = mid;
+    }
+    op += lo;
+
+    size_t end = offset + size;
+    for (; op < opEnd && op->offset < end; op++){
+      if (!nvtokenExecuteSW(op->type, stream + op->offset, modes, type, state)){
         break;
-      case GL_DRAW_ARRAYS_INSTANCED_COMMAND_NV:
-        {
-          const DrawArraysInstancedCommandNV* cmd = (const DrawArraysInstancedCommandNV*)current;
+      }
+    }
+    s_batchSW.flush();
+    return type;
+  }
 
-          assert (cmd->mode == mode || cmd->mode == modeStrip || cmd->mode == modeSpecial);
+  static inline bool nvtokenIsStateSW( GLenum cmdtype )
+  {
+    return !nvtokenIsDrawSW(cmdtype) && cmdtype != GL_NOP_COMMAND_NV && cmdtype != GL_TERMINATE_SEQUENCE_COMMAND_NV;
+  }
 
-          glDrawArraysIndirect(cmd->mode, &cmd->count);
+  void nvtokenInspect( const void* NV_RESTRICT stream, size_t streamSize, 
+    const GLintptr* NV_RESTRICT offsets, const GLsizei* NV_RESTRICT sizes, GLuint count, NVTokenReport& report)
+  {
+    memset(report.counts, 0, sizeof(report.counts));
+    memset(report.bytes, 0, sizeof(report.bytes));
+    memset(report.redundant, 0, sizeof(report.redundant));
+    report.totalBytes = 0;
+    report.usedBytes  = 0;
+    report.sequences.resize(count);
+
+    // last token per binding, keyed by type, index and stage
+    std::unordered_map<GLuint64, const GLubyte*> lastState;
+
+    for (GLuint i = 0; i < count; i++){
+      NVTokenReport::Sequence& seq = report.sequences[i];
+      seq.offset    = offsets[i];
+      seq.size      = sizes[i];
+      seq.used      = 0;
+      seq.tokens    = 0;
+      seq.draws     = 0;
+      seq.redundant = 0;
+
+      assert(seq.offset + seq.size <= streamSize);
+
+      const GLubyte* NV_RESTRICT begin   = (const GLubyte*)stream + seq.offset;
+      const GLubyte* NV_RESTRICT current = begin;
+      const GLubyte* end = begin + seq.size;
+
+      // state is not inherited between sequences
+      lastState.clear();
+
+      while (current < end){
+        GLenum cmdtype   = nvtokenHeaderCommand(*(const GLuint*)current);
+        GLuint tokenSize = s_nvcmdlist_headerSizes[cmdtype];
+        assert(tokenSize);
+
+        report.counts[cmdtype]++;
+        report.bytes[cmdtype] += tokenSize;
+        seq.tokens++;
+
+        if (nvtokenIsDrawSW(cmdtype)){
+          seq.draws++;
         }
-        break;
-      case GL_ELEMENT_ADDRESS_COMMAND_NV:
-        {
-          const ElementAddressCommandNV* cmd = (const ElementAddressCommandNV*)current;
-          type = cmd->typeSizeInByte == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
-          if (s_nvcmdlist_bindless){
-            glBufferAddressRangeNV(GL_ELEMENT_ARRAY_ADDRESS_NV, 0, GLuint64(cmd->addressLo) | (GLuint64(cmd->addressHi)<<32), 0x7FFFFFFF);
-          }
-          else{
-            const ElementAddressCommandEMU* cmd = (const ElementAddressCommandEMU*)current;
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cmd->buffer);
+        else if (nvtokenIsStateSW(cmdtype)){
+          GLuint64 key = cmdtype;
+          if (cmdtype == GL_ATTRIBUTE_ADDRESS_COMMAND_NV){
+            key |= GLuint64(((const AttributeAddressCommandNV*)current)->index) << 16;
           }
-        }
-        break;
-      case GL_ATTRIBUTE_ADDRESS_COMMAND_NV:
-        {
-          if (s_nvcmdlist_bindless){
-            const AttributeAddressCommandNV* cmd = (const AttributeAddressCommandNV*)current;
-            glBufferAddressRangeNV(GL_VERTEX_ATTRIB_ARRAY_ADDRESS_NV, cmd->index, GLuint64(cmd->addressLo) | (GLuint64(cmd->addressHi)<<32), 0x7FFFFFFF);
-          }
-          else{
-            const AttributeAddressCommandEMU* cmd = (const AttributeAddressCommandEMU*)current;
-            glBindVertexBuffer(cmd->index, cmd->buffer, cmd->offset, state.vertexformat.bindings[cmd->index].stride);
-          }
-        }
-        break;
-      case GL_UNIFORM_ADDRESS_COMMAND_NV:
-        {
-           if (s_nvcmdlist_bindless){
+          else if (cmdtype == GL_UNIFORM_ADDRESS_COMMAND_NV){
             const UniformAddressCommandNV* cmd = (const UniformAddressCommandNV*)current;
-            glBufferAddressRangeNV(GL_UNIFORM_BUFFER_ADDRESS_NV, cmd->index, GLuint64(cmd->addressLo) | (GLuint64(cmd->addressHi)<<32), 0x10000);
+            key |= (GLuint64(cmd->index) << 16) | (GLuint64(cmd->stage) << 32);
           }
-          else{
-            const UniformAddressCommandEMU* cmd = (const UniformAddressCommandEMU*)current;
-            glBindBufferRange(GL_UNIFORM_BUFFER,cmd->index, cmd->buffer, cmd->offset256 * 256, cmd->size4*4);
+
+          const GLubyte*& last = lastState[key];
+          if (last && memcmp(last + sizeof(GLuint), current + sizeof(GLuint), tokenSize - sizeof(GLuint)) == 0){
+            report.redundant[cmdtype]++;
+            seq.redundant++;
           }
+          last = current;
         }
-        break;
-      case GL_BLEND_COLOR_COMMAND_NV:
-        {
-          const BlendColorCommandNV* cmd = (const BlendColorCommandNV*)current;
-          glBlendColor(cmd->red,cmd->green,cmd->blue,cmd->alpha);
-        }
-        break;
-      case GL_STENCIL_REF_COMMAND_NV:
-        {
-          const StencilRefCommandNV* cmd = (const StencilRefCommandNV*)current;
-          glStencilFuncSeparate(GL_FRONT, state.stencil.funcs[StateSystem::FACE_FRONT].func, cmd->frontStencilRef, state.stencil.funcs[StateSystem::FACE_FRONT].mask);
-          glStencilFuncSeparate(GL_BACK,  state.stencil.funcs[StateSystem::FACE_BACK ].func, cmd->backStencilRef,  state.stencil.funcs[StateSystem::FACE_BACK ].mask);
-        }
-        break;
 
-      case GL_LINE_WIDTH_COMMAND_NV:
-        {
-          const LineWidthCommandNV* cmd = (const LineWidthCommandNV*)current;
-          glLineWidth(cmd->lineWidth);
+        current += tokenSize;
+        if (cmdtype == GL_TERMINATE_SEQUENCE_COMMAND_NV){
+          break;
         }
-        break;
-      case GL_POLYGON_OFFSET_COMMAND_NV:
-        {
-          const PolygonOffsetCommandNV* cmd = (const PolygonOffsetCommandNV*)current;
-          glPolygonOffset(cmd->scale,cmd->bias);
-        }
-        break;
-      case GL_ALPHA_REF_COMMAND_NV:
-        {
-          const AlphaRefCommandNV* cmd = (const AlphaRefCommandNV*)current;
-          /* glAlphaFunc(state.alpha.mode, cmd->alphaRef); */
-        }
-        break;
-      case GL_VIEWPORT_COMMAND_NV:
-        {
-          const ViewportCommandNV* cmd = (const ViewportCommandNV*)current;
-          glViewport(cmd->x, cmd->y, cmd->width, cmd->height);
-        }
-        break;
-      case GL_SCISSOR_COMMAND_NV:
-        {
-          const ScissorCommandNV* cmd = (const ScissorCommandNV*)current;
-          glScissor(cmd->x,cmd->y,cmd->width,cmd->height);
-        }
-        break;
-      case GL_FRONT_FACE_COMMAND_NV:
-        {
-          FrontFaceCommandNV* cmd = (FrontFaceCommandNV*)current;
-          glFrontFace(cmd->frontFace?GL_CW:GL_CCW);
-        }
-        break;
       }
 
+      seq.used = size_t(current - begin);
+      report.totalBytes += seq.size;
+      report.usedBytes  += seq.used;
+    }
+  }
 
-      GLuint tokenSize = s_nvcmdlist_headerSizes[cmdtype];
-      assert(tokenSize);
-
-      current += tokenSize;
+  std::string nvtokenReportToJSON( const NVTokenReport& report, const NVTokenReport* culled )
+  {
+    std::string json;
+    char        buf[256];
+
+    json += "{\n  \"tokens\": {";
+    bool first = true;
+    for (GLuint t = 0; t < NVTOKEN_TYPES; t++){
+      if (!report.counts[t] && !(culled && culled->counts[t])) continue;
+
+      snprintf(buf, sizeof(buf), "%s\n    \"%s\": {\"count\": %u, \"bytes\": %zu, \"redundant\": %u",
+        first ? "" : ",", nvtokenCommandToString(t), report.counts[t], report.bytes[t], report.redundant[t]);
+      json += buf;
+      if (culled){
+        snprintf(buf, sizeof(buf), ", \"culledCount\": %u, \"culledBytes\": %zu", culled->counts[t], culled->bytes[t]);
+        json += buf;
+      }
+      json += "}";
+      first = false;
+    }
+    json += "\n  },\n";
+
+    snprintf(buf, sizeof(buf), "  \"totalBytes\": %zu,\n  \"usedBytes\": %zu,\n", report.totalBytes, report.usedBytes);
+    json += buf;
+    if (culled){
+      snprintf(buf, sizeof(buf), "  \"culledBytes\": %zu,\n  \"compactionRatio\": %.4f,\n", 
+        culled->usedBytes, report.usedBytes ? double(culled->usedBytes) / double(report.usedBytes) : 1.0);
+      json += buf;
+    }
 
+    json += "  \"sequences\": [";
+    for (size_t i = 0; i < report.sequences.size(); i++){
+      const NVTokenReport::Sequence& seq = report.sequences[i];
+      snprintf(buf, sizeof(buf), "%s\n    {\"offset\": %zu, \"size\": %zu, \"used\": %zu, \"tokens\": %u, \"draws\": %u, \"redundant\": %u",
+        i ? "," : "", seq.offset, seq.size, seq.used, seq.tokens, seq.draws, seq.redundant);
+      json += buf;
+      if (culled && i < culled->sequences.size()){
+        const NVTokenReport::Sequence& cseq = culled->sequences[i];
+        snprintf(buf, sizeof(buf), ", \"culledUsed\": %zu, \"culledTokens\": %u, \"culledDraws\": %u",
+          cseq.used, cseq.tokens, cseq.draws);
+        json += buf;
+      }
+      json += "}";
     }
-    return type;
+    json += "\n  ]\n}\n";
+
+    return json;
   }
 
   void nvtokenDrawCommandsSW(GLenum mode, const void* NV_RESTRICT stream, size_t streamSize, 
@@ -342,6 +762,7 @@ namespace nvtoken
   {
     const char* NV_RESTRICT tokens = (const char*)stream;
     GLenum type = GL_UNSIGNED_SHORT;
+    s_shadowSW.reset(state);
     for (GLuint i = 0; i < count; i++)
     {
       size_t offset = offsets[i];
@@ -354,6 +775,25 @@ namespace nvtoken
 
   }
 
+  void nvtokenDrawCommandsSW(GLenum mode, const void* NV_RESTRICT stream, size_t streamSize, const NVTokenDecoded& decoded,
+    const GLintptr* NV_RESTRICT offsets, const GLsizei* NV_RESTRICT sizes, 
+    GLuint count, 
+    StateSystem::State &state)
+  {
+    const GLubyte* NV_RESTRICT tokens = (const GLubyte*)stream;
+    GLenum type = GL_UNSIGNED_SHORT;
+    s_shadowSW.reset(state);
+    for (GLuint i = 0; i < count; i++)
+    {
+      size_t offset = offsets[i];
+      size_t size   = sizes[i];
+
+      assert(size + offset <= streamSize);
+
+      type = nvtokenDrawCommandSequenceSW(tokens, decoded, offset, size, mode, type, state);
+    }
+  }
+
 #if NVTOKEN_STATESYSTEM
   void nvtokenDrawCommandsStatesSW(const void* NV_RESTRICT stream, size_t streamSize, 
     const GLintptr* NV_RESTRICT offsets, const GLsizei* NV_RESTRICT sizes, 
@@ -387,9 +827,14 @@ namespace nvtoken
 
       if (i == 0){
         stateSystem.applyGL( curID, true ); // quite costly
+        s_shadowSW.reset(state);
       }
       else {
         stateSystem.applyGL( curID, lastID, true );
+        if (curID != lastID){
+          // vertex format may have changed
+          s_shadowSW.reset(state);
+        }
       }
       lastID = curID;
 
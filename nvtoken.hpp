@@ -22,12 +22,15 @@
 
 
 #include <assert.h>
+#include <string.h>
+#include <algorithm>
 #include <string>
 #include <vector>
 
 #define NVTOKEN_STATESYSTEM 0
 #include <include_gl.h>
 #include "platform.h"
+#include "threadpool.hpp"
 #if NVTOKEN_STATESYSTEM
 // not needed if emulation is not used, or implemented differently
 #include "statesystem.hpp"
@@ -80,6 +83,10 @@ namespace nvtoken
   };
 
   extern bool     s_nvcmdlist_bindless;
+  // emulation merges consecutive draw tokens into multi-draw-indirect calls
+  extern bool     s_nvcmdlist_batchingSW;
+  // emulation skips address tokens that match the current binding
+  extern bool     s_nvcmdlist_filterSW;
   extern GLuint   s_nvcmdlist_header[NVTOKEN_TYPES];
   extern GLuint   s_nvcmdlist_headerSizes[NVTOKEN_TYPES];
   extern GLushort s_nvcmdlist_stages[NVTOKEN_STAGES];
@@ -110,6 +117,13 @@ namespace nvtoken
     }
   };
 
+  // binds issued/skipped by the emulation, accumulated until reset by the user
+  struct NVTokenStatsSW {
+    GLuint  issued;
+    GLuint  elided;
+  };
+  extern NVTokenStatsSW s_nvcmdlist_statsSW;
+
   struct NVTokenSequence {
     std::vector<GLintptr>  offsets;
     std::vector<GLsizei>   sizes;
@@ -117,6 +131,36 @@ namespace nvtoken
     std::vector<GLuint>    fbos;
   };
 
+  // pre-decoded stream, so emulation can replay it without header matching.
+  // Must be rebuilt if the token layout of the stream changes.
+  struct NVTokenDecoded {
+    struct Op {
+      GLuint  offset;   // in bytes within the stream
+      GLenum  type;
+    };
+    std::vector<Op>  ops;
+  };
+
+  // result of nvtokenInspect
+  struct NVTokenReport {
+    struct Sequence {
+      size_t  offset;       // in bytes within the stream
+      size_t  size;         // bytes provided
+      size_t  used;         // bytes up to and including a terminator
+      GLuint  tokens;
+      GLuint  draws;
+      GLuint  redundant;
+    };
+
+    GLuint  counts[NVTOKEN_TYPES];
+    size_t  bytes[NVTOKEN_TYPES];
+    // state tokens equal to the previous token for the same binding
+    GLuint  redundant[NVTOKEN_TYPES];
+    size_t  totalBytes;
+    size_t  usedBytes;
+    std::vector<Sequence> sequences;
+  };
+
 #pragma pack(push,1)
 
   typedef struct {
@@ -536,9 +580,7 @@ namespace nvtoken
   size_t nvtokenEnqueue(std::string& queue, T& data)
   {
     size_t offset = queue.size();
-    std::string cmd = std::string((const char*)&data,sizeof(T));
-
-    queue += cmd;
+    queue.append((const char*)&data,sizeof(T));
 
     return offset;
   }
@@ -554,18 +596,57 @@ namespace nvtoken
 
     return offset;
   }
+
+  // Enqueues count tokens of the same type, which are generated by 
+  // fill(size_t index, T& token, size_t offset) from multiple threads.
+  // The queue must have been sized for all tokens up front, each thread
+  // writes its own slice, fill must be safe to call concurrently.
+  // Returns the offset of the first token.
+  template <class T, class F>
+  size_t nvtokenEnqueueParallel(NVPointerStream& queue, size_t count, const F& fill, size_t minPerThread = 16 * 1024)
+  {
+    assert(queue.m_cur + sizeof(T) * count <= queue.m_end);
+    size_t first = queue.m_cur - queue.m_begin;
+
+    ThreadPool::get().parallelFor(count, minPerThread, [&](size_t begin, size_t end)
+    {
+      NVPointerStream slice;
+      slice.init(queue.m_cur + begin * sizeof(T), (end - begin) * sizeof(T));
+      for (size_t i = begin; i < end; i++){
+        T token;
+        fill(i, token, first + i * sizeof(T));
+        nvtokenEnqueue(slice, token);
+      }
+    });
+
+    queue.m_cur += sizeof(T) * count;
+    return first;
+  }
   
   //////////////////////////////////////////////////////////
   
   void        nvtokenInitInternals( bool hwsupport, bool bindlessSupport);
   const char* nvtokenCommandToString( GLenum type );
   void        nvtokenGetStats( const void* NV_RESTRICT stream, size_t streamSize, int stats[NVTOKEN_TYPES]);
+  void        nvtokenDecode( const void* NV_RESTRICT stream, size_t streamSize, NVTokenDecoded& decoded);
+
+  // walks the sequences of a host stream (or a readback of a GPU stream)
+  void        nvtokenInspect( const void* NV_RESTRICT stream, size_t streamSize, 
+    const GLintptr* NV_RESTRICT offsets, const GLsizei* NV_RESTRICT sizes, GLuint count, NVTokenReport& report);
+  // if culled is provided, its used sizes are compared against report
+  std::string nvtokenReportToJSON( const NVTokenReport& report, const NVTokenReport* culled = nullptr);
 
   void nvtokenDrawCommandsSW(GLenum mode, const void* NV_RESTRICT stream, size_t streamSize, 
     const GLintptr* NV_RESTRICT offsets, const GLsizei* NV_RESTRICT sizes, 
     GLuint count, 
     StateSystem::State &state);
 
+  // same as above, using the pre-decoded form of stream
+  void nvtokenDrawCommandsSW(GLenum mode, const void* NV_RESTRICT stream, size_t streamSize, const NVTokenDecoded& decoded,
+    const GLintptr* NV_RESTRICT offsets, const GLsizei* NV_RESTRICT sizes, 
+    GLuint count, 
+    StateSystem::State &state);
+
 #if NVTOKEN_STATESYSTEM
   void nvtokenDrawCommandsStatesSW(const void* NV_RESTRICT stream, size_t streamSize, 
     const GLintptr* NV_RESTRICT offsets, const GLsizei* NV_RESTRICT sizes, 
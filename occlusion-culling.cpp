@@ -28,6 +28,7 @@
 #include <imgui/imgui_helper.h>
 
 #include <nvh/cameracontrol.hpp>
+#include <nvh/filemapping.hpp>
 #include <nvh/geometry.hpp>
 #include <nvh/misc.hpp>
 
@@ -36,17 +37,34 @@
 #include <nvgl/error_gl.hpp>
 #include <nvgl/programmanager_gl.hpp>
 
+#include <algorithm>
+#include <cfloat>
+#include <functional>
+#include <map>
+#include <random>
 #include <vector>
 
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define ANIMATE_SSE 1
+#else
+#define ANIMATE_SSE 0
+#endif
+
 #include "cullingsystem.hpp"
+#include "headlessgl.hpp"
 
 #define NVTOKEN_NO_STATESYSTEM
 #include "nvtoken.hpp"
 using namespace nvtoken;
 
 #include "scansystem.hpp"
+#include "sceneimport.hpp"
+#include "threadpool.hpp"
+#include "uploadring.hpp"
 
 #include "common.h"
+#include "cull-common.h"
 #include "glm/gtc/type_ptr.hpp"
 #include "glm/gtc/matrix_access.hpp"
 
@@ -61,11 +79,52 @@ static const float  globalscale = 8;
 
 static ScanSystem s_scanSys;
 
+// binary scene cache, every section is stored in the layout used for
+// the buffer uploads, so the mapped file can be uploaded as is
+enum SceneCacheSection
+{
+  SCENECACHE_VERTICES,
+  SCENECACHE_INDICES,
+  SCENECACHE_MATRICES,
+  SCENECACHE_BBOXES,
+  SCENECACHE_MATRIXINDICES,
+  SCENECACHE_CMDS,
+  SCENECACHE_TOKENS,
+  SCENECACHE_TOKENSIZES,
+  SCENECACHE_TOKENOFFSETS,
+  SCENECACHE_TOKENOBJECTS,
+  SCENECACHE_SECTIONS,
+};
+
+struct SceneCacheHeader
+{
+  static const uint32_t MAGIC     = 0x4c55434f;  // "OCUL"
+  static const uint32_t VERSION   = 2;
+  static const size_t   ALIGNMENT = 256;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t grid;
+  // layout checks
+  uint32_t vertexSize;
+  uint32_t cmdSize;
+  uint32_t tokenStateSize;
+  uint32_t chunkObjects;  // per-object sections are chunk relative
+  uint64_t sectionOffsets[SCENECACHE_SECTIONS];
+  uint64_t sectionSizes[SCENECACHE_SECTIONS];
+};
+
 class Sample : public nvgl::AppWindowProfilerGL
 {
 public:
   static int const CYCLIC_FRAMES = 2;
 
+  // initial frame size of the upload ring, the small per-frame data
+  static size_t const UPLOAD_RING_SIZE = 4 * 1024 * 1024;
+  // host animation is staged per piece, so a ring that could not grow
+  // to a whole chunk still takes most of it
+  static size_t const ANIMATE_PIECE_SIZE = 16 * 1024 * 1024;
+
   enum GuiEnums
   {
     GUI_OCC_ALGORITHM,
@@ -94,12 +153,15 @@ public:
   {
     nvgl::ProgramID draw_scene,
 
-        object_frustum, object_hiz, object_raster_geo, object_raster_instanced, object_raster_mesh, bit_temporallast,
-        bit_temporalnew, bit_regular, indirect_unordered, depth_mips,
+        object_frustum, object_hiz, object_raster_geo, object_raster_instanced, object_raster_mesh, object_raster_query,
+        bit_temporallast, bit_temporalnew, bit_regular, indirect_unordered, depth_mips,
+
+        token_sizes, token_cmds, token_nops,
 
-        token_sizes, token_cmds,
+        scan_prefixsum, scan_offsets, scan_combine, scan_lookback, scan_segmented, scan_compact, scan_radixcount,
+        scan_radixscatter,
 
-        scan_prefixsum, scan_offsets, scan_combine;
+        transform;
   } programs;
 
   struct
@@ -107,20 +169,45 @@ public:
     GLuint scene = 0;
   } fbos;
 
+  // shared by all chunks
+  struct
+  {
+    GLuint scene_vbo = 0;
+    GLuint scene_ibo = 0;
+    GLuint scene_bboxTable = 0;  // dual-index mode, the distinct bboxes
+  } buffers;
+
+  struct
+  {
+    GLuint64 scene_ibo, scene_vbo;
+  } addresses;
+
   struct
+  {
+    GLuint scene_color        = 0;
+    GLuint scene_depthstencil = 0;
+  } textures;
+
+  // per chunk, sized by the objects of the chunk
+  struct ChunkBuffers
   {
     GLuint scene_ubo           = 0;
-    GLuint scene_vbo           = 0;
-    GLuint scene_ibo           = 0;
     GLuint scene_matrices      = 0;
     GLuint scene_bboxes        = 0;
+    GLuint scene_bboxIndices   = 0;  // dual-index mode, into scene_bboxTable
     GLuint scene_matrixindices = 0;
     GLuint scene_indirect      = 0;
 
+    // inputs and outputs of the GPU transform, created on first use
+    GLuint scene_transforms     = 0;
+    GLuint scene_transformOrder = 0;
+
     GLuint scene_token        = 0;
     GLuint scene_tokenSizes   = 0;
     GLuint scene_tokenOffsets = 0;
     GLuint scene_tokenObjects = 0;
+    GLuint scene_tokenSequence = 0;
+    GLuint scene_sequences     = 0;
 
     GLuint cull_output                      = 0;
     GLuint cull_bits                        = 0;
@@ -129,24 +216,16 @@ public:
     GLuint cull_indirect                    = 0;
     GLuint cull_counter                     = 0;
 
-    GLuint cull_token            = 0;
-    GLuint cull_tokenEmulation   = 0;
-    GLuint cull_tokenSizes       = 0;
-    GLuint cull_tokenScan        = 0;
-    GLuint cull_tokenScanOffsets = 0;
-  } buffers;
-
-  struct
-  {
-    GLuint64 scene_ubo, scene_ibo, scene_vbo, scene_matrixindices;
-  } addresses;
-
-  struct
-  {
-    GLuint scene_color        = 0;
-    GLuint scene_depthstencil = 0;
-    GLuint scene_matrices     = 0;
-  } textures;
+    GLuint cull_token                               = 0;
+    GLuint cull_tokenEmulation[CYCLIC_FRAMES]       = {0};
+    GLuint cull_tokenSizes                          = 0;
+    GLuint cull_tokenScan                           = 0;
+    GLuint cull_tokenScanOffsets                    = 0;
+    GLuint cull_tokenVisible                        = 0;
+    GLuint cull_tokenVisibleReadback                = 0;
+    GLuint cull_tokenUsed                           = 0;
+    GLuint cull_tokenUsedReadback                   = 0;
+  };
 
   struct DrawCmd
   {
@@ -157,6 +236,11 @@ public:
     GLuint baseInstance;
   };
 
+  // matrices of an object on the GPU, see CULLSYS_MATRIX_COMPACT
+  typedef cullsys_glsl::MatrixData MatrixData;
+  // bbox of an object on the GPU, see CULLSYS_BBOX_QUANTIZED
+  typedef cullsys_glsl::BboxData BboxData;
+
   struct CullBbox
   {
     glm::vec4 min;
@@ -165,10 +249,15 @@ public:
 
   struct Geometry
   {
-    GLuint firstIndex;
-    GLuint count;
+    GLuint   firstIndex;
+    GLuint   count;
+    CullBbox bbox;
   };
 
+  // called for every object of the scene, which becomes one drawcall,
+  // parent is the index of an earlier object or -1
+  typedef std::function<void(const Geometry& geom, const glm::mat4& matrix, int64_t parent)> AddObjectFunc;
+
   struct Vertex
   {
 
@@ -179,6 +268,13 @@ public:
       color    = glm::vec4(1.0f);
     }
 
+    Vertex(const sceneimport::Vertex& vertex)
+    {
+      position = glm::vec4(vertex.position, 1.0f);
+      normal   = glm::vec4(vertex.normal, 0.0f);
+      color    = vertex.color;
+    }
+
     glm::vec4 position;
     glm::vec4 normal;
     glm::vec4 color;
@@ -195,14 +291,62 @@ public:
       int    num;
     };
 
+    enum Mode
+    {
+      MODE_AUTO,     // picks by the visible ratio of the last frames
+      MODE_COMPACT,  // sizes, scan and scatter into a compacted stream
+      MODE_NOP,      // copy of the original stream, invisible tokens become NOPs
+    };
+
+    // hysteresis for MODE_AUTO
+    static constexpr float NOP_RATIO_ENTER = 0.6f;
+    static constexpr float NOP_RATIO_LEAVE = 0.4f;
+
     void resultFromBits(const CullingSystem::Buffer& bufferVisBitsCurrent);
 
     GLuint program_sizes;
     GLuint program_cmds;
+    GLuint program_nops;
 
     GLuint                numTokens;
+    GLuint                numObjectTokens;  // tokens that belong to an object
     std::vector<Sequence> sequences;
 
+    Mode  mode         = MODE_AUTO;
+    bool  useNops      = false;
+    float visibleRatio = 1.0f;
+
+    // used 32-bit words of tokenOut
+    ScanSystem::Buffer tokenOutUsed;
+
+    // For emulation tokenOut cycles through persistent mapped buffers,
+    // so only the used part of the stream needs to be read by the CPU.
+    bool           readbackRing = false;
+    GLuint         readbackBuffers[CYCLIC_FRAMES]  = {};
+    const GLubyte* readbackMappings[CYCLIC_FRAMES] = {};
+    GLsync         readbackFences[CYCLIC_FRAMES]   = {};
+    GLuint         readbackUsed                    = 0;  // CYCLIC_FRAMES used sizes
+    const GLuint*  readbackUsedMapping             = nullptr;
+    uint32_t       readbackCycle                   = 0;
+    uint32_t       readbackLast                    = 0;
+
+    // waits for the last result and copies its used part to data,
+    // returns the size in bytes, or 0 if there is no result yet.
+    // The wait is intentional: the CPU replays the stream of the frame's
+    // own result, RESULT_REGULAR_LASTFRAME reads it before the new cull
+    // and so gets the previous frame's slot, whose fence is done.
+    size_t readbackResult(void* data);
+
+    // drops pending results, before the buffers are recreated
+    void resetResults();
+
+    // visible object tokens, read back with CYCLIC_FRAMES latency
+    ScanSystem::Buffer visibleCounter;
+    GLuint             visibleReadback = 0;
+    const GLuint*      visibleMapping  = nullptr;
+    GLsync             visibleFences[CYCLIC_FRAMES] = {};
+    uint32_t           visibleCycle    = 0;
+
     // input buffers
     ScanSystem::Buffer tokenOrig;
     // for each command
@@ -210,12 +354,19 @@ public:
     ScanSystem::Buffer tokenSizes;    //
     ScanSystem::Buffer tokenOffsets;  //
     ScanSystem::Buffer tokenObjects;  // -1 if no drawcall, otherwise object
+    ScanSystem::Buffer tokenSequence; // sequence index
+    ScanSystem::Buffer sequenceInfos; // Sequence per sequence
 
     // outputs
     ScanSystem::Buffer tokenOut;
     ScanSystem::Buffer tokenOutSizes;
     ScanSystem::Buffer tokenOutScan;
     ScanSystem::Buffer tokenOutScanOffset;
+
+  private:
+    void resultFromBitsCompact(const CullingSystem::Buffer& bufferVisBitsCurrent);
+    void resultFromBitsNop(const CullingSystem::Buffer& bufferVisBitsCurrent);
+    void updateVisibleRatio();
   };
 
   struct Tweak
@@ -230,6 +381,11 @@ public:
     float                     minPixelSize  = 0.0f;
     float                     animate       = 0;
     float                     animateOffset = 0;
+    int                       queryLatency  = 0;
+    CullJobToken::Mode        tokenCullMode = CullJobToken::MODE_AUTO;
+    bool                      gpuTransform  = false;
+    float                     spin          = 0;  // only animated by the GPU transform
+    int                       sceneEdits    = 0;  // random objects edited per frame
     // for benchmarking set this higher, influences the total number of objects
     // numObjects = grid * grid * grid
     int grid = 26;
@@ -249,11 +405,70 @@ public:
   std::vector<uint32_t>  m_sceneVisBits;
   std::vector<DrawCmd>   m_sceneCmds;
   std::vector<glm::mat4> m_sceneMatrices;
-  std::vector<glm::mat4> m_sceneMatricesAnimated;
+  std::vector<int64_t>   m_sceneParents;
+  // distinct geometries of the objects, what geometry edits pick from
+  std::vector<Geometry>  m_sceneGeometries;
+  std::vector<uint32_t>  m_sceneObjectGeometries;  // per object
+  std::vector<int>       m_sceneGeometryBboxes;    // dual-index mode, per geometry into the bbox table
+  std::mt19937           m_sceneEditRandom;
+  glm::mat4              m_sceneRotator = glm::mat4(1);
+  // per-frame uploads are staged here and copied on the GPU
+  UploadRing m_uploadRing;
+
+  // objects modified since the last flushSceneEdits
+  struct
+  {
+    std::vector<uint32_t> cmds;
+    std::vector<uint32_t> matrices;
+  } m_sceneEdits;
+  bool m_sceneEditVerify     = false;  // compare the patched buffers every frame
+  bool m_sceneEditVerifyOnce = false;
+
+  // the token stream starts with the scene bindings, followed by one draw token per object
+  static const size_t TOKEN_STATE_COUNT = 5;
+  static const size_t TOKEN_STATE_SIZE  = sizeof(NVTokenUbo) * 2 + sizeof(NVTokenVbo) * 2 + sizeof(NVTokenIbo);
+
+  // profiler sections recorded by the benchmark
+  static const int BENCHMARK_SECTIONS = 13;
+
+  // Objects are split into chunks of at most m_chunkObjects. Host arrays
+  // span the whole scene, while every chunk has its own buffers, culling
+  // jobs and token stream range, so draw counts, token offsets and scans
+  // stay within 32 bit no matter how large the scene gets.
+  struct Chunk
+  {
+    size_t first;        // first object
+    GLuint count;        // objects
+    size_t firstToken;   // into the token tables
+    GLuint numTokens;
+    size_t tokenOffset;  // bytes into m_tokenStream
+    size_t tokenSize;
+
+    // objects of the GPU transform are sorted by their depth in the
+    // hierarchy, level i covers [transformLevels[i], transformLevels[i + 1])
+    std::vector<GLuint> transformLevels;
+
+    ChunkBuffers buffers;
+    GLuint       texMatrices = 0;
+    GLuint64     addressUbo;
+    GLuint64     addressMatrixIndices;
+
+    CullingSystem::JobReadbackPersistent cullJobReadback;
+    CullingSystem::JobIndirectUnordered  cullJobIndirect;
+    CullJobToken                         cullJobToken;
+    size_t                               culledSize = 0;  // of the emulated stream read back this frame
+    CullingSystem::Buffer                cullReadbackBuffers[CYCLIC_FRAMES];
+    void*                                cullReadbackMappings[CYCLIC_FRAMES];
+  };
 
-  GLuint      m_numTokens;
-  std::string m_tokenStream;
-  std::string m_tokenStreamCulled;
+  std::vector<Chunk> m_chunks;
+  uint32_t           m_chunkObjects = 1 << 20;
+  bool               m_dualIndex    = false;  // objects index a table of distinct bboxes
+  glm::vec4          m_bboxFrame[2] = {glm::vec4(0), glm::vec4(1)};  // min and scale of quantized bboxes
+
+  std::string    m_tokenStream;
+  std::string    m_tokenStreamCulled;
+  NVTokenDecoded m_tokenStreamDecoded;
 
 
   double   m_statsTime;
@@ -261,30 +476,170 @@ public:
   bool     m_cmdlistNative;
   bool     m_bindlessVboUbo;
   uint32_t m_cullFrameCycle;
+  uint32_t m_scanTest      = 0;  // max elements, 1 for the default
+  uint32_t m_scanBenchmark = 0;  // max elements
+  std::string m_sceneCache;
+  std::string m_sceneFile;       // .gltf/.glb/.obj instead of the grid
+  std::string m_sceneInstances;  // .csv instance table for m_sceneFile
+  std::string m_tokenReport;  // written once culling produced a result
+  bool        m_headless = false;  // EGL context without a window
+  HeadlessGL  m_headlessGL;
+
+  // microseconds over the per-frame samples of one profiler section
+  struct BenchmarkStats
+  {
+    uint32_t samples;  // 0 if the section was not used
+    double   mean;
+    double   median;
+    double   p95;
+    double   p99;
+    double   stddev;
+  };
+
+  // unattended sweep over all supported configurations, after the warm-up
+  // every configuration is measured until the 95% confidence interval of
+  // the mean frame time converges or the time cap is reached
+  struct BenchmarkRun
+  {
+    Tweak          tweak;
+    uint32_t       objects;
+    uint32_t       visible;
+    uint32_t       frames;
+    double         time;
+    double         confidence;  // half width of the 95% interval of the mean GPU frame time
+    bool           converged;
+    bool           skipped;     // the scene for the grid could not be created
+    bool           throttled;   // frame times drifted upwards while measuring
+    uint32_t       outliers;    // frames far off the median
+    BenchmarkStats gpu[BENCHMARK_SECTIONS];
+    BenchmarkStats cpu[BENCHMARK_SECTIONS];
+  };
+
+  // allocated bytes per buffer, once per grid
+  struct BenchmarkMemory
+  {
+    int                                         grid;
+    uint32_t                                    objects;
+    std::vector<std::pair<const char*, size_t>> buffers;
+    std::vector<std::pair<const char*, size_t>> host;
+  };
+
+  // time = fixed + perObject * objects, least squares over all grids of a configuration
+  struct BenchmarkFit
+  {
+    double   fixed;      // microseconds
+    double   perObject;  // nanoseconds
+    double   r2;
+    uint32_t knee;  // objects at which the marginal cost doubled, 0 if it scaled linearly
+  };
 
-  CullingSystem                        m_cullSys;
-  CullingSystem::JobReadbackPersistent m_cullJobReadback;
-  CullingSystem::JobIndirectUnordered  m_cullJobIndirect;
-  CullJobToken                         m_cullJobToken;
-  CullingSystem::Buffer                m_cullReadbackBuffers[CYCLIC_FRAMES];
-  void*                                m_cullReadbackMappings[CYCLIC_FRAMES];
+  struct
+  {
+    std::string                  filename;          // .csv or .json results
+    std::string                  grids;             // comma separated, defaults to the current grid
+    bool                         sweep     = false;  // grids 8 to 256 unless given
+    uint32_t                     frames    = 64;     // minimum measured frames
+    uint32_t                     warmup    = 16;
+    float                        tolerance = 0.01f;  // relative confidence interval
+    float                        maxTime   = 10.0f;  // seconds per configuration
+    std::vector<BenchmarkRun>    runs;
+    std::vector<BenchmarkMemory> memory;
+    size_t                       current = 0;
+    uint32_t                     frame   = 0;
+    double                       startTime;
+
+    // the profiler only provides averages, per-frame times are taken
+    // from the difference of the accumulated totals
+    std::vector<double> gpuSamples[BENCHMARK_SECTIONS];
+    std::vector<double> cpuSamples[BENCHMARK_SECTIONS];
+    double              gpuTotal[BENCHMARK_SECTIONS];
+    double              cpuTotal[BENCHMARK_SECTIONS];
+    uint32_t            numAveraged[BENCHMARK_SECTIONS];
+  } m_benchmark;
+
+  CullingSystem m_cullSys;
 
   bool begin();
   void processUI(double time);
   void think(double time);
   void resize(int width, int height);
 
-  void initCullingJob(CullingSystem::Job& cullJob);
+  // runs -benchmarkmatrix without opening a window
+  int runHeadless(int argc, const char** argv, int width, int height);
+
+  void initCullingJob(CullingSystem::Job& cullJob, Chunk& chunk);
+  void initCullingJobs();
+  void deinitChunk(Chunk& chunk);
+  bool rebuildScene(int grid);
+
+  // world matrices computed by transform.comp.glsl
+  void initTransforms(Chunk& chunk);
+  int  getTransformParent(const Chunk& chunk, size_t index) const;
+  void fillTransforms(const Chunk& chunk, size_t first, size_t count, TransformObject* dst);
+  void transformScene(const glm::mat4& rotator, float spinAngle);
 
   void drawScene(bool depthonly, const char* what);
 
-  void drawCullingRegular(CullingSystem::Job& cullJob);
-  void drawCullingRegularLastFrame(CullingSystem::Job& cullJob);
-  void drawCullingTemporal(CullingSystem::Job& cullJob);
+  void drawCullingRegular();
+  void drawCullingRegularLastFrame();
+  void drawCullingTemporal();
+
+  // the culling steps, applied to the job of every chunk
+  CullingSystem::Job& getCullJob(Chunk& chunk);
+  void                cullOutput(CullingSystem::MethodType method, const CullingSystem::View& view);
+  void                cullBits(CullingSystem::BitType type);
+  void                cullResult();
+  void                cullResultClient();
+  void                cullSwapBits();
 
   bool initProgram();
   bool initFramebuffers(int width, int height);
   bool initScene(int grid);
+  void generateScene(int grid, nvh::geometry::Mesh<Vertex>& mesh, const AddObjectFunc& addObject);
+  bool importScene(nvh::geometry::Mesh<Vertex>& mesh, const AddObjectFunc& addObject);
+  bool loadSceneCache(nvh::FileReadMapping& mapping, int grid, const void* sections[], size_t sectionSizes[]);
+  void saveSceneCache(int grid, const void* const sections[], const size_t sectionSizes[]);
+
+  // live scene edits, the GPU copies are patched in flushSceneEdits
+  void updateObject(uint32_t obj, uint32_t geometry);
+  void updateObjectMatrix(uint32_t obj, const glm::mat4& matrix);
+  void flushSceneEdits();
+  // moves or swaps the geometry of random objects
+  void editScene(int count);
+  // compares the patched GPU buffers with what initScene uploads for
+  // the current host data, returns false on any mismatch
+  bool verifySceneEdits();
+
+  // uploads the given objects, one copy from the upload ring per run of
+  // consecutive objects within a chunk, fill writes the elements of a run,
+  // the elements start at bufferOffset
+  template <class T>
+  void uploadRanges(GLuint ChunkBuffers::*buffer, size_t elementSize, std::vector<uint32_t>& objects, T fill, size_t bufferOffset = 0);
+  void animateMatrices(size_t first, size_t count, void* dst);
+
+  // object bboxes as BboxData, or as index into the bbox table in dual-index mode
+  GLuint ChunkBuffers::*getObjectBboxBuffer() const
+  {
+    return m_dualIndex ? &ChunkBuffers::scene_bboxIndices : &ChunkBuffers::scene_bboxes;
+  }
+  size_t getObjectBboxSize() const { return m_dualIndex ? sizeof(int) : sizeof(BboxData); }
+  void   fillObjectBboxes(const Chunk& chunk, size_t first, size_t count, void* dst);
+  BboxData packBbox(const CullBbox& bbox) const;
+  void     uploadBboxes(GLuint& buffer, const CullBbox* bboxes, size_t count);
+
+  void writeTokenReport(const char* filename);
+
+  void benchmarkInit();
+  void benchmarkAdvance();
+  void benchmarkNext();
+  void benchmarkStart();
+  void benchmarkSample();
+  bool benchmarkDone();
+  void benchmarkRecord(BenchmarkRun& run);
+  void benchmarkWrite(const char* filename);
+  void benchmarkWriteMemory(FILE* file, bool csv);
+  void benchmarkWriteFits(FILE* file, bool csv);
+  void getMemoryUsage(BenchmarkMemory& memory);
   void getCullPrograms(CullingSystem::Programs& cullprograms);
   void getScanPrograms(ScanSystem::Programs& scanprograms);
   void systemChange();
@@ -306,8 +661,31 @@ public:
     m_parameterList.add("animate", &m_tweak.animate);
     m_parameterList.add("culling", &m_tweak.culling);
     m_parameterList.add("noui", &m_tweak.noui, true);
+    m_parameterList.add("headless", &m_headless, true);
     m_parameterList.add("minpixelsize", &m_tweak.minPixelSize);
     m_parameterList.add("animateoffset", &m_tweak.animateOffset);
+    m_parameterList.add("querylatency", &m_tweak.queryLatency);
+    m_parameterList.add("tokencullmode", (int32_t*)&m_tweak.tokenCullMode);
+    m_parameterList.add("gputransform", &m_tweak.gpuTransform);
+    m_parameterList.add("spin", &m_tweak.spin);
+    m_parameterList.add("sceneedits", &m_tweak.sceneEdits);
+    m_parameterList.add("sceneeditverify", &m_sceneEditVerify);
+    m_parameterList.add("scantest", &m_scanTest);
+    m_parameterList.add("scanbenchmark", &m_scanBenchmark);
+    m_parameterList.add("scenecache", &m_sceneCache);
+    m_parameterList.add("scene", &m_sceneFile);
+    m_parameterList.add("sceneinstances", &m_sceneInstances);
+    m_parameterList.add("tokenreport", &m_tokenReport);
+    m_parameterList.add("grid", &m_tweak.grid);
+    m_parameterList.add("chunkobjects", &m_chunkObjects);
+    m_parameterList.add("dualindex", &m_dualIndex);
+    m_parameterList.add("benchmarkmatrix", &m_benchmark.filename);
+    m_parameterList.add("benchmarkgrids", &m_benchmark.grids);
+    m_parameterList.add("benchmarksweep", &m_benchmark.sweep, true);
+    m_parameterList.add("benchmarkframes", &m_benchmark.frames);
+    m_parameterList.add("benchmarkwarmup", &m_benchmark.warmup);
+    m_parameterList.add("benchmarktolerance", &m_benchmark.tolerance);
+    m_parameterList.add("benchmarkmaxtime", &m_benchmark.maxTime);
   }
 };
 
@@ -319,33 +697,41 @@ bool Sample::initProgram()
   m_progManager.addDirectory(exePath() + std::string(PROJECT_RELDIRECTORY));
 
   m_progManager.registerInclude("common.h");
+  m_progManager.registerInclude("cull-common.h");
   m_progManager.registerInclude("noise.glsl");
 
   programs.draw_scene = m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, "scene.vert.glsl"),
                                                     nvgl::ProgramManager::Definition(GL_FRAGMENT_SHADER, "scene.frag.glsl"));
 
+  // shaders that read the object bboxes, the mode is fixed at startup
+  std::string cullDefines = m_dualIndex ? "#define DUALINDEX\n" : "";
+
   programs.object_raster_geo =
-      m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, "cull-raster-geo.vert.glsl"),
+      m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, cullDefines, "cull-raster-geo.vert.glsl"),
                                   nvgl::ProgramManager::Definition(GL_GEOMETRY_SHADER, "cull-raster-geo.geo.glsl"),
                                   nvgl::ProgramManager::Definition(GL_FRAGMENT_SHADER, "cull-raster.frag.glsl"));
 
   programs.object_raster_instanced =
-      m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, "cull-raster-instanced.vert.glsl"),
+      m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, cullDefines, "cull-raster-instanced.vert.glsl"),
                                   nvgl::ProgramManager::Definition(GL_FRAGMENT_SHADER, "cull-raster.frag.glsl"));
 
+  programs.object_raster_query = m_progManager.createProgram(
+      nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, cullDefines + "#define QUERIES\n", "cull-raster-instanced.vert.glsl"),
+      nvgl::ProgramManager::Definition(GL_FRAGMENT_SHADER, "#define QUERIES\n", "cull-raster.frag.glsl"));
+
   if(has_GL_NV_mesh_shader)
   {
     programs.object_raster_mesh =
-        m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_TASK_SHADER_NV, "cull-raster-mesh.task.glsl"),
-                                    nvgl::ProgramManager::Definition(GL_MESH_SHADER_NV, "cull-raster-mesh.mesh.glsl"),
+        m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_TASK_SHADER_NV, cullDefines, "cull-raster-mesh.task.glsl"),
+                                    nvgl::ProgramManager::Definition(GL_MESH_SHADER_NV, cullDefines, "cull-raster-mesh.mesh.glsl"),
                                     nvgl::ProgramManager::Definition(GL_FRAGMENT_SHADER, "cull-raster.frag.glsl"));
   }
 
   programs.object_frustum =
-      m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, "cull-basic.vert.glsl"));
+      m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, cullDefines, "cull-basic.vert.glsl"));
 
   programs.object_hiz = m_progManager.createProgram(
-      nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, "#define OCCLUSION\n", "cull-basic.vert.glsl"));
+      nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, cullDefines + "#define OCCLUSION\n", "cull-basic.vert.glsl"));
 
   programs.bit_regular = m_progManager.createProgram(
       nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, "#define TEMPORAL 0\n", "cull-bitpack.comp.glsl"));
@@ -365,13 +751,35 @@ bool Sample::initProgram()
       m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, "cull-tokensizes.vert.glsl"));
   programs.token_cmds =
       m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, "cull-tokencmds.vert.glsl"));
+  programs.token_nops =
+      m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_VERTEX_SHADER, "cull-tokennops.vert.glsl"));
+
+  // portable subgroup path for the scan if the NV warp shuffle is not available
+  std::string scanDefines;
+  if(GLuint subgroupSize = ScanSystem::getSubgroupSize())
+  {
+    scanDefines = "#define SUBGROUP_SIZE " + std::to_string(subgroupSize) + "\n";
+  }
 
   programs.scan_prefixsum = m_progManager.createProgram(
-      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, "#define TASK TASK_SUM\n", "scan.comp.glsl"));
+      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, scanDefines + "#define TASK TASK_SUM\n", "scan.comp.glsl"));
   programs.scan_offsets = m_progManager.createProgram(
-      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, "#define TASK TASK_OFFSETS\n", "scan.comp.glsl"));
+      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, scanDefines + "#define TASK TASK_OFFSETS\n", "scan.comp.glsl"));
   programs.scan_combine = m_progManager.createProgram(
-      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, "#define TASK TASK_COMBINE\n", "scan.comp.glsl"));
+      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, scanDefines + "#define TASK TASK_COMBINE\n", "scan.comp.glsl"));
+  programs.scan_lookback = m_progManager.createProgram(
+      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, scanDefines + "#define TASK TASK_LOOKBACK\n", "scan.comp.glsl"));
+  programs.scan_segmented = m_progManager.createProgram(
+      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, scanDefines + "#define TASK TASK_LOOKBACK\n#define SEGMENTED\n", "scan.comp.glsl"));
+  programs.scan_compact = m_progManager.createProgram(
+      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, scanDefines + "#define TASK TASK_COMPACT\n", "scan.comp.glsl"));
+  programs.scan_radixcount = m_progManager.createProgram(
+      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, scanDefines + "#define TASK TASK_RADIX_COUNT\n", "scan.comp.glsl"));
+  programs.scan_radixscatter = m_progManager.createProgram(
+      nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, scanDefines + "#define TASK TASK_RADIX_SCATTER\n", "scan.comp.glsl"));
+
+  programs.transform =
+      m_progManager.createProgram(nvgl::ProgramManager::Definition(GL_COMPUTE_SHADER, cullDefines, "transform.comp.glsl"));
 
   validated = m_progManager.areProgramsValid();
 
@@ -380,318 +788,1929 @@ bool Sample::initProgram()
 
 void Sample::getScanPrograms(ScanSystem::Programs& scanprograms)
 {
-  scanprograms.prefixsum = m_progManager.get(programs.scan_prefixsum);
-  scanprograms.offsets   = m_progManager.get(programs.scan_offsets);
-  scanprograms.combine   = m_progManager.get(programs.scan_combine);
+  scanprograms.prefixsum    = m_progManager.get(programs.scan_prefixsum);
+  scanprograms.offsets      = m_progManager.get(programs.scan_offsets);
+  scanprograms.combine      = m_progManager.get(programs.scan_combine);
+  scanprograms.lookback     = m_progManager.get(programs.scan_lookback);
+  scanprograms.segmented    = m_progManager.get(programs.scan_segmented);
+  scanprograms.compact      = m_progManager.get(programs.scan_compact);
+  scanprograms.radixCount   = m_progManager.get(programs.scan_radixcount);
+  scanprograms.radixScatter = m_progManager.get(programs.scan_radixscatter);
 }
 
-void Sample::getCullPrograms(CullingSystem::Programs& cullprograms)
+// fill(chunk, first, count, dst) writes the elements of the range, first is chunk-relative
+template <class T>
+void Sample::uploadRanges(GLuint ChunkBuffers::*buffer, size_t elementSize, std::vector<uint32_t>& objects, T fill, size_t bufferOffset)
 {
-  cullprograms.bit_regular             = m_progManager.get(programs.bit_regular);
-  cullprograms.bit_temporallast        = m_progManager.get(programs.bit_temporallast);
-  cullprograms.bit_temporalnew         = m_progManager.get(programs.bit_temporalnew);
-  cullprograms.depth_mips              = m_progManager.get(programs.depth_mips);
-  cullprograms.object_frustum          = m_progManager.get(programs.object_frustum);
-  cullprograms.object_hiz              = m_progManager.get(programs.object_hiz);
-  cullprograms.object_raster_geo       = m_progManager.get(programs.object_raster_geo);
-  cullprograms.object_raster_instanced = m_progManager.get(programs.object_raster_instanced);
-  if(has_GL_NV_mesh_shader)
+  std::vector<uint8_t> fallback;
+
+  std::sort(objects.begin(), objects.end());
+  objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+
+  for(size_t i = 0; i < objects.size();)
   {
-    cullprograms.object_raster_mesh = m_progManager.get(programs.object_raster_mesh);
+    Chunk& chunk = m_chunks[objects[i] / m_chunkObjects];
+
+    size_t begin = i;
+    while(i + 1 < objects.size() && objects[i + 1] == objects[i] + 1 && objects[i + 1] < chunk.first + chunk.count)
+    {
+      i++;
+    }
+    i++;
+
+    size_t first = objects[begin] - chunk.first;
+    size_t count = i - begin;
+
+    size_t ringOffset;
+    void*  ringData = m_uploadRing.alloc(count * elementSize, 16, ringOffset);
+    if(ringData)
+    {
+      fill(chunk, first, count, ringData);
+      glCopyNamedBufferSubData(m_uploadRing.getBuffer(), chunk.buffers.*buffer, ringOffset, bufferOffset + first * elementSize,
+                               count * elementSize);
+    }
+    else
+    {
+      fallback.resize(count * elementSize);
+      fill(chunk, first, count, fallback.data());
+      glNamedBufferSubData(chunk.buffers.*buffer, bufferOffset + first * elementSize, count * elementSize, fallback.data());
+    }
   }
 }
 
-static inline size_t snapdiv(size_t input, size_t align)
+// Scene matrices are affine, their bottom row (0,0,0,1) is skipped and the
+// translation column is added, 12 instead of 16 multiplies per matrix.
+// Their inverse-transposes have (0,0,0,1) as last column instead, which
+// leaves the product's last column at the one of matrix.
+#if ANIMATE_SSE
+static inline void multiplyAffine(const __m128 a[4], const float* b, bool inverseTranspose, __m128 c[4])
 {
-  return (input + align - 1) / align;
+  if(inverseTranspose)
+  {
+    for(int k = 0; k < 3; k++)
+    {
+      c[k] = _mm_mul_ps(a[0], _mm_set1_ps(b[k * 4 + 0]));
+      c[k] = _mm_add_ps(c[k], _mm_mul_ps(a[1], _mm_set1_ps(b[k * 4 + 1])));
+      c[k] = _mm_add_ps(c[k], _mm_mul_ps(a[2], _mm_set1_ps(b[k * 4 + 2])));
+      c[k] = _mm_add_ps(c[k], _mm_mul_ps(a[3], _mm_set1_ps(b[k * 4 + 3])));
+    }
+    c[3] = a[3];
+  }
+  else
+  {
+    for(int k = 0; k < 4; k++)
+    {
+      c[k] = _mm_mul_ps(a[0], _mm_set1_ps(b[k * 4 + 0]));
+      c[k] = _mm_add_ps(c[k], _mm_mul_ps(a[1], _mm_set1_ps(b[k * 4 + 1])));
+      c[k] = _mm_add_ps(c[k], _mm_mul_ps(a[2], _mm_set1_ps(b[k * 4 + 2])));
+    }
+    c[3] = _mm_add_ps(c[3], a[3]);
+  }
 }
-
-static inline GLuint num32bit(size_t input)
+#else
+static inline glm::mat4 multiplyAffine(const glm::mat4& a, const glm::mat4& b, bool inverseTranspose)
 {
-  return GLuint(input / sizeof(GLuint));
+  glm::mat4 c;
+  if(inverseTranspose)
+  {
+    for(int k = 0; k < 3; k++)
+    {
+      c[k] = a[0] * b[k][0] + a[1] * b[k][1] + a[2] * b[k][2] + a[3] * b[k][3];
+    }
+    c[3] = a[3];
+  }
+  else
+  {
+    for(int k = 0; k < 4; k++)
+    {
+      c[k] = a[0] * b[k][0] + a[1] * b[k][1] + a[2] * b[k][2];
+    }
+    c[3] += a[3];
+  }
+  return c;
 }
+#endif
 
-bool Sample::initScene(int grid)
+// dst[i * stride] = matrix * src[i * stride], src affine or the inverse-transpose of one
+static void multiplyMatrices(const glm::mat4& matrix, const glm::mat4* src, glm::mat4* dst, size_t count, size_t stride, bool inverseTranspose)
 {
-  {  // Scene UBO
-    nvgl::newBuffer(buffers.scene_ubo);
-    glNamedBufferData(buffers.scene_ubo, sizeof(SceneData) + sizeof(GLuint64), NULL, GL_DYNAMIC_DRAW);
-  }
-
-  {  // Scene Geometry
-    nvh::geometry::Mesh<Vertex> sceneMesh;
-
-    // we store all geometries in one big mesh, for sake of simplicity
-    // and to allow standard MultiDrawIndirect to be efficient
-
-    std::vector<Geometry> geometries;
-    for(int i = 0; i < 37; i++)
+#if ANIMATE_SSE
+  const float* m    = (const float*)&matrix;
+  __m128       a[4] = {_mm_loadu_ps(m + 0), _mm_loadu_ps(m + 4), _mm_loadu_ps(m + 8), _mm_loadu_ps(m + 12)};
+  for(size_t i = 0; i < count; i++)
+  {
+    __m128 c[4];
+    multiplyAffine(a, (const float*)&src[i * stride], inverseTranspose, c);
+    float* d = (float*)&dst[i * stride];
+    for(int k = 0; k < 4; k++)
     {
-      const int resmul = 2;
-      mat4      identity(1);
-
-      uint oldverts   = sceneMesh.getVerticesCount();
-      uint oldindices = sceneMesh.getTriangleIndicesCount();
-
-      switch(i % 2)
-      {
-        case 0:
-          nvh::geometry::Sphere<Vertex>::add(sceneMesh, identity, 16 * resmul, 8 * resmul);
-          break;
-        case 1:
-          nvh::geometry::Box<Vertex>::add(sceneMesh, identity, 8 * resmul, 8 * resmul, 8 * resmul);
-          break;
-      }
-
-      vec4 color(nvh::frand(), nvh::frand(), nvh::frand(), 1.0f);
-      for(uint v = oldverts; v < sceneMesh.getVerticesCount(); v++)
-      {
-        sceneMesh.m_vertices[v].color = color;
-      }
-
-      Geometry geom;
-      geom.firstIndex = oldindices;
-      geom.count      = sceneMesh.getTriangleIndicesCount() - oldindices;
-
-      geometries.push_back(geom);
+      _mm_storeu_ps(d + k * 4, c[k]);
     }
+  }
+#else
+  for(size_t i = 0; i < count; i++)
+  {
+    dst[i * stride] = multiplyAffine(matrix, src[i * stride], inverseTranspose);
+  }
+#endif
+}
 
-    nvgl::newBuffer(buffers.scene_ibo);
-    glNamedBufferData(buffers.scene_ibo, sceneMesh.getTriangleIndicesSize(), sceneMesh.m_indicesTriangles.data(), GL_STATIC_DRAW);
-
-    nvgl::newBuffer(buffers.scene_vbo);
-    glNamedBufferData(buffers.scene_vbo, sceneMesh.getVerticesSize(), sceneMesh.m_vertices.data(), GL_STATIC_DRAW);
+// dst[i] = first three rows of matrix * src[i * stride], src affine
+static void multiplyMatricesRows(const glm::mat4& matrix, const glm::mat4* src, glm::vec4 (*dst)[3], size_t count, size_t stride)
+{
+#if ANIMATE_SSE
+  const float* m    = (const float*)&matrix;
+  __m128       a[4] = {_mm_loadu_ps(m + 0), _mm_loadu_ps(m + 4), _mm_loadu_ps(m + 8), _mm_loadu_ps(m + 12)};
+  for(size_t i = 0; i < count; i++)
+  {
+    __m128 c[4];
+    multiplyAffine(a, (const float*)&src[i * stride], false, c);
+    // columns to rows
+    _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+    float* d = (float*)dst[i];
+    _mm_storeu_ps(d + 0, c[0]);
+    _mm_storeu_ps(d + 4, c[1]);
+    _mm_storeu_ps(d + 8, c[2]);
+  }
+#else
+  for(size_t i = 0; i < count; i++)
+  {
+    glm::mat4 world = multiplyAffine(matrix, src[i * stride], false);
+    dst[i][0]       = glm::row(world, 0);
+    dst[i][1]       = glm::row(world, 1);
+    dst[i][2]       = glm::row(world, 2);
+  }
+#endif
+}
 
+void Sample::animateMatrices(size_t first, size_t count, void* dst)
+{
+  const mat4* src    = &m_sceneMatrices[first * 2];
+  MatrixData* output = (MatrixData*)dst;
+#if CULLSYS_MATRIX_COMPACT
+  static_assert(sizeof(MatrixData) == sizeof(glm::vec4) * 3, "unexpected MatrixData");
+  multiplyMatricesRows(m_sceneRotator, src, (glm::vec4(*)[3])output, count, 2);
+#else
+  // (R * M)^-T = R^-T * M^-T, the inverse-transpose of the static matrix
+  // is stored already, so no per-object inverse is needed
+  mat4 rotatorIT = glm::transpose(glm::inverse(m_sceneRotator));
+
+  multiplyMatrices(m_sceneRotator, src, &output->worldTM, count, 2, false);
+  multiplyMatrices(rotatorIT, src + 1, &output->worldInvTransTM, count, 2, true);
+#endif
+}
 
-    // Scene Objects
-    std::vector<CullBbox> bboxes;
-    std::vector<int>      matrixIndex;
+Sample::BboxData Sample::packBbox(const CullBbox& bbox) const
+{
+  BboxData data;
+#if CULLSYS_BBOX_QUANTIZED
+  // min rounds down and max up, the quantized box always contains the original
+  glm::vec3  qmin = glm::floor(glm::vec3((bbox.min - m_bboxFrame[0]) / m_bboxFrame[1]));
+  glm::vec3  qmax = glm::ceil(glm::vec3((bbox.max - m_bboxFrame[0]) / m_bboxFrame[1]));
+  glm::uvec3 bmin = glm::uvec3(glm::clamp(qmin, glm::vec3(0), glm::vec3(65535)));
+  glm::uvec3 bmax = glm::uvec3(glm::clamp(qmax, glm::vec3(0), glm::vec3(65535)));
+
+  data.bboxPacked = glm::uvec4(bmin.x | (bmin.y << 16), bmin.z | (bmax.x << 16), bmax.y | (bmax.z << 16), 0u);
+#else
+  data.bboxMin = bbox.min;
+  data.bboxMax = bbox.max;
+#endif
+  return data;
+}
 
-    CullBbox bbox;
-    bbox.min = vec4(-1, -1, -1, 1);
-    bbox.max = vec4(1, 1, 1, 1);
+void Sample::uploadBboxes(GLuint& buffer, const CullBbox* bboxes, size_t count)
+{
+  std::vector<BboxData> packed(count);
+  for(size_t i = 0; i < count; i++)
+  {
+    packed[i] = packBbox(bboxes[i]);
+  }
+  nvgl::newBuffer(buffer);
+  glNamedBufferStorage(buffer, sizeof(BboxData) * count, packed.data(), 0);
+}
 
-    int obj = 0;
-    for(int i = 0; i < grid * grid * grid; i++)
+void Sample::fillObjectBboxes(const Chunk& chunk, size_t first, size_t count, void* dst)
+{
+  const uint32_t* geometries = &m_sceneObjectGeometries[chunk.first + first];
+  if(m_dualIndex)
+  {
+    int* indices = (int*)dst;
+    for(size_t i = 0; i < count; i++)
     {
-
-      vec3 pos(i % grid, (i / grid) % grid, i / (grid * grid));
-
-      pos -= vec3(grid / 2, grid / 2, grid / 2);
-      pos += (vec3(nvh::frand(), nvh::frand(), nvh::frand()) * 2.0f) - vec3(1.0f);
-      pos /= float(grid);
-
-      float scale;
-      if(glm::length(pos) < 0.52f)
-      {
-        scale = globalscale * 0.35f;
-        pos *= globalscale * 0.5f;
-      }
-      else
-      {
-        scale = globalscale;
-        pos *= globalscale;
-      }
-
-      mat4 matrix =
-          glm::translate(glm::mat4(1.f), pos) * glm::rotate(glm::mat4(1), nvh::frand() * glm::pi<float>(), glm::vec3(0, 1, 0))
-          * glm::scale(glm::mat4(1.f),
-                       (vec3(scale) * (vec3(0.25f) + vec3(nvh::frand(), nvh::frand(), nvh::frand()) * 0.5f)) / float(grid));
-
-      m_sceneMatrices.push_back(matrix);
-      m_sceneMatrices.push_back(glm::transpose(glm::inverse(matrix)));
-      matrixIndex.push_back(obj);
-
-      // all have same bbox
-      bboxes.push_back(bbox);
-
-      DrawCmd cmd;
-      cmd.count         = geometries[obj % geometries.size()].count;
-      cmd.firstIndex    = geometries[obj % geometries.size()].firstIndex;
-      cmd.baseVertex    = 0;
-      cmd.baseInstance  = obj;
-      cmd.instanceCount = 1;
-
-      m_sceneCmds.push_back(cmd);
-      obj++;
+      indices[i] = m_sceneGeometryBboxes[geometries[i]];
     }
-
-    m_sceneMatricesAnimated.resize(m_sceneMatrices.size());
-
-    m_sceneVisBits.clear();
-    m_sceneVisBits.resize(snapdiv(m_sceneCmds.size(), 32), 0xFFFFFFFF);
-
-    nvgl::newBuffer(buffers.scene_indirect);
-    glNamedBufferData(buffers.scene_indirect, sizeof(DrawCmd) * m_sceneCmds.size(), m_sceneCmds.data(), GL_STATIC_DRAW);
-
-    nvgl::newBuffer(buffers.scene_matrices);
-    glNamedBufferData(buffers.scene_matrices, sizeof(mat4) * m_sceneMatrices.size(), m_sceneMatrices.data(), GL_STATIC_DRAW);
-    nvgl::newTexture(textures.scene_matrices, GL_TEXTURE_BUFFER);
-    glTextureBuffer(textures.scene_matrices, GL_RGBA32F, buffers.scene_matrices);
-
-    if(has_GL_ARB_bindless_texture)
+  }
+  else
+  {
+    BboxData* bboxes = (BboxData*)dst;
+    for(size_t i = 0; i < count; i++)
     {
-      GLuint64 handle = glGetTextureHandleARB(textures.scene_matrices);
-      glMakeTextureHandleResidentARB(handle);
-      glNamedBufferSubData(buffers.scene_ubo, sizeof(SceneData), sizeof(GLuint64), &handle);
+      bboxes[i] = packBbox(m_sceneGeometries[geometries[i]].bbox);
     }
+  }
+}
 
-    nvgl::newBuffer(buffers.scene_bboxes);
-    glNamedBufferData(buffers.scene_bboxes, sizeof(CullBbox) * bboxes.size(), bboxes.data(), GL_STATIC_DRAW);
-
-    nvgl::newBuffer(buffers.scene_matrixindices);
-    glNamedBufferData(buffers.scene_matrixindices, sizeof(int) * matrixIndex.size(), matrixIndex.data(), GL_STATIC_DRAW);
+void Sample::updateObject(uint32_t obj, uint32_t geometry)
+{
+  assert(obj < m_sceneCmds.size() && geometry < m_sceneGeometries.size());
+  const Geometry& geom = m_sceneGeometries[geometry];
+  DrawCmd&        cmd  = m_sceneCmds[obj];
+  cmd.count            = geom.count;
+  cmd.firstIndex       = geom.firstIndex;
+  // the bbox follows the geometry
+  m_sceneObjectGeometries[obj] = geometry;
+
+  // cmd.baseInstance is relative to the chunk of the object,
+  // draw tokens have a fixed size, token offsets and the sequences
+  // of the chunk's token job stay valid
+  const Chunk&               chunk = m_chunks[obj / m_chunkObjects];
+  NVTokenDrawElemsInstanced* drawtoken =
+      (NVTokenDrawElemsInstanced*)&m_tokenStream[chunk.tokenOffset + TOKEN_STATE_SIZE
+                                                 + sizeof(NVTokenDrawElemsInstanced) * (obj - chunk.first)];
+  drawtoken->cmd.baseInstance  = cmd.baseInstance;
+  drawtoken->cmd.baseVertex    = cmd.baseVertex;
+  drawtoken->cmd.firstIndex    = cmd.firstIndex;
+  drawtoken->cmd.instanceCount = cmd.instanceCount;
+  drawtoken->cmd.count         = cmd.count;
+
+  m_sceneEdits.cmds.push_back(obj);
+}
 
-    // for culling
-    nvgl::newBuffer(buffers.cull_indirect);
-    glNamedBufferData(buffers.cull_indirect, sizeof(DrawCmd) * m_sceneCmds.size(), NULL, GL_DYNAMIC_COPY);
+void Sample::updateObjectMatrix(uint32_t obj, const glm::mat4& matrix)
+{
+  assert(obj < m_sceneCmds.size());
+  m_sceneMatrices[size_t(obj) * 2 + 0] = matrix;
+  m_sceneMatrices[size_t(obj) * 2 + 1] = glm::transpose(glm::inverse(matrix));
 
-    nvgl::newBuffer(buffers.cull_counter);
-    glNamedBufferData(buffers.cull_counter, sizeof(int), NULL, GL_DYNAMIC_COPY);
+  m_sceneEdits.matrices.push_back(obj);
+}
 
-    nvgl::newBuffer(buffers.cull_output);
-    glNamedBufferData(buffers.cull_output, snapdiv(m_sceneCmds.size(), 32) * 32 * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+void Sample::flushSceneEdits()
+{
+  if(!m_sceneEdits.cmds.empty())
+  {
+    uploadRanges(&ChunkBuffers::scene_indirect, sizeof(DrawCmd), m_sceneEdits.cmds,
+                 [&](const Chunk& chunk, size_t first, size_t count, void* dst) {
+                   memcpy(dst, &m_sceneCmds[chunk.first + first], sizeof(DrawCmd) * count);
+                 });
+    // the draw tokens follow the state tokens of the chunk
+    uploadRanges(&ChunkBuffers::scene_token, sizeof(NVTokenDrawElemsInstanced), m_sceneEdits.cmds,
+                 [&](const Chunk& chunk, size_t first, size_t count, void* dst) {
+                   memcpy(dst, &m_tokenStream[chunk.tokenOffset + TOKEN_STATE_SIZE + sizeof(NVTokenDrawElemsInstanced) * first],
+                          sizeof(NVTokenDrawElemsInstanced) * count);
+                 },
+                 TOKEN_STATE_SIZE);
+    uploadRanges(getObjectBboxBuffer(), getObjectBboxSize(), m_sceneEdits.cmds,
+                 [&](const Chunk& chunk, size_t first, size_t count, void* dst) { fillObjectBboxes(chunk, first, count, dst); });
+    m_sceneEdits.cmds.clear();
+  }
 
-    nvgl::newBuffer(buffers.cull_bits);
-    glNamedBufferData(buffers.cull_bits, snapdiv(m_sceneCmds.size(), 32) * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+  if(!m_sceneEdits.matrices.empty() && m_tweak.gpuTransform)
+  {
+    // the next transformScene applies the animation
+    uploadRanges(&ChunkBuffers::scene_transforms, sizeof(TransformObject), m_sceneEdits.matrices,
+                 [&](const Chunk& chunk, size_t first, size_t count, void* dst) {
+                   fillTransforms(chunk, first, count, (TransformObject*)dst);
+                 });
+    m_sceneEdits.matrices.clear();
+  }
+  else if(!m_sceneEdits.matrices.empty())
+  {
+    // keep the current animation applied
+    uploadRanges(&ChunkBuffers::scene_matrices, sizeof(MatrixData), m_sceneEdits.matrices,
+                 [&](const Chunk& chunk, size_t first, size_t count, void* dst) { animateMatrices(chunk.first + first, count, dst); });
+    m_sceneEdits.matrices.clear();
+  }
+}
 
-    nvgl::newBuffer(buffers.cull_bitsLast);
-    glNamedBufferData(buffers.cull_bitsLast, snapdiv(m_sceneCmds.size(), 32) * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+void Sample::editScene(int count)
+{
+  if(m_sceneCmds.empty())
+  {
+    return;
+  }
 
-    for(int i = 0; i < CYCLIC_FRAMES; i++)
+  std::uniform_int_distribution<uint32_t> objects(0, uint32_t(m_sceneCmds.size() - 1));
+  std::uniform_int_distribution<uint32_t> geometries(0, uint32_t(m_sceneGeometries.size() - 1));
+  std::uniform_real_distribution<float>   steps(-0.25f, 0.25f);
+  for(int i = 0; i < count; i++)
+  {
+    uint32_t obj = objects(m_sceneEditRandom);
+    if(i & 1)
     {
-      nvgl::newBuffer(buffers.cull_bitsReadback[i]);
-      glNamedBufferStorage(buffers.cull_bitsReadback[i], snapdiv(m_sceneCmds.size(), 32) * sizeof(uint32_t), NULL,
-                           GL_MAP_PERSISTENT_BIT | GL_CLIENT_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_COHERENT_BIT);
+      updateObject(obj, geometries(m_sceneEditRandom));
     }
-
-    // for command list
-
-    if(m_bindlessVboUbo)
+    else
     {
-      glGetNamedBufferParameterui64vNV(buffers.scene_ubo, GL_BUFFER_GPU_ADDRESS_NV, &addresses.scene_ubo);
-      glMakeNamedBufferResidentNV(buffers.scene_ubo, GL_READ_ONLY);
-
-      glGetNamedBufferParameterui64vNV(buffers.scene_vbo, GL_BUFFER_GPU_ADDRESS_NV, &addresses.scene_vbo);
-      glMakeNamedBufferResidentNV(buffers.scene_vbo, GL_READ_ONLY);
-
-      glGetNamedBufferParameterui64vNV(buffers.scene_ibo, GL_BUFFER_GPU_ADDRESS_NV, &addresses.scene_ibo);
-      glMakeNamedBufferResidentNV(buffers.scene_ibo, GL_READ_ONLY);
-
-      glGetNamedBufferParameterui64vNV(buffers.scene_matrixindices, GL_BUFFER_GPU_ADDRESS_NV, &addresses.scene_matrixindices);
-      glMakeNamedBufferResidentNV(buffers.scene_matrixindices, GL_READ_ONLY);
+      // a step relative to the object's own size
+      vec3 step(steps(m_sceneEditRandom), steps(m_sceneEditRandom), steps(m_sceneEditRandom));
+      updateObjectMatrix(obj, m_sceneMatrices[size_t(obj) * 2] * glm::translate(glm::mat4(1.f), step));
     }
+  }
+}
 
-    std::vector<int>    tokenObjects;
-    std::vector<GLuint> tokenSizes;
-    std::vector<GLuint> tokenOffsets;
-    size_t              offset;
+bool Sample::verifySceneEdits()
+{
+  size_t mismatches = 0;
+  auto   compare    = [&](const char* what, GLuint buffer, size_t offset, size_t size, const void* expected) {
+    std::vector<uint8_t> data(size);
+    glGetNamedBufferSubData(buffer, offset, size, data.data());
+    if(memcmp(data.data(), expected, size) != 0)
     {
-      // default setup for the scene
-      NVTokenUbo ubo;
-      ubo.setBuffer(buffers.scene_ubo, addresses.scene_ubo, 0, sizeof(SceneData) + sizeof(GLuint64));
-      ubo.setBinding(UBO_SCENE, NVTOKEN_STAGE_VERTEX);
-
-      offset = nvtokenEnqueue(m_tokenStream, ubo);
-      tokenObjects.push_back(-1);
-      tokenSizes.push_back(num32bit(sizeof(ubo)));
-      tokenOffsets.push_back(num32bit(offset));
-
-      ubo.setBinding(UBO_SCENE, NVTOKEN_STAGE_FRAGMENT);
-
-      offset = nvtokenEnqueue(m_tokenStream, ubo);
-      tokenObjects.push_back(-1);
-      tokenSizes.push_back(num32bit(sizeof(ubo)));
-      tokenOffsets.push_back(num32bit(offset));
-
-      NVTokenVbo vbo;
-      vbo.setBinding(0);
-      vbo.setBuffer(buffers.scene_vbo, addresses.scene_vbo, 0);
-
-      offset = nvtokenEnqueue(m_tokenStream, vbo);
-      tokenObjects.push_back(-1);
-      tokenSizes.push_back(num32bit(sizeof(vbo)));
-      tokenOffsets.push_back(num32bit(offset));
-
-      vbo.setBinding(1);
-      vbo.setBuffer(buffers.scene_matrixindices, addresses.scene_matrixindices, 0);
+      LOGE("scene edits: %s differs\n", what);
+      mismatches++;
+    }
+  };
 
-      offset = nvtokenEnqueue(m_tokenStream, vbo);
-      tokenObjects.push_back(-1);
-      tokenSizes.push_back(num32bit(sizeof(vbo)));
-      tokenOffsets.push_back(num32bit(offset));
+  for(const Chunk& chunk : m_chunks)
+  {
+    const ChunkBuffers& cbuf = chunk.buffers;
 
-      NVTokenIbo ibo;
-      ibo.setBuffer(buffers.scene_ibo, addresses.scene_ibo);
-      ibo.setType(GL_UNSIGNED_INT);
+    compare("scene_indirect", cbuf.scene_indirect, 0, sizeof(DrawCmd) * chunk.count, &m_sceneCmds[chunk.first]);
+    compare("scene_token", cbuf.scene_token, 0, chunk.tokenSize, &m_tokenStream[chunk.tokenOffset]);
 
-      offset = nvtokenEnqueue(m_tokenStream, ibo);
-      tokenObjects.push_back(-1);
-      tokenSizes.push_back(num32bit(sizeof(ibo)));
-      tokenOffsets.push_back(num32bit(offset));
-    }
+    std::vector<uint8_t> expected(getObjectBboxSize() * chunk.count);
+    fillObjectBboxes(chunk, 0, chunk.count, expected.data());
+    compare(m_dualIndex ? "scene_bboxIndices" : "scene_bboxes", chunk.buffers.*getObjectBboxBuffer(), 0, expected.size(),
+            expected.data());
 
-    for(size_t i = 0; i < m_sceneCmds.size(); i++)
+    if(m_tweak.gpuTransform && cbuf.scene_transforms)
     {
-      const DrawCmd& cmd = m_sceneCmds[i];
-
-      // for commandlist token technique
-      NVTokenDrawElemsInstanced drawtoken;
-      drawtoken.cmd.baseInstance  = cmd.baseInstance;
-      drawtoken.cmd.baseVertex    = cmd.baseVertex;
-      drawtoken.cmd.firstIndex    = cmd.firstIndex;
-      drawtoken.cmd.instanceCount = cmd.instanceCount;
-      drawtoken.cmd.count         = cmd.count;
-      drawtoken.cmd.mode          = GL_TRIANGLES;
-      offset                      = nvtokenEnqueue(m_tokenStream, drawtoken);
-
-      // In this simple case we have one token per "object",
-      // but typically one would have multiple tokens (vbo,ibo...) per object
-      // as well, hence the token culling code presented, accounts for the
-      // more generic use-case.
-      tokenObjects.push_back(int(i));
-      tokenSizes.push_back(num32bit(sizeof(drawtoken)));
-      tokenOffsets.push_back(num32bit(offset));
+      // children keep the local matrix of their last upload when
+      // their parents move, so only roots are compared
+      std::vector<TransformObject> transforms(chunk.count);
+      std::vector<TransformObject> uploaded(chunk.count);
+      fillTransforms(chunk, 0, chunk.count, transforms.data());
+      glGetNamedBufferSubData(cbuf.scene_transforms, 0, sizeof(TransformObject) * chunk.count, uploaded.data());
+      for(size_t i = 0; i < chunk.count; i++)
+      {
+        if(transforms[i].parent < 0 && memcmp(&transforms[i], &uploaded[i], sizeof(TransformObject)) != 0)
+        {
+          LOGE("scene edits: scene_transforms differs\n");
+          mismatches++;
+          break;
+        }
+      }
     }
-    m_numTokens = GLuint(tokenSizes.size());
-    // pad to multiple of 4
-    while(tokenSizes.size() % 4)
+    else if(!m_tweak.gpuTransform)
     {
-      tokenObjects.push_back(-1);
-      tokenSizes.push_back(0);
-      tokenOffsets.push_back(0);
+      std::vector<MatrixData> matrices(chunk.count);
+      animateMatrices(chunk.first, chunk.count, matrices.data());
+      compare("scene_matrices", cbuf.scene_matrices, 0, sizeof(MatrixData) * chunk.count, matrices.data());
     }
+  }
 
-    m_tokenStreamCulled = m_tokenStream;
-
-    nvgl::newBuffer(buffers.scene_token);
-    glNamedBufferData(buffers.scene_token, m_tokenStream.size(), m_tokenStream.data(), GL_STATIC_DRAW);
-
-    // for command list culling
+  return mismatches == 0;
+}
 
-    nvgl::newBuffer(buffers.scene_tokenSizes);
-    glNamedBufferData(buffers.scene_tokenSizes, tokenSizes.size() * sizeof(GLuint), tokenSizes.data(), GL_STATIC_DRAW);
+void Sample::writeTokenReport(const char* filename)
+{
+  // every chunk is one sequence
+  std::vector<GLintptr> offsets;
+  std::vector<GLsizei>  sizes;
+  for(const Chunk& chunk : m_chunks)
+  {
+    offsets.push_back(GLintptr(chunk.tokenOffset));
+    sizes.push_back(GLsizei(chunk.tokenSize));
+  }
 
-    nvgl::newBuffer(buffers.scene_tokenOffsets);
-    glNamedBufferData(buffers.scene_tokenOffsets, tokenOffsets.size() * sizeof(GLuint), tokenOffsets.data(), GL_STATIC_DRAW);
+  NVTokenReport report;
+  nvtokenInspect(m_tokenStream.data(), m_tokenStream.size(), offsets.data(), sizes.data(), GLuint(m_chunks.size()), report);
 
-    nvgl::newBuffer(buffers.scene_tokenObjects);
-    glNamedBufferData(buffers.scene_tokenObjects, tokenObjects.size() * sizeof(GLint), tokenObjects.data(), GL_STATIC_DRAW);
+  std::string json;
+  if(m_tweak.culling && (m_tweak.drawmode == DRAW_TOKENBUFFER || m_tweak.drawmode == DRAW_TOKENBUFFER_EMULATION))
+  {
+    // the culled streams of this frame
+    std::string culledStream(m_tokenStream.size(), 0);
+    for(Chunk& chunk : m_chunks)
+    {
+      chunk.cullJobToken.tokenOut.GetNamedBufferSubData(&culledStream[chunk.tokenOffset]);
+    }
+
+    NVTokenReport culled;
+    nvtokenInspect(culledStream.data(), culledStream.size(), offsets.data(), sizes.data(), GLuint(m_chunks.size()), culled);
+    json = nvtokenReportToJSON(report, &culled);
+  }
+  else
+  {
+    json = nvtokenReportToJSON(report);
+  }
+
+  FILE* file = fopen(filename, "wt");
+  if(!file)
+  {
+    LOGW("token report: could not write %s\n", filename);
+    return;
+  }
+  fputs(json.c_str(), file);
+  fclose(file);
+
+  LOGI("token report: %s\n", filename);
+}
+
+void Sample::getCullPrograms(CullingSystem::Programs& cullprograms)
+{
+  cullprograms.bit_regular             = m_progManager.get(programs.bit_regular);
+  cullprograms.bit_temporallast        = m_progManager.get(programs.bit_temporallast);
+  cullprograms.bit_temporalnew         = m_progManager.get(programs.bit_temporalnew);
+  cullprograms.depth_mips              = m_progManager.get(programs.depth_mips);
+  cullprograms.object_frustum          = m_progManager.get(programs.object_frustum);
+  cullprograms.object_hiz              = m_progManager.get(programs.object_hiz);
+  cullprograms.object_raster_geo       = m_progManager.get(programs.object_raster_geo);
+  cullprograms.object_raster_instanced = m_progManager.get(programs.object_raster_instanced);
+  cullprograms.object_raster_query     = m_progManager.get(programs.object_raster_query);
+  if(has_GL_NV_mesh_shader)
+  {
+    cullprograms.object_raster_mesh = m_progManager.get(programs.object_raster_mesh);
+  }
+}
+
+static inline size_t snapdiv(size_t input, size_t align)
+{
+  return (input + align - 1) / align;
+}
+
+static inline GLuint num32bit(size_t input)
+{
+  return GLuint(input / sizeof(GLuint));
+}
+
+static const char* const s_benchmarkSections[] = {"Frame", "CullF", "Mip",  "CullH", "CullR", "CullQ", "Cull",
+                                                  "Wait",  "Depth", "Scene", "Last", "New",   "Draw"};
+
+static const char* const s_benchmarkMethods[]  = {"frustum", "hiz", "raster", "queries"};
+static const char* const s_benchmarkRasters[]  = {"instanced", "geometry", "mesh"};
+static const char* const s_benchmarkResults[]  = {"current", "lastframe", "temporal"};
+static const char* const s_benchmarkDraws[]    = {"standard", "mdi", "mdicount", "tokenemulation", "token"};
+
+void Sample::benchmarkInit()
+{
+  static_assert(sizeof(s_benchmarkSections) / sizeof(s_benchmarkSections[0]) == BENCHMARK_SECTIONS,
+                "benchmark sections mismatch");
+
+  std::vector<int> grids;
+  for(size_t pos = 0; pos < m_benchmark.grids.size();)
+  {
+    size_t next = m_benchmark.grids.find(',', pos);
+    if(next == std::string::npos)
+    {
+      next = m_benchmark.grids.size();
+    }
+    int grid = atoi(m_benchmark.grids.substr(pos, next - pos).c_str());
+    if(grid > 0)
+    {
+      grids.push_back(grid);
+    }
+    pos = next + 1;
+  }
+  if(grids.empty() && m_benchmark.sweep)
+  {
+    // 512 up to 16.7M objects
+    for(int grid = 8; grid <= 256; grid *= 2)
+    {
+      grids.push_back(grid);
+    }
+  }
+  if(grids.empty() || !m_sceneFile.empty())
+  {
+    // imported scenes do not depend on the grid
+    grids = {m_tweak.grid};
+  }
+
+  std::vector<DrawModes> drawmodes = {DRAW_STANDARD, DRAW_MULTIDRAWINDIRECT};
+  if(has_GL_ARB_indirect_parameters)
+  {
+    drawmodes.push_back(DRAW_MULTIDRAWINDIRECT_COUNT);
+  }
+  drawmodes.push_back(DRAW_TOKENBUFFER_EMULATION);
+  if(m_cmdlistNative)
+  {
+    drawmodes.push_back(DRAW_TOKENBUFFER);
+  }
+
+  std::vector<CullingSystem::RasterType> rasterTypes = {CullingSystem::RASTER_INSTANCED, CullingSystem::RASTER_GEOMETRY_SHADER};
+  if(has_GL_NV_mesh_shader)
+  {
+    rasterTypes.push_back(CullingSystem::RASTER_MESH_SHADER);
+  }
+
+  // all other settings, like animation or min.pixelsize, are kept
+  BenchmarkRun run = {};
+  run.tweak        = m_tweak;
+  run.tweak.freeze = false;
+
+  for(int grid : grids)
+  {
+    run.tweak.grid = grid;
+    for(DrawModes drawmode : drawmodes)
+    {
+      run.tweak.drawmode = drawmode;
+
+      // reference without culling
+      run.tweak.culling = false;
+      m_benchmark.runs.push_back(run);
+
+      run.tweak.culling = true;
+      for(int method = CullingSystem::METHOD_FRUSTUM; method <= CullingSystem::METHOD_QUERIES; method++)
+      {
+        run.tweak.method = CullingSystem::MethodType(method);
+        for(CullingSystem::RasterType rasterType : rasterTypes)
+        {
+          // only the raster method depends on the raster type
+          if(method != CullingSystem::METHOD_RASTER && rasterType != CullingSystem::RASTER_INSTANCED)
+          {
+            continue;
+          }
+          run.tweak.rasterType = rasterType;
+          for(int result = RESULT_REGULAR_CURRENT; result <= RESULT_TEMPORAL_CURRENT; result++)
+          {
+            run.tweak.result = ResultType(result);
+            m_benchmark.runs.push_back(run);
+          }
+        }
+      }
+    }
+  }
+
+  m_benchmark.current = 0;
+  m_benchmark.frame   = 0;
+  LOGI("benchmark: %d configurations\n", int(m_benchmark.runs.size()));
+}
+
+static Sample::BenchmarkStats benchmarkStats(std::vector<double> samples)
+{
+  Sample::BenchmarkStats stats = {};
+  if(samples.empty())
+  {
+    return stats;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  size_t count = samples.size();
+  double sum   = 0;
+  for(double sample : samples)
+  {
+    sum += sample;
+  }
+  double mean     = sum / double(count);
+  double variance = 0;
+  for(double sample : samples)
+  {
+    variance += (sample - mean) * (sample - mean);
+  }
+
+  // nearest rank
+  auto percentile = [&](double p) { return samples[std::min(count - 1, size_t(ceil(p * double(count))) - 1)]; };
+
+  stats.samples = uint32_t(count);
+  stats.mean    = mean;
+  stats.median  = count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) * 0.5;
+  stats.p95     = percentile(0.95);
+  stats.p99     = percentile(0.99);
+  stats.stddev  = count > 1 ? sqrt(variance / double(count - 1)) : 0.0;
+  return stats;
+}
+
+void Sample::benchmarkAdvance()
+{
+  if(m_benchmark.current >= m_benchmark.runs.size())
+  {
+    return;
+  }
+
+  BenchmarkRun& run = m_benchmark.runs[m_benchmark.current];
+  if(m_benchmark.frame == 0)
+  {
+    m_tweak = run.tweak;
+  }
+  else if(m_tweak.grid != run.tweak.grid)
+  {
+    // the scene could not be created, larger grids will not fit either
+    LOGW("benchmark: skipping grid %d and above\n", run.tweak.grid);
+    for(size_t r = m_benchmark.current; r < m_benchmark.runs.size(); r++)
+    {
+      m_benchmark.runs[r].skipped = m_benchmark.runs[r].tweak.grid >= run.tweak.grid;
+    }
+    benchmarkNext();
+    return;
+  }
+  else if(m_benchmark.frame == m_benchmark.warmup)
+  {
+    benchmarkStart();
+  }
+  else if(m_benchmark.frame > m_benchmark.warmup)
+  {
+    benchmarkSample();
+    if(benchmarkDone())
+    {
+      benchmarkRecord(run);
+      benchmarkNext();
+      return;
+    }
+  }
+
+  m_benchmark.frame++;
+}
+
+void Sample::benchmarkNext()
+{
+  do
+  {
+    m_benchmark.current++;
+  } while(m_benchmark.current < m_benchmark.runs.size() && m_benchmark.runs[m_benchmark.current].skipped);
+
+  if(m_benchmark.current == m_benchmark.runs.size())
+  {
+    benchmarkWrite(m_benchmark.filename.c_str());
+    if(!m_headless)
+    {
+      postQuit();
+    }
+    return;
+  }
+
+  m_tweak           = m_benchmark.runs[m_benchmark.current].tweak;
+  m_benchmark.frame = 1;
+}
+
+void Sample::benchmarkStart()
+{
+  m_profiler.reset();
+  for(int i = 0; i < BENCHMARK_SECTIONS; i++)
+  {
+    m_benchmark.gpuSamples[i].clear();
+    m_benchmark.cpuSamples[i].clear();
+    m_benchmark.gpuTotal[i]    = 0;
+    m_benchmark.cpuTotal[i]    = 0;
+    m_benchmark.numAveraged[i] = 0;
+  }
+  m_benchmark.startTime = NVPSystem::getTime();
+}
+
+void Sample::benchmarkSample()
+{
+  // keep well below the profiler's averaging window,
+  // so the totals stay exact sums of all frames since the reset
+  const uint32_t maxAveraged = 32;
+
+  bool wrap = false;
+  for(int i = 0; i < BENCHMARK_SECTIONS; i++)
+  {
+    nvh::Profiler::TimerInfo info;
+    if(!m_profiler.getTimerInfo(s_benchmarkSections[i], info))
+    {
+      continue;
+    }
+
+    double gpuTotal = info.gpu.average * double(info.numAveraged);
+    double cpuTotal = info.cpu.average * double(info.numAveraged);
+
+    // GPU results arrive with latency, frames that are not
+    // exactly one apart cannot be separated and are skipped
+    if(info.numAveraged == m_benchmark.numAveraged[i] + 1)
+    {
+      m_benchmark.gpuSamples[i].push_back(gpuTotal - m_benchmark.gpuTotal[i]);
+      m_benchmark.cpuSamples[i].push_back(cpuTotal - m_benchmark.cpuTotal[i]);
+    }
+    m_benchmark.gpuTotal[i]    = gpuTotal;
+    m_benchmark.cpuTotal[i]    = cpuTotal;
+    m_benchmark.numAveraged[i] = info.numAveraged;
+
+    wrap = wrap || info.numAveraged >= maxAveraged;
+  }
+
+  if(wrap)
+  {
+    m_profiler.reset();
+    for(int i = 0; i < BENCHMARK_SECTIONS; i++)
+    {
+      m_benchmark.gpuTotal[i]    = 0;
+      m_benchmark.cpuTotal[i]    = 0;
+      m_benchmark.numAveraged[i] = 0;
+    }
+  }
+}
+
+bool Sample::benchmarkDone()
+{
+  if(NVPSystem::getTime() - m_benchmark.startTime > m_benchmark.maxTime)
+  {
+    return true;
+  }
+
+  // the whole frame decides convergence
+  const std::vector<double>& samples = m_benchmark.gpuSamples[0];
+  if(samples.size() < std::max(m_benchmark.frames, 2u))
+  {
+    return false;
+  }
+
+  BenchmarkStats stats = benchmarkStats(samples);
+  return 1.96 * stats.stddev / sqrt(double(stats.samples)) <= m_benchmark.tolerance * stats.mean;
+}
+
+void Sample::benchmarkRecord(BenchmarkRun& run)
+{
+  run.objects = uint32_t(m_sceneCmds.size());
+  run.visible = run.objects;
+
+  if(m_benchmark.memory.empty() || m_benchmark.memory.back().grid != run.tweak.grid)
+  {
+    BenchmarkMemory memory;
+    memory.grid    = run.tweak.grid;
+    memory.objects = run.objects;
+    getMemoryUsage(memory);
+    m_benchmark.memory.push_back(memory);
+  }
+
+  if(run.tweak.culling)
+  {
+    run.visible = 0;
+    for(const Chunk& chunk : m_chunks)
+    {
+      std::vector<uint32_t> bits(snapdiv(chunk.count, 32));
+      glGetNamedBufferSubData(chunk.buffers.cull_bits, 0, sizeof(uint32_t) * bits.size(), bits.data());
+
+      for(GLuint i = 0; i < chunk.count; i++)
+      {
+        run.visible += (bits[i / 32] >> (i % 32)) & 1;
+      }
+    }
+  }
+
+  for(int i = 0; i < BENCHMARK_SECTIONS; i++)
+  {
+    run.gpu[i] = benchmarkStats(m_benchmark.gpuSamples[i]);
+    run.cpu[i] = benchmarkStats(m_benchmark.cpuSamples[i]);
+  }
+
+  const std::vector<double>& frameSamples = m_benchmark.gpuSamples[0];
+  const BenchmarkStats&      frameStats   = run.gpu[0];
+
+  run.frames     = frameStats.samples;
+  run.time       = NVPSystem::getTime() - m_benchmark.startTime;
+  run.confidence = frameStats.samples ? 1.96 * frameStats.stddev / sqrt(double(frameStats.samples)) : 0.0;
+  run.converged  = frameStats.samples >= 2 && run.confidence <= m_benchmark.tolerance * frameStats.mean;
+
+  // outliers are beyond 3 sigma, estimated robustly from the median absolute deviation
+  std::vector<double> deviations;
+  for(double sample : frameSamples)
+  {
+    deviations.push_back(fabs(sample - frameStats.median));
+  }
+  double mad   = benchmarkStats(deviations).median * 1.4826;
+  run.outliers = 0;
+  for(double deviation : deviations)
+  {
+    run.outliers += deviation > 3.0 * mad && mad > 0 ? 1 : 0;
+  }
+
+  // throttling shows as the last quarter of the run being slower than the first
+  size_t quarter = frameSamples.size() / 4;
+  run.throttled  = false;
+  if(quarter >= 4)
+  {
+    double first = 0;
+    double last  = 0;
+    for(size_t i = 0; i < quarter; i++)
+    {
+      first += frameSamples[i];
+      last += frameSamples[frameSamples.size() - quarter + i];
+    }
+    run.throttled = last > first * 1.05;
+  }
+
+  if(!run.converged || run.throttled || run.outliers > frameStats.samples / 100)
+  {
+    LOGW("benchmark: run %d %s%s%s\n", int(m_benchmark.current), run.converged ? "" : "did not converge ",
+         run.throttled ? "throttled " : "", run.outliers > frameStats.samples / 100 ? "has outliers" : "");
+  }
+}
+
+void Sample::getMemoryUsage(BenchmarkMemory& memory)
+{
+  auto bufferSize = [](GLuint buffer) {
+    GLint64 size = 0;
+    if(buffer)
+    {
+      glGetNamedBufferParameteri64v(buffer, GL_BUFFER_SIZE, &size);
+    }
+    return size_t(size);
+  };
+
+  // per-chunk buffers are reported as the sum over all chunks
+  auto addChunkBuffer = [&](const char* name, GLuint ChunkBuffers::*buffer) {
+    size_t total = 0;
+    for(const Chunk& chunk : m_chunks)
+    {
+      total += bufferSize(chunk.buffers.*buffer);
+    }
+    memory.buffers.push_back({name, total});
+  };
+  auto addChunkBuffers = [&](const char* name, GLuint(ChunkBuffers::*buffer)[CYCLIC_FRAMES]) {
+    size_t total = 0;
+    for(const Chunk& chunk : m_chunks)
+    {
+      for(int i = 0; i < CYCLIC_FRAMES; i++)
+      {
+        total += bufferSize((chunk.buffers.*buffer)[i]);
+      }
+    }
+    memory.buffers.push_back({name, total});
+  };
+
+  memory.buffers.push_back({"scene_vbo", bufferSize(buffers.scene_vbo)});
+  memory.buffers.push_back({"scene_ibo", bufferSize(buffers.scene_ibo)});
+  memory.buffers.push_back({"scene_bboxTable", bufferSize(buffers.scene_bboxTable)});
+  memory.buffers.push_back({"upload_ring", m_uploadRing.getSize()});
+  addChunkBuffer("scene_ubo", &ChunkBuffers::scene_ubo);
+  addChunkBuffer("scene_matrices", &ChunkBuffers::scene_matrices);
+  addChunkBuffer("scene_bboxes", &ChunkBuffers::scene_bboxes);
+  addChunkBuffer("scene_bboxIndices", &ChunkBuffers::scene_bboxIndices);
+  addChunkBuffer("scene_matrixindices", &ChunkBuffers::scene_matrixindices);
+  addChunkBuffer("scene_indirect", &ChunkBuffers::scene_indirect);
+  addChunkBuffer("scene_transforms", &ChunkBuffers::scene_transforms);
+  addChunkBuffer("scene_transformOrder", &ChunkBuffers::scene_transformOrder);
+  addChunkBuffer("scene_token", &ChunkBuffers::scene_token);
+  addChunkBuffer("scene_tokenSizes", &ChunkBuffers::scene_tokenSizes);
+  addChunkBuffer("scene_tokenOffsets", &ChunkBuffers::scene_tokenOffsets);
+  addChunkBuffer("scene_tokenObjects", &ChunkBuffers::scene_tokenObjects);
+  addChunkBuffer("scene_tokenSequence", &ChunkBuffers::scene_tokenSequence);
+  addChunkBuffer("scene_sequences", &ChunkBuffers::scene_sequences);
+  addChunkBuffer("cull_output", &ChunkBuffers::cull_output);
+  addChunkBuffer("cull_bits", &ChunkBuffers::cull_bits);
+  addChunkBuffer("cull_bitsLast", &ChunkBuffers::cull_bitsLast);
+  addChunkBuffers("cull_bitsReadback", &ChunkBuffers::cull_bitsReadback);
+  addChunkBuffer("cull_indirect", &ChunkBuffers::cull_indirect);
+  addChunkBuffer("cull_counter", &ChunkBuffers::cull_counter);
+  addChunkBuffer("cull_token", &ChunkBuffers::cull_token);
+  addChunkBuffers("cull_tokenEmulation", &ChunkBuffers::cull_tokenEmulation);
+  addChunkBuffer("cull_tokenSizes", &ChunkBuffers::cull_tokenSizes);
+  addChunkBuffer("cull_tokenScan", &ChunkBuffers::cull_tokenScan);
+  addChunkBuffer("cull_tokenScanOffsets", &ChunkBuffers::cull_tokenScanOffsets);
+  addChunkBuffer("cull_tokenVisible", &ChunkBuffers::cull_tokenVisible);
+  addChunkBuffer("cull_tokenVisibleReadback", &ChunkBuffers::cull_tokenVisibleReadback);
+  addChunkBuffer("cull_tokenUsed", &ChunkBuffers::cull_tokenUsed);
+  addChunkBuffer("cull_tokenUsedReadback", &ChunkBuffers::cull_tokenUsedReadback);
+
+  memory.host.push_back({"sceneCmds", sizeof(DrawCmd) * m_sceneCmds.size()});
+  memory.host.push_back({"sceneMatrices", sizeof(mat4) * m_sceneMatrices.size()});
+  memory.host.push_back({"sceneParents", sizeof(int64_t) * m_sceneParents.size()});
+  memory.host.push_back({"sceneVisBits", sizeof(uint32_t) * m_sceneVisBits.size()});
+  memory.host.push_back({"tokenStream", m_tokenStream.size()});
+  memory.host.push_back({"tokenStreamCulled", m_tokenStreamCulled.capacity()});
+}
+
+void Sample::benchmarkWriteMemory(FILE* file, bool csv)
+{
+  if(csv)
+  {
+    fprintf(file, "grid,objects,kind,name,bytes\n");
+  }
+  else
+  {
+    fprintf(file, ",\n  \"memory\": [");
+  }
+
+  for(size_t m = 0; m < m_benchmark.memory.size(); m++)
+  {
+    const BenchmarkMemory& memory = m_benchmark.memory[m];
+    if(csv)
+    {
+      for(const auto& entry : memory.buffers)
+      {
+        fprintf(file, "%d,%u,gpu,%s,%zu\n", memory.grid, memory.objects, entry.first, entry.second);
+      }
+      for(const auto& entry : memory.host)
+      {
+        fprintf(file, "%d,%u,host,%s,%zu\n", memory.grid, memory.objects, entry.first, entry.second);
+      }
+    }
+    else
+    {
+      size_t gpuTotal  = 0;
+      size_t hostTotal = 0;
+      fprintf(file, "%s\n    {\"grid\": %d, \"objects\": %u, \"gpu\": {", m ? "," : "", memory.grid, memory.objects);
+      for(size_t i = 0; i < memory.buffers.size(); i++)
+      {
+        fprintf(file, "%s\"%s\": %zu", i ? ", " : "", memory.buffers[i].first, memory.buffers[i].second);
+        gpuTotal += memory.buffers[i].second;
+      }
+      fprintf(file, "}, \"host\": {");
+      for(size_t i = 0; i < memory.host.size(); i++)
+      {
+        fprintf(file, "%s\"%s\": %zu", i ? ", " : "", memory.host[i].first, memory.host[i].second);
+        hostTotal += memory.host[i].second;
+      }
+      fprintf(file, "}, \"gpuTotal\": %zu, \"hostTotal\": %zu}", gpuTotal, hostTotal);
+    }
+  }
+
+  if(!csv)
+  {
+    fprintf(file, "\n  ]");
+  }
+}
+
+static Sample::BenchmarkFit benchmarkFit(const std::vector<std::pair<double, double>>& points)
+{
+  // points are (objects, microseconds) sorted by objects
+  Sample::BenchmarkFit fit = {};
+  size_t               n   = points.size();
+  if(n < 2)
+  {
+    return fit;
+  }
+
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for(const auto& point : points)
+  {
+    sx += point.first;
+    sy += point.second;
+    sxx += point.first * point.first;
+    sxy += point.first * point.second;
+  }
+  double denom = double(n) * sxx - sx * sx;
+  double slope = denom != 0 ? (double(n) * sxy - sx * sy) / denom : 0.0;
+  double fixed = (sy - slope * sx) / double(n);
+
+  double mean = sy / double(n), ssTot = 0, ssRes = 0;
+  for(const auto& point : points)
+  {
+    double predicted = fixed + slope * point.first;
+    ssRes += (point.second - predicted) * (point.second - predicted);
+    ssTot += (point.second - mean) * (point.second - mean);
+  }
+
+  fit.fixed     = fixed;
+  fit.perObject = slope * 1000.0;
+  fit.r2        = ssTot > 0 ? 1.0 - ssRes / ssTot : 1.0;
+
+  // the first step sets the reference cost per added object
+  double reference = 0;
+  for(size_t i = 1; i < n; i++)
+  {
+    double marginal = (points[i].second - points[i - 1].second) / (points[i].first - points[i - 1].first);
+    if(i == 1)
+    {
+      reference = std::max(marginal, slope * 0.5);
+    }
+    else if(reference > 0 && marginal > reference * 2.0)
+    {
+      fit.knee = uint32_t(points[i - 1].first);
+      break;
+    }
+  }
+
+  return fit;
+}
+
+static bool benchmarkSameConfig(const Sample::Tweak& a, const Sample::Tweak& b)
+{
+  if(a.drawmode != b.drawmode || a.culling != b.culling)
+  {
+    return false;
+  }
+  return !a.culling || (a.method == b.method && a.rasterType == b.rasterType && a.result == b.result);
+}
+
+void Sample::benchmarkWriteFits(FILE* file, bool csv)
+{
+  // culling and drawing as sum of their profiler sections
+  const int cullSections[] = {1, 2, 3, 4, 5, 6};   // CullF Mip CullH CullR CullQ Cull
+  const int drawSections[] = {8, 9, 10, 11, 12};   // Depth Scene Last New Draw
+  const char* fitNames[]   = {"frame_gpu", "frame_cpu", "cull_gpu", "cull_cpu", "draw_gpu", "draw_cpu"};
+
+  if(csv)
+  {
+    fprintf(file, "drawmode,culling,method,rastertype,result,grids,timer,fixed_us,perobject_ns,r2,knee_objects\n");
+  }
+  else
+  {
+    fprintf(file, ",\n  \"fits\": [");
+  }
+
+  std::vector<bool> done(m_benchmark.runs.size(), false);
+  bool              first = true;
+  for(size_t r = 0; r < m_benchmark.runs.size(); r++)
+  {
+    if(done[r] || m_benchmark.runs[r].skipped)
+    {
+      continue;
+    }
+
+    const Tweak& tweak = m_benchmark.runs[r].tweak;
+
+    std::vector<std::pair<double, double>> points[6];
+    for(size_t o = r; o < m_benchmark.runs.size(); o++)
+    {
+      const BenchmarkRun& run = m_benchmark.runs[o];
+      if(run.skipped || !benchmarkSameConfig(tweak, run.tweak))
+      {
+        continue;
+      }
+      done[o] = true;
+
+      double times[6] = {run.gpu[0].median, run.cpu[0].median};
+      for(int i : cullSections)
+      {
+        times[2] += run.gpu[i].median;
+        times[3] += run.cpu[i].median;
+      }
+      for(int i : drawSections)
+      {
+        times[4] += run.gpu[i].median;
+        times[5] += run.cpu[i].median;
+      }
+      for(int t = 0; t < 6; t++)
+      {
+        points[t].push_back({double(run.objects), times[t]});
+      }
+    }
+
+    if(points[0].size() < 2)
+    {
+      continue;
+    }
+
+    const char* method = tweak.culling ? s_benchmarkMethods[tweak.method] : "none";
+    const char* raster = tweak.culling ? s_benchmarkRasters[tweak.rasterType] : "none";
+    const char* result = tweak.culling ? s_benchmarkResults[tweak.result] : "none";
+
+    if(!csv)
+    {
+      fprintf(file,
+              "%s\n    {\"drawmode\": \"%s\", \"culling\": %s, \"method\": \"%s\", \"rastertype\": \"%s\", "
+              "\"result\": \"%s\", \"grids\": %d",
+              first ? "" : ",", s_benchmarkDraws[tweak.drawmode], tweak.culling ? "true" : "false", method, raster,
+              result, int(points[0].size()));
+    }
+
+    for(int t = 0; t < 6; t++)
+    {
+      std::sort(points[t].begin(), points[t].end());
+      BenchmarkFit fit = benchmarkFit(points[t]);
+      if(csv)
+      {
+        fprintf(file, "%s,%d,%s,%s,%s,%d,%s,%.3f,%.6f,%.4f,%u\n", s_benchmarkDraws[tweak.drawmode], tweak.culling ? 1 : 0,
+                method, raster, result, int(points[t].size()), fitNames[t], fit.fixed, fit.perObject, fit.r2, fit.knee);
+      }
+      else
+      {
+        fprintf(file, ", \"%s\": {\"fixed_us\": %.3f, \"perobject_ns\": %.6f, \"r2\": %.4f, \"knee_objects\": %u}",
+                fitNames[t], fit.fixed, fit.perObject, fit.r2, fit.knee);
+      }
+    }
+
+    if(!csv)
+    {
+      fprintf(file, "}");
+    }
+    first = false;
+  }
+
+  if(!csv)
+  {
+    fprintf(file, "\n  ]");
+  }
+}
+
+static void benchmarkWriteStats(FILE* file, bool csv, const Sample::BenchmarkStats& stats)
+{
+  if(csv)
+  {
+    if(stats.samples)
+    {
+      fprintf(file, ",%.3f,%.3f,%.3f,%.3f,%.3f", stats.mean, stats.median, stats.p95, stats.p99, stats.stddev);
+    }
+    else
+    {
+      fprintf(file, ",,,,,");
+    }
+  }
+  else
+  {
+    fprintf(file, "{\"mean\": %.3f, \"median\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"stddev\": %.3f}", stats.mean,
+            stats.median, stats.p95, stats.p99, stats.stddev);
+  }
+}
+
+void Sample::benchmarkWrite(const char* filename)
+{
+  FILE* file = fopen(filename, "wt");
+  if(!file)
+  {
+    LOGW("benchmark: could not write %s\n", filename);
+    return;
+  }
+
+  size_t len = strlen(filename);
+  bool   csv = len > 4 && strcmp(filename + len - 4, ".csv") == 0;
+
+  if(csv)
+  {
+    fprintf(file, "grid,objects,drawmode,culling,method,rastertype,result,visible,frames,time,confidence,converged,"
+                  "throttled,outliers");
+    for(int i = 0; i < BENCHMARK_SECTIONS; i++)
+    {
+      for(const char* timer : {"gpu", "cpu"})
+      {
+        for(const char* stat : {"mean", "median", "p95", "p99", "stddev"})
+        {
+          fprintf(file, ",%s_%s_%s_us", s_benchmarkSections[i], timer, stat);
+        }
+      }
+    }
+    fprintf(file, "\n");
+  }
+  else
+  {
+    fprintf(file, "{\n  \"runs\": [\n");
+  }
+
+  bool firstRun = true;
+  for(size_t r = 0; r < m_benchmark.runs.size(); r++)
+  {
+    const BenchmarkRun& run   = m_benchmark.runs[r];
+    const Tweak&        tweak = run.tweak;
+    if(run.skipped)
+    {
+      continue;
+    }
+
+    if(csv)
+    {
+      fprintf(file, "%d,%u,%s,%d,%s,%s,%s,%u,%u,%.3f,%.3f,%d,%d,%u", tweak.grid, run.objects,
+              s_benchmarkDraws[tweak.drawmode], tweak.culling ? 1 : 0, s_benchmarkMethods[tweak.method],
+              s_benchmarkRasters[tweak.rasterType], s_benchmarkResults[tweak.result], run.visible, run.frames, run.time,
+              run.confidence, run.converged ? 1 : 0, run.throttled ? 1 : 0, run.outliers);
+      for(int i = 0; i < BENCHMARK_SECTIONS; i++)
+      {
+        benchmarkWriteStats(file, csv, run.gpu[i]);
+        benchmarkWriteStats(file, csv, run.cpu[i]);
+      }
+      fprintf(file, "\n");
+    }
+    else
+    {
+      fprintf(file,
+              "%s    {\"grid\": %d, \"objects\": %u, \"drawmode\": \"%s\", \"culling\": %s, \"method\": \"%s\", "
+              "\"rastertype\": \"%s\", \"result\": \"%s\", \"visible\": %u, \"frames\": %u, \"time\": %.3f, "
+              "\"confidence_us\": %.3f, \"converged\": %s, \"throttled\": %s, \"outliers\": %u, \"sections\": {",
+              firstRun ? "" : ",\n", tweak.grid, run.objects, s_benchmarkDraws[tweak.drawmode],
+              tweak.culling ? "true" : "false", s_benchmarkMethods[tweak.method], s_benchmarkRasters[tweak.rasterType],
+              s_benchmarkResults[tweak.result], run.visible, run.frames, run.time, run.confidence, run.converged ? "true" : "false",
+              run.throttled ? "true" : "false", run.outliers);
+      bool first = true;
+      for(int i = 0; i < BENCHMARK_SECTIONS; i++)
+      {
+        if(!run.gpu[i].samples)
+        {
+          continue;
+        }
+        fprintf(file, "%s\n      \"%s\": {\"samples\": %u, \"gpu_us\": ", first ? "" : ",", s_benchmarkSections[i],
+                run.gpu[i].samples);
+        benchmarkWriteStats(file, csv, run.gpu[i]);
+        fprintf(file, ", \"cpu_us\": ");
+        benchmarkWriteStats(file, csv, run.cpu[i]);
+        fprintf(file, "}");
+        first = false;
+      }
+      fprintf(file, "}}");
+    }
+    firstRun = false;
+  }
+
+  if(!csv)
+  {
+    fprintf(file, "\n  ]");
+    benchmarkWriteMemory(file, false);
+    benchmarkWriteFits(file, false);
+    fprintf(file, "\n}\n");
+  }
+  fclose(file);
+
+  if(csv)
+  {
+    // memory and fits go next to the results
+    std::string base = std::string(filename, len - 4);
+    if((file = fopen((base + "_memory.csv").c_str(), "wt")))
+    {
+      benchmarkWriteMemory(file, true);
+      fclose(file);
+    }
+    if((file = fopen((base + "_fits.csv").c_str(), "wt")))
+    {
+      benchmarkWriteFits(file, true);
+      fclose(file);
+    }
+  }
+
+  LOGI("benchmark: %s\n", filename);
+}
+
+bool Sample::loadSceneCache(nvh::FileReadMapping& mapping, int grid, const void* sections[], size_t sectionSizes[])
+{
+  if(!mapping.open(m_sceneCache.c_str()))
+  {
+    return false;
+  }
+
+  const SceneCacheHeader* header = (const SceneCacheHeader*)mapping.data();
+  if(mapping.size() < sizeof(SceneCacheHeader) || header->magic != SceneCacheHeader::MAGIC
+     || header->version != SceneCacheHeader::VERSION || header->grid != uint32_t(grid) || header->vertexSize != sizeof(Vertex)
+     || header->cmdSize != sizeof(DrawCmd) || header->tokenStateSize != TOKEN_STATE_SIZE
+     || header->chunkObjects != m_chunkObjects)
+  {
+    LOGW("scene cache: %s does not match, regenerating\n", m_sceneCache.c_str());
+    mapping.close();
+    return false;
+  }
+
+  for(int i = 0; i < SCENECACHE_SECTIONS; i++)
+  {
+    if(header->sectionOffsets[i] + header->sectionSizes[i] > mapping.size())
+    {
+      LOGW("scene cache: %s is truncated, regenerating\n", m_sceneCache.c_str());
+      mapping.close();
+      return false;
+    }
+    sections[i]     = (const uint8_t*)mapping.data() + header->sectionOffsets[i];
+    sectionSizes[i] = size_t(header->sectionSizes[i]);
+  }
+
+  // every chunk starts with the state tokens
+  size_t numCmds   = sectionSizes[SCENECACHE_CMDS] / sizeof(DrawCmd);
+  size_t numChunks = std::max(size_t(1), snapdiv(numCmds, m_chunkObjects));
+  size_t numTokens = TOKEN_STATE_COUNT * numChunks + numCmds;
+  if(sectionSizes[SCENECACHE_TOKENS] != TOKEN_STATE_SIZE * numChunks + sizeof(NVTokenDrawElemsInstanced) * numCmds
+     || sectionSizes[SCENECACHE_TOKENSIZES] != sizeof(GLuint) * numTokens
+     || sectionSizes[SCENECACHE_TOKENOFFSETS] != sizeof(GLuint) * numTokens
+     || sectionSizes[SCENECACHE_TOKENOBJECTS] != sizeof(GLint) * numTokens)
+  {
+    LOGW("scene cache: %s is inconsistent, regenerating\n", m_sceneCache.c_str());
+    mapping.close();
+    return false;
+  }
+
+  return true;
+}
+
+void Sample::saveSceneCache(int grid, const void* const sections[], const size_t sectionSizes[])
+{
+  FILE* file = fopen(m_sceneCache.c_str(), "wb");
+  if(!file)
+  {
+    LOGW("scene cache: could not write %s\n", m_sceneCache.c_str());
+    return;
+  }
+
+  SceneCacheHeader header = {};
+  header.magic            = SceneCacheHeader::MAGIC;
+  header.version          = SceneCacheHeader::VERSION;
+  header.grid             = uint32_t(grid);
+  header.vertexSize       = sizeof(Vertex);
+  header.cmdSize          = sizeof(DrawCmd);
+  header.tokenStateSize   = TOKEN_STATE_SIZE;
+  header.chunkObjects     = m_chunkObjects;
+
+  size_t offset = sizeof(SceneCacheHeader);
+  for(int i = 0; i < SCENECACHE_SECTIONS; i++)
+  {
+    offset                   = snapdiv(offset, SceneCacheHeader::ALIGNMENT) * SceneCacheHeader::ALIGNMENT;
+    header.sectionOffsets[i] = offset;
+    header.sectionSizes[i]   = sectionSizes[i];
+    offset += sectionSizes[i];
+  }
+
+  bool   success = fwrite(&header, sizeof(header), 1, file) == 1;
+  size_t written = sizeof(header);
+  for(int i = 0; i < SCENECACHE_SECTIONS && success; i++)
+  {
+    static const uint8_t padding[SceneCacheHeader::ALIGNMENT] = {};
+    size_t               pad                                  = size_t(header.sectionOffsets[i]) - written;
+    success = (!pad || fwrite(padding, pad, 1, file) == 1) && (!sectionSizes[i] || fwrite(sections[i], sectionSizes[i], 1, file) == 1);
+    written += pad + sectionSizes[i];
+  }
+  fclose(file);
+
+  if(!success)
+  {
+    LOGW("scene cache: could not write %s\n", m_sceneCache.c_str());
+    remove(m_sceneCache.c_str());
+  }
+}
+
+void Sample::generateScene(int grid, nvh::geometry::Mesh<Vertex>& sceneMesh, const AddObjectFunc& addObject)
+{
+  // we store all geometries in one big mesh, for sake of simplicity
+  // and to allow standard MultiDrawIndirect to be efficient
+
+  std::vector<Geometry> geometries;
+  for(int i = 0; i < 37; i++)
+  {
+    const int resmul = 2;
+    mat4      identity(1);
+
+    uint oldverts   = sceneMesh.getVerticesCount();
+    uint oldindices = sceneMesh.getTriangleIndicesCount();
+
+    switch(i % 2)
+    {
+      case 0:
+        nvh::geometry::Sphere<Vertex>::add(sceneMesh, identity, 16 * resmul, 8 * resmul);
+        break;
+      case 1:
+        nvh::geometry::Box<Vertex>::add(sceneMesh, identity, 8 * resmul, 8 * resmul, 8 * resmul);
+        break;
+    }
+
+    vec4 color(nvh::frand(), nvh::frand(), nvh::frand(), 1.0f);
+    for(uint v = oldverts; v < sceneMesh.getVerticesCount(); v++)
+    {
+      sceneMesh.m_vertices[v].color = color;
+    }
+
+    Geometry geom;
+    geom.firstIndex = oldindices;
+    geom.count      = sceneMesh.getTriangleIndicesCount() - oldindices;
+    // all have same bbox
+    geom.bbox.min = vec4(-1, -1, -1, 1);
+    geom.bbox.max = vec4(1, 1, 1, 1);
+
+    geometries.push_back(geom);
+  }
+
+  // Scene Objects
+  size_t numObjects = size_t(grid) * size_t(grid) * size_t(grid);
+  for(size_t obj = 0; obj < numObjects; obj++)
+  {
+
+    vec3 pos(float(obj % grid), float((obj / grid) % grid), float(obj / (size_t(grid) * grid)));
+
+    pos -= vec3(grid / 2, grid / 2, grid / 2);
+    pos += (vec3(nvh::frand(), nvh::frand(), nvh::frand()) * 2.0f) - vec3(1.0f);
+    pos /= float(grid);
+
+    float scale;
+    if(glm::length(pos) < 0.52f)
+    {
+      scale = globalscale * 0.35f;
+      pos *= globalscale * 0.5f;
+    }
+    else
+    {
+      scale = globalscale;
+      pos *= globalscale;
+    }
+
+    mat4 matrix = glm::translate(glm::mat4(1.f), pos) * glm::rotate(glm::mat4(1), nvh::frand() * glm::pi<float>(), glm::vec3(0, 1, 0))
+                  * glm::scale(glm::mat4(1.f), (vec3(scale) * (vec3(0.25f) + vec3(nvh::frand(), nvh::frand(), nvh::frand()) * 0.5f))
+                                                   / float(grid));
+
+    addObject(geometries[obj % geometries.size()], matrix, -1);
+  }
+}
+
+bool Sample::importScene(nvh::geometry::Mesh<Vertex>& sceneMesh, const AddObjectFunc& addObject)
+{
+  sceneimport::Scene scene;
+
+  const std::string& name = m_sceneFile;
+  bool isObj = name.size() > 4 && (name.compare(name.size() - 4, 4, ".obj") == 0 || name.compare(name.size() - 4, 4, ".OBJ") == 0);
+  bool loaded = isObj ? sceneimport::loadOBJ(name.c_str(), scene) : sceneimport::loadGLTF(name.c_str(), scene);
+  if(!loaded || (!m_sceneInstances.empty() && !sceneimport::loadInstancesCSV(m_sceneInstances.c_str(), scene)))
+  {
+    return false;
+  }
+  if(scene.instances.empty())
+  {
+    LOGE("scene import: %s has no instances\n", name.c_str());
+    return false;
+  }
+
+  for(const sceneimport::Vertex& vertex : scene.vertices)
+  {
+    sceneMesh.m_vertices.push_back(Vertex(vertex));
+  }
+  for(size_t i = 0; i + 2 < scene.indices.size(); i += 3)
+  {
+    sceneMesh.m_indicesTriangles.push_back(glm::uvec3(scene.indices[i], scene.indices[i + 1], scene.indices[i + 2]));
+  }
+
+  // unlike the grid, every mesh has its own bbox
+  std::vector<Geometry> geometries;
+  for(const sceneimport::Mesh& mesh : scene.meshes)
+  {
+    Geometry geom;
+    geom.firstIndex = mesh.firstIndex;
+    geom.count      = mesh.count;
+    geom.bbox.min   = vec4(mesh.bboxMin, 1.0f);
+    geom.bbox.max   = vec4(mesh.bboxMax, 1.0f);
+    geometries.push_back(geom);
+  }
+
+  // fit the scene into the volume of the grid, so camera and
+  // culling thresholds behave the same
+  vec3 boundsMin;
+  vec3 boundsMax;
+  sceneimport::getBounds(scene, boundsMin, boundsMax);
+  vec3  extent = boundsMax - boundsMin;
+  float size   = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+  mat4  fit    = glm::scale(glm::mat4(1.f), vec3(globalscale / size)) * glm::translate(glm::mat4(1.f), -(boundsMin + boundsMax) * 0.5f);
+
+  // every mesh of a model instance is one object, the meshes of
+  // child instances hang off the first object of the parent instance
+  std::vector<int64_t> instanceObjects;
+  int64_t              numObjects = 0;
+  for(const sceneimport::Instance& instance : scene.instances)
+  {
+    const sceneimport::Model& model  = scene.models[instance.model];
+    mat4                      matrix = fit * instance.matrix;
+    int64_t parent = instance.parent >= 0 && instance.parent < int(instanceObjects.size()) ? instanceObjects[instance.parent] : -1;
+
+    instanceObjects.push_back(numObjects);
+    for(uint32_t m = model.firstMesh; m < model.firstMesh + model.numMeshes; m++)
+    {
+      addObject(geometries[m], matrix, parent);
+      numObjects++;
+    }
+  }
+
+  return true;
+}
+
+bool Sample::initScene(int grid)
+{
+  // chunks must start at full words of the visibility bits, and their
+  // matrices need to stay below 2 GB
+  m_chunkObjects = std::min(std::max(uint32_t(32), m_chunkObjects & ~uint32_t(31)), uint32_t(1) << 23);
+
+  {  // Scene Geometry
+
+    // all static scene data, either mapped from the cache file
+    // or pointing to the generated data
+    const void* sections[SCENECACHE_SECTIONS]     = {};
+    size_t      sectionSizes[SCENECACHE_SECTIONS] = {};
+
+    nvh::FileReadMapping cacheMapping;
+    // the cache is keyed by the grid, imported scenes are always loaded from their files
+    bool useCache  = !m_sceneCache.empty() && m_sceneFile.empty();
+    bool fromCache = useCache && loadSceneCache(cacheMapping, grid, sections, sectionSizes);
+
+    nvh::geometry::Mesh<Vertex> sceneMesh;
+    std::vector<CullBbox>       bboxes;
+    std::vector<int>            matrixIndex;
+
+    if(fromCache)
+    {
+      const DrawCmd*   cmds     = (const DrawCmd*)sections[SCENECACHE_CMDS];
+      const glm::mat4* matrices = (const glm::mat4*)sections[SCENECACHE_MATRICES];
 
-    nvgl::newBuffer(buffers.cull_token);
-    glNamedBufferData(buffers.cull_token, m_tokenStream.size(), NULL, GL_DYNAMIC_COPY);
+      m_sceneCmds.assign(cmds, cmds + sectionSizes[SCENECACHE_CMDS] / sizeof(DrawCmd));
+      m_sceneMatrices.assign(matrices, matrices + sectionSizes[SCENECACHE_MATRICES] / sizeof(glm::mat4));
+      // only the grid is cached, which has no hierarchy
+      m_sceneParents.assign(m_sceneCmds.size(), -1);
+    }
+    else
+    {
+      // generated and imported scenes share the same layout
+      auto addObject = [&](const Geometry& geom, const glm::mat4& matrix, int64_t parent) {
+        m_sceneMatrices.push_back(matrix);
+        m_sceneMatrices.push_back(glm::transpose(glm::inverse(matrix)));
+        m_sceneParents.push_back(parent);
+        // matrices are indexed within the chunk
+        GLuint local = GLuint(m_sceneCmds.size() % m_chunkObjects);
+        matrixIndex.push_back(int(local));
+
+        bboxes.push_back(geom.bbox);
+
+        DrawCmd cmd;
+        cmd.count         = geom.count;
+        cmd.firstIndex    = geom.firstIndex;
+        cmd.baseVertex    = 0;
+        cmd.baseInstance  = local;
+        cmd.instanceCount = 1;
+
+        m_sceneCmds.push_back(cmd);
+      };
+
+      if(!m_sceneFile.empty())
+      {
+        if(!importScene(sceneMesh, addObject))
+        {
+          return false;
+        }
+      }
+      else
+      {
+        generateScene(grid, sceneMesh, addObject);
+      }
+
+      sections[SCENECACHE_VERTICES]          = sceneMesh.m_vertices.data();
+      sectionSizes[SCENECACHE_VERTICES]      = sceneMesh.getVerticesSize();
+      sections[SCENECACHE_INDICES]           = sceneMesh.m_indicesTriangles.data();
+      sectionSizes[SCENECACHE_INDICES]       = sceneMesh.getTriangleIndicesSize();
+      sections[SCENECACHE_MATRICES]          = m_sceneMatrices.data();
+      sectionSizes[SCENECACHE_MATRICES]      = sizeof(mat4) * m_sceneMatrices.size();
+      sections[SCENECACHE_BBOXES]            = bboxes.data();
+      sectionSizes[SCENECACHE_BBOXES]        = sizeof(CullBbox) * bboxes.size();
+      sections[SCENECACHE_MATRIXINDICES]     = matrixIndex.data();
+      sectionSizes[SCENECACHE_MATRIXINDICES] = sizeof(int) * matrixIndex.size();
+      sections[SCENECACHE_CMDS]              = m_sceneCmds.data();
+      sectionSizes[SCENECACHE_CMDS]          = sizeof(DrawCmd) * m_sceneCmds.size();
+    }
+
+    nvgl::newBuffer(buffers.scene_ibo);
+    glNamedBufferStorage(buffers.scene_ibo, sectionSizes[SCENECACHE_INDICES], sections[SCENECACHE_INDICES], 0);
+
+    nvgl::newBuffer(buffers.scene_vbo);
+    glNamedBufferStorage(buffers.scene_vbo, sectionSizes[SCENECACHE_VERTICES], sections[SCENECACHE_VERTICES], 0);
+
+
+    m_sceneVisBits.clear();
+    m_sceneVisBits.resize(snapdiv(m_sceneCmds.size(), 32), 0xFFFFFFFF);
+
+    if(m_bindlessVboUbo)
+    {
+      glGetNamedBufferParameterui64vNV(buffers.scene_vbo, GL_BUFFER_GPU_ADDRESS_NV, &addresses.scene_vbo);
+      glMakeNamedBufferResidentNV(buffers.scene_vbo, GL_READ_ONLY);
+
+      glGetNamedBufferParameterui64vNV(buffers.scene_ibo, GL_BUFFER_GPU_ADDRESS_NV, &addresses.scene_ibo);
+      glMakeNamedBufferResidentNV(buffers.scene_ibo, GL_READ_ONLY);
+    }
+
+    const size_t numObjects = m_sceneCmds.size();
+    const size_t numChunks  = std::max(size_t(1), snapdiv(numObjects, m_chunkObjects));
+
+    // distinct geometries (draw range and bbox) of the objects, edits
+    // pick from them, so every bbox an object can get is known up front
+    const CullBbox* objectBboxes = (const CullBbox*)sections[SCENECACHE_BBOXES];
+    m_sceneGeometries.clear();
+    m_sceneObjectGeometries.resize(numObjects);
+    {
+      auto geomLess = [](const Geometry& a, const Geometry& b) { return memcmp(&a, &b, sizeof(Geometry)) < 0; };
+      std::map<Geometry, uint32_t, decltype(geomLess)> geomLookup(geomLess);
+
+      uint32_t last = ~0u;
+      for(size_t i = 0; i < numObjects; i++)
+      {
+        Geometry geom;
+        geom.firstIndex = m_sceneCmds[i].firstIndex;
+        geom.count      = m_sceneCmds[i].count;
+        geom.bbox       = objectBboxes[i];
+
+        // consecutive objects often use the same geometry
+        if(last == ~0u || memcmp(&m_sceneGeometries[last], &geom, sizeof(Geometry)) != 0)
+        {
+          auto it = geomLookup.insert({geom, uint32_t(m_sceneGeometries.size())});
+          if(it.second)
+          {
+            m_sceneGeometries.push_back(geom);
+          }
+          last = it.first->second;
+        }
+        m_sceneObjectGeometries[i] = last;
+      }
+    }
+
+    // dual-index: every distinct bbox is stored once, objects of the
+    // same geometry share it through a 32-bit index
+    std::vector<CullBbox> bboxTable;
+    m_sceneGeometryBboxes.clear();
+    if(m_dualIndex)
+    {
+      auto bboxLess = [](const CullBbox& a, const CullBbox& b) { return memcmp(&a, &b, sizeof(CullBbox)) < 0; };
+      std::map<CullBbox, int, decltype(bboxLess)> bboxLookup(bboxLess);
+
+      for(const Geometry& geom : m_sceneGeometries)
+      {
+        auto it = bboxLookup.insert({geom.bbox, int(bboxTable.size())});
+        if(it.second)
+        {
+          bboxTable.push_back(geom.bbox);
+        }
+        m_sceneGeometryBboxes.push_back(it.first->second);
+      }
+      LOGI("dual index: %zu distinct bboxes for %zu objects\n", bboxTable.size(), numObjects);
+    }
+
+#if CULLSYS_BBOX_QUANTIZED
+    {
+      // one frame around all boxes objects can have
+      glm::vec4 frameMin(FLT_MAX);
+      glm::vec4 frameMax(-FLT_MAX);
+      for(const Geometry& geom : m_sceneGeometries)
+      {
+        frameMin = glm::min(frameMin, geom.bbox.min);
+        frameMax = glm::max(frameMax, geom.bbox.max);
+      }
+      if(m_sceneGeometries.empty())
+      {
+        frameMin = glm::vec4(0);
+        frameMax = glm::vec4(1);
+      }
+      // one step of headroom, so rounding up never leaves the 16 bits
+      m_bboxFrame[0] = glm::vec4(glm::vec3(frameMin), 0);
+      m_bboxFrame[1] = glm::vec4(glm::max(glm::vec3(frameMax - frameMin), glm::vec3(FLT_MIN)) / 65534.0f, 1);
+    }
+#endif
+
+    if(m_dualIndex)
+    {
+      uploadBboxes(buffers.scene_bboxTable, bboxTable.data(), bboxTable.size());
+    }
+    else
+    {
+      nvgl::deleteBuffer(buffers.scene_bboxTable);
+    }
+
+    for(size_t c = numChunks; c < m_chunks.size(); c++)
+    {
+      deinitChunk(m_chunks[c]);
+    }
+    m_chunks.resize(numChunks);
+
+    // the token tables of all chunks are concatenated, every chunk
+    // starts with its own state tokens
+    const size_t numDrawTokens = numObjects;
+    const size_t numTokens     = TOKEN_STATE_COUNT * numChunks + numDrawTokens;
+
+    std::vector<int>    tokenObjects;
+    std::vector<GLuint> tokenSizes;
+    std::vector<GLuint> tokenOffsets;
+    if(fromCache)
+    {
+      // the cache already contains the draw tokens and all token tables
+      m_tokenStream.assign((const char*)sections[SCENECACHE_TOKENS], sectionSizes[SCENECACHE_TOKENS]);
+    }
+    else
+    {
+      // size everything up front, so the draw tokens can be written in parallel
+      tokenObjects.resize(numTokens);
+      tokenSizes.resize(numTokens);
+      tokenOffsets.resize(numTokens);
+      m_tokenStream.clear();
+      m_tokenStream.resize(TOKEN_STATE_SIZE * numChunks + sizeof(NVTokenDrawElemsInstanced) * numDrawTokens);
+    }
+
+    for(size_t c = 0; c < numChunks; c++)
+    {
+      Chunk&        chunk = m_chunks[c];
+      ChunkBuffers& cbuf  = chunk.buffers;
+
+      chunk.first       = c * m_chunkObjects;
+      chunk.count       = GLuint(std::min(numObjects - chunk.first, size_t(m_chunkObjects)));
+      chunk.firstToken  = c * TOKEN_STATE_COUNT + chunk.first;
+      chunk.numTokens   = GLuint(TOKEN_STATE_COUNT + chunk.count);
+      chunk.tokenOffset = c * TOKEN_STATE_SIZE + chunk.first * sizeof(NVTokenDrawElemsInstanced);
+      chunk.tokenSize   = TOKEN_STATE_SIZE + chunk.count * sizeof(NVTokenDrawElemsInstanced);
+
+      // the part of a per-object section that belongs to this chunk
+      auto chunkData = [&](SceneCacheSection section, size_t elementSize) {
+        return (const uint8_t*)sections[section] + chunk.first * elementSize;
+      };
+
+      {  // Scene UBO
+        nvgl::newBuffer(cbuf.scene_ubo);
+        glNamedBufferData(cbuf.scene_ubo, sizeof(SceneData) + sizeof(GLuint64), NULL, GL_DYNAMIC_DRAW);
+      }
+
+      nvgl::newBuffer(cbuf.scene_indirect);
+      glNamedBufferStorage(cbuf.scene_indirect, sizeof(DrawCmd) * chunk.count, chunkData(SCENECACHE_CMDS, sizeof(DrawCmd)),
+                           GL_DYNAMIC_STORAGE_BIT);
+
+      nvgl::newBuffer(cbuf.scene_matrices);
+#if CULLSYS_MATRIX_COMPACT
+      {
+        std::vector<MatrixData> matrices(chunk.count);
+        animateMatrices(chunk.first, chunk.count, matrices.data());
+        glNamedBufferData(cbuf.scene_matrices, sizeof(MatrixData) * chunk.count, matrices.data(), GL_STATIC_DRAW);
+      }
+#else
+      glNamedBufferData(cbuf.scene_matrices, sizeof(mat4) * 2 * chunk.count, &m_sceneMatrices[chunk.first * 2], GL_STATIC_DRAW);
+#endif
+      nvgl::newTexture(chunk.texMatrices, GL_TEXTURE_BUFFER);
+      glTextureBuffer(chunk.texMatrices, GL_RGBA32F, cbuf.scene_matrices);
+
+      if(has_GL_ARB_bindless_texture)
+      {
+        GLuint64 handle = glGetTextureHandleARB(chunk.texMatrices);
+        glMakeTextureHandleResidentARB(handle);
+        glNamedBufferSubData(cbuf.scene_ubo, sizeof(SceneData), sizeof(GLuint64), &handle);
+      }
+
+      {
+        // the buffer of the other mode is not used
+        nvgl::deleteBuffer(m_dualIndex ? cbuf.scene_bboxes : cbuf.scene_bboxIndices);
+
+        std::vector<uint8_t> bboxData(getObjectBboxSize() * chunk.count);
+        fillObjectBboxes(chunk, 0, chunk.count, bboxData.data());
+
+        GLuint& bboxBuffer = cbuf.*getObjectBboxBuffer();
+        nvgl::newBuffer(bboxBuffer);
+        glNamedBufferStorage(bboxBuffer, bboxData.size(), bboxData.data(), GL_DYNAMIC_STORAGE_BIT);
+      }
+
+      nvgl::newBuffer(cbuf.scene_matrixindices);
+      glNamedBufferStorage(cbuf.scene_matrixindices, sizeof(int) * chunk.count, chunkData(SCENECACHE_MATRIXINDICES, sizeof(int)), 0);
+
+      // rebuilt by initTransforms once the GPU transform is used
+      nvgl::deleteBuffer(cbuf.scene_transforms);
+      nvgl::deleteBuffer(cbuf.scene_transformOrder);
+      chunk.transformLevels.clear();
+
+
+      nvgl::newBuffer(cbuf.cull_counter);
+      glNamedBufferData(cbuf.cull_counter, sizeof(int), NULL, GL_DYNAMIC_COPY);
+
+      nvgl::newBuffer(cbuf.cull_output);
+      glNamedBufferData(cbuf.cull_output, snapdiv(chunk.count, 32) * 32 * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+
+      nvgl::newBuffer(cbuf.cull_bits);
+      glNamedBufferData(cbuf.cull_bits, snapdiv(chunk.count, 32) * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+
+      nvgl::newBuffer(cbuf.cull_bitsLast);
+      glNamedBufferData(cbuf.cull_bitsLast, snapdiv(chunk.count, 32) * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+
+      for(int i = 0; i < CYCLIC_FRAMES; i++)
+      {
+        nvgl::newBuffer(cbuf.cull_bitsReadback[i]);
+        glNamedBufferStorage(cbuf.cull_bitsReadback[i], snapdiv(chunk.count, 32) * sizeof(uint32_t), NULL,
+                             GL_MAP_PERSISTENT_BIT | GL_CLIENT_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_COHERENT_BIT);
+      }
+
+      nvgl::newBuffer(cbuf.cull_indirect);
+      glNamedBufferData(cbuf.cull_indirect, sizeof(DrawCmd) * chunk.count, NULL, GL_DYNAMIC_COPY);
+
+      // for command list
+
+      if(m_bindlessVboUbo)
+      {
+        glGetNamedBufferParameterui64vNV(cbuf.scene_ubo, GL_BUFFER_GPU_ADDRESS_NV, &chunk.addressUbo);
+        glMakeNamedBufferResidentNV(cbuf.scene_ubo, GL_READ_ONLY);
+
+        glGetNamedBufferParameterui64vNV(cbuf.scene_matrixindices, GL_BUFFER_GPU_ADDRESS_NV, &chunk.addressMatrixIndices);
+        glMakeNamedBufferResidentNV(cbuf.scene_matrixindices, GL_READ_ONLY);
+      }
+
+      NVPointerStream tokenStream;
+      tokenStream.init(&m_tokenStream[chunk.tokenOffset], chunk.tokenSize);
+
+      // offsets are relative to the chunk's stream, objects to its first object
+      auto setToken = [&](size_t token, int object, size_t size, size_t offset) {
+        if(!fromCache)
+        {
+          tokenObjects[chunk.firstToken + token] = object;
+          tokenSizes[chunk.firstToken + token]   = num32bit(size);
+          tokenOffsets[chunk.firstToken + token] = num32bit(offset);
+        }
+      };
+
+      // the state tokens depend on the buffers of this run, so they are
+      // always rebuilt
+      size_t offset;
+      {
+        // default setup for the scene
+        NVTokenUbo ubo;
+        ubo.setBuffer(cbuf.scene_ubo, chunk.addressUbo, 0, sizeof(SceneData) + sizeof(GLuint64));
+        ubo.setBinding(UBO_SCENE, NVTOKEN_STAGE_VERTEX);
+
+        offset = nvtokenEnqueue(tokenStream, ubo);
+        setToken(0, -1, sizeof(ubo), offset);
+
+        ubo.setBinding(UBO_SCENE, NVTOKEN_STAGE_FRAGMENT);
+
+        offset = nvtokenEnqueue(tokenStream, ubo);
+        setToken(1, -1, sizeof(ubo), offset);
+
+        NVTokenVbo vbo;
+        vbo.setBinding(0);
+        vbo.setBuffer(buffers.scene_vbo, addresses.scene_vbo, 0);
+
+        offset = nvtokenEnqueue(tokenStream, vbo);
+        setToken(2, -1, sizeof(vbo), offset);
+
+        vbo.setBinding(1);
+        vbo.setBuffer(cbuf.scene_matrixindices, chunk.addressMatrixIndices, 0);
+
+        offset = nvtokenEnqueue(tokenStream, vbo);
+        setToken(3, -1, sizeof(vbo), offset);
+
+        NVTokenIbo ibo;
+        ibo.setBuffer(buffers.scene_ibo, addresses.scene_ibo);
+        ibo.setType(GL_UNSIGNED_INT);
+
+        offset = nvtokenEnqueue(tokenStream, ibo);
+        setToken(4, -1, sizeof(ibo), offset);
+      }
+      assert(tokenStream.size() == TOKEN_STATE_SIZE);
+
+      if(fromCache)
+      {
+        // headers differ between native and emulated command lists
+        NVTokenDrawElemsInstanced* drawtokens =
+            (NVTokenDrawElemsInstanced*)&m_tokenStream[chunk.tokenOffset + TOKEN_STATE_SIZE];
+        GLuint header = s_nvcmdlist_header[NVTokenDrawElemsInstanced::ID];
+        if(chunk.count && drawtokens[0].cmd.header != header)
+        {
+          for(size_t i = 0; i < chunk.count; i++)
+          {
+            drawtokens[i].cmd.header = header;
+          }
+        }
+      }
+      else
+      {
+        nvtokenEnqueueParallel<NVTokenDrawElemsInstanced>(
+            tokenStream, chunk.count, [&](size_t i, NVTokenDrawElemsInstanced& drawtoken, size_t offset) {
+              const DrawCmd& cmd = m_sceneCmds[chunk.first + i];
+
+              // for commandlist token technique
+              drawtoken.cmd.baseInstance  = cmd.baseInstance;
+              drawtoken.cmd.baseVertex    = cmd.baseVertex;
+              drawtoken.cmd.firstIndex    = cmd.firstIndex;
+              drawtoken.cmd.instanceCount = cmd.instanceCount;
+              drawtoken.cmd.count         = cmd.count;
+              drawtoken.cmd.mode          = GL_TRIANGLES;
+
+              // In this simple case we have one token per "object",
+              // but typically one would have multiple tokens (vbo,ibo...) per object
+              // as well, hence the token culling code presented, accounts for the
+              // more generic use-case.
+              setToken(TOKEN_STATE_COUNT + i, int(i), sizeof(drawtoken), offset);
+            });
+        assert(tokenStream.size() == chunk.tokenSize);
+      }
+    }
+
+    if(!fromCache)
+    {
+      sections[SCENECACHE_TOKENS]            = m_tokenStream.data();
+      sectionSizes[SCENECACHE_TOKENS]        = m_tokenStream.size();
+      sections[SCENECACHE_TOKENSIZES]        = tokenSizes.data();
+      sectionSizes[SCENECACHE_TOKENSIZES]    = sizeof(GLuint) * numTokens;
+      sections[SCENECACHE_TOKENOFFSETS]      = tokenOffsets.data();
+      sectionSizes[SCENECACHE_TOKENOFFSETS]  = sizeof(GLuint) * numTokens;
+      sections[SCENECACHE_TOKENOBJECTS]      = tokenObjects.data();
+      sectionSizes[SCENECACHE_TOKENOBJECTS]  = sizeof(GLint) * numTokens;
+    }
+
+    m_tokenStreamCulled = m_tokenStream;
+    nvtokenDecode(m_tokenStream.data(), m_tokenStream.size(), m_tokenStreamDecoded);
+
+    for(Chunk& chunk : m_chunks)
+    {
+      ChunkBuffers& cbuf = chunk.buffers;
+
+      // the part of a token table that belongs to this chunk
+      auto tokenData = [&](SceneCacheSection section) {
+        return (const uint8_t*)sections[section] + chunk.firstToken * sizeof(GLuint);
+      };
+
+      nvgl::newBuffer(cbuf.scene_token);
+      glNamedBufferStorage(cbuf.scene_token, chunk.tokenSize, &m_tokenStream[chunk.tokenOffset], GL_DYNAMIC_STORAGE_BIT);
+
+      // for command list culling
 
-    nvgl::newBuffer(buffers.cull_tokenEmulation);  // only for emulation
-    glNamedBufferData(buffers.cull_tokenEmulation, m_tokenStream.size(), NULL, GL_DYNAMIC_READ);
+      nvgl::newBuffer(cbuf.scene_tokenSizes);
+      glNamedBufferStorage(cbuf.scene_tokenSizes, sizeof(GLuint) * chunk.numTokens, tokenData(SCENECACHE_TOKENSIZES), 0);
 
-    nvgl::newBuffer(buffers.cull_tokenSizes);
-    glNamedBufferData(buffers.cull_tokenSizes, tokenSizes.size() * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+      nvgl::newBuffer(cbuf.scene_tokenOffsets);
+      glNamedBufferStorage(cbuf.scene_tokenOffsets, sizeof(GLuint) * chunk.numTokens, tokenData(SCENECACHE_TOKENOFFSETS), 0);
 
-    nvgl::newBuffer(buffers.cull_tokenScan);
-    glNamedBufferData(buffers.cull_tokenScan, tokenSizes.size() * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+      nvgl::newBuffer(cbuf.scene_tokenObjects);
+      glNamedBufferStorage(cbuf.scene_tokenObjects, sizeof(GLint) * chunk.numTokens, tokenData(SCENECACHE_TOKENOBJECTS), 0);
 
-    nvgl::newBuffer(buffers.cull_tokenScanOffsets);
-    glNamedBufferData(buffers.cull_tokenScanOffsets, ScanSystem::getOffsetSize(GLuint(tokenSizes.size())), NULL, GL_DYNAMIC_COPY);
+      nvgl::newBuffer(cbuf.cull_token);
+      glNamedBufferData(cbuf.cull_token, chunk.tokenSize, NULL, GL_DYNAMIC_COPY);
+
+      for(int i = 0; i < CYCLIC_FRAMES; i++)  // only for emulation
+      {
+        nvgl::newBuffer(cbuf.cull_tokenEmulation[i]);
+        glNamedBufferStorage(cbuf.cull_tokenEmulation[i], chunk.tokenSize, NULL,
+                             GL_MAP_PERSISTENT_BIT | GL_CLIENT_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_COHERENT_BIT);
+      }
+
+      nvgl::newBuffer(cbuf.cull_tokenSizes);
+      glNamedBufferData(cbuf.cull_tokenSizes, chunk.numTokens * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+
+      nvgl::newBuffer(cbuf.cull_tokenScan);
+      glNamedBufferData(cbuf.cull_tokenScan, chunk.numTokens * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+
+      nvgl::newBuffer(cbuf.cull_tokenScanOffsets);
+      glNamedBufferData(cbuf.cull_tokenScanOffsets, ScanSystem::getScratchSize(chunk.numTokens), NULL, GL_DYNAMIC_COPY);
+    }
+
+    if(fromCache)
+    {
+      LOGI("scene cache: loaded %s\n", m_sceneCache.c_str());
+    }
+    else if(useCache)
+    {
+      saveSceneCache(grid, sections, sectionSizes);
+    }
   }
 
   return true;
@@ -732,20 +2751,331 @@ bool Sample::initFramebuffers(int width, int height)
   return true;
 }
 
-void Sample::initCullingJob(CullingSystem::Job& cullJob)
+void Sample::initCullingJob(CullingSystem::Job& cullJob, Chunk& chunk)
 {
-  cullJob.m_numObjects = (int)m_sceneCmds.size();
+  ChunkBuffers& cbuf = chunk.buffers;
 
-  cullJob.m_bufferMatrices     = CullingSystem::Buffer(buffers.scene_matrices);
-  cullJob.m_bufferObjectMatrix = CullingSystem::Buffer(buffers.scene_matrixindices);
-  cullJob.m_bufferObjectBbox   = CullingSystem::Buffer(buffers.scene_bboxes);
+  cullJob.m_numObjects = int(chunk.count);
+
+  cullJob.m_bufferMatrices     = CullingSystem::Buffer(cbuf.scene_matrices);
+  cullJob.m_bufferObjectMatrix = CullingSystem::Buffer(cbuf.scene_matrixindices);
+  if(m_dualIndex)
+  {
+    cullJob.m_bufferBboxes     = CullingSystem::Buffer(buffers.scene_bboxTable);
+    cullJob.m_bufferObjectBbox = CullingSystem::Buffer(cbuf.scene_bboxIndices);
+  }
+  else
+  {
+    cullJob.m_bufferObjectBbox = CullingSystem::Buffer(cbuf.scene_bboxes);
+  }
+  memcpy(cullJob.m_bboxFrame, m_bboxFrame, sizeof(cullJob.m_bboxFrame));
 
   cullJob.m_textureDepthWithMipmaps = textures.scene_depthstencil;
 
-  cullJob.m_bufferVisOutput = CullingSystem::Buffer(buffers.cull_output);
+  cullJob.m_bufferVisOutput = CullingSystem::Buffer(cbuf.cull_output);
+
+  cullJob.m_bufferVisBitsCurrent = CullingSystem::Buffer(cbuf.cull_bits);
+  cullJob.m_bufferVisBitsLast    = CullingSystem::Buffer(cbuf.cull_bitsLast);
+}
+
+void Sample::initCullingJobs()
+{
+  m_cullFrameCycle = 0;
+
+  for(Chunk& chunk : m_chunks)
+  {
+    ChunkBuffers& cbuf     = chunk.buffers;
+    CullJobToken& jobToken = chunk.cullJobToken;
+
+    for(int i = 0; i < CYCLIC_FRAMES; i++)
+    {
+      chunk.cullReadbackBuffers[i]  = CullingSystem::Buffer(cbuf.cull_bitsReadback[i]);
+      chunk.cullReadbackMappings[i] = glMapNamedBufferRange(cbuf.cull_bitsReadback[i], 0, chunk.cullReadbackBuffers[i].size,
+                                                            GL_MAP_PERSISTENT_BIT | GL_MAP_READ_BIT | GL_MAP_COHERENT_BIT);
+    }
+
+    initCullingJob(chunk.cullJobReadback, chunk);
+    chunk.cullJobReadback.m_bufferVisBitsReadback = chunk.cullReadbackBuffers[0];
+    chunk.cullJobReadback.m_bufferVisBitsMapping  = chunk.cullReadbackMappings[0];
+    chunk.cullJobReadback.m_fence                 = NULL;
+
+
+    initCullingJob(chunk.cullJobIndirect, chunk);
+    chunk.cullJobIndirect.m_program_indirect_compact = m_progManager.get(programs.indirect_unordered);
+    chunk.cullJobIndirect.m_bufferObjectIndirects    = CullingSystem::Buffer(cbuf.scene_indirect);
+    chunk.cullJobIndirect.m_bufferIndirectCounter    = CullingSystem::Buffer(cbuf.cull_counter);
+    chunk.cullJobIndirect.m_bufferIndirectResult     = CullingSystem::Buffer(cbuf.cull_indirect);
+
+    initCullingJob(jobToken, chunk);
+    jobToken.program_cmds  = m_progManager.get(programs.token_cmds);
+    jobToken.program_sizes = m_progManager.get(programs.token_sizes);
+    jobToken.program_nops  = m_progManager.get(programs.token_nops);
+    jobToken.numTokens     = chunk.numTokens;
+    // one draw token per object
+    jobToken.numObjectTokens = chunk.count;
+
+    // if we had multiple stateobjects, we would be using multiple sequences
+    // where each sequence covers the token range per stateobject
+    CullJobToken::Sequence sequence;
+    sequence.first     = 0;
+    sequence.num       = chunk.numTokens;
+    sequence.offset    = 0;
+    sequence.endoffset = GLuint(chunk.tokenSize / sizeof(GLuint));
+    jobToken.sequences.clear();
+    jobToken.sequences.push_back(sequence);
+
+    // the scan restarts for every sequence, so all are culled in one go
+    std::vector<GLuint> tokenSequence(chunk.numTokens);
+    for(size_t s = 0; s < jobToken.sequences.size(); s++)
+    {
+      const CullJobToken::Sequence& seq = jobToken.sequences[s];
+      for(int i = 0; i < seq.num; i++)
+      {
+        tokenSequence[seq.first + i] = GLuint(s);
+      }
+    }
+
+    nvgl::newBuffer(cbuf.scene_tokenSequence);
+    glNamedBufferData(cbuf.scene_tokenSequence, tokenSequence.size() * sizeof(GLuint), tokenSequence.data(), GL_STATIC_DRAW);
+
+    nvgl::newBuffer(cbuf.scene_sequences);
+    glNamedBufferData(cbuf.scene_sequences, jobToken.sequences.size() * sizeof(CullJobToken::Sequence),
+                      jobToken.sequences.data(), GL_STATIC_DRAW);
+
+
+    jobToken.tokenOrig     = ScanSystem::Buffer(cbuf.scene_token);
+    jobToken.tokenObjects  = ScanSystem::Buffer(cbuf.scene_tokenObjects);
+    jobToken.tokenOffsets  = ScanSystem::Buffer(cbuf.scene_tokenOffsets);
+    jobToken.tokenSizes    = ScanSystem::Buffer(cbuf.scene_tokenSizes);
+    jobToken.tokenSequence = ScanSystem::Buffer(cbuf.scene_tokenSequence);
+    jobToken.sequenceInfos = ScanSystem::Buffer(cbuf.scene_sequences);
+
+    jobToken.tokenOut           = ScanSystem::Buffer(cbuf.cull_token);
+    jobToken.tokenOutSizes      = ScanSystem::Buffer(cbuf.cull_tokenSizes);
+    jobToken.tokenOutScan       = ScanSystem::Buffer(cbuf.cull_tokenScan);
+    jobToken.tokenOutScanOffset = ScanSystem::Buffer(cbuf.cull_tokenScanOffsets);
+
+    nvgl::newBuffer(cbuf.cull_tokenVisible);
+    glNamedBufferData(cbuf.cull_tokenVisible, sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    nvgl::newBuffer(cbuf.cull_tokenVisibleReadback);
+    glNamedBufferStorage(cbuf.cull_tokenVisibleReadback, sizeof(GLuint) * CYCLIC_FRAMES, NULL,
+                         GL_MAP_PERSISTENT_BIT | GL_CLIENT_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_COHERENT_BIT);
+
+    jobToken.visibleCounter  = ScanSystem::Buffer(cbuf.cull_tokenVisible);
+    jobToken.visibleReadback = cbuf.cull_tokenVisibleReadback;
+    jobToken.visibleMapping  = (const GLuint*)glMapNamedBufferRange(
+        cbuf.cull_tokenVisibleReadback, 0, sizeof(GLuint) * CYCLIC_FRAMES, GL_MAP_PERSISTENT_BIT | GL_MAP_READ_BIT | GL_MAP_COHERENT_BIT);
+
+    nvgl::newBuffer(cbuf.cull_tokenUsed);
+    glNamedBufferData(cbuf.cull_tokenUsed, sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    nvgl::newBuffer(cbuf.cull_tokenUsedReadback);
+    glNamedBufferStorage(cbuf.cull_tokenUsedReadback, sizeof(GLuint) * CYCLIC_FRAMES, NULL,
+                         GL_MAP_PERSISTENT_BIT | GL_CLIENT_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_COHERENT_BIT);
+
+    jobToken.tokenOutUsed        = ScanSystem::Buffer(cbuf.cull_tokenUsed);
+    jobToken.readbackUsed        = cbuf.cull_tokenUsedReadback;
+    jobToken.readbackUsedMapping = (const GLuint*)glMapNamedBufferRange(
+        cbuf.cull_tokenUsedReadback, 0, sizeof(GLuint) * CYCLIC_FRAMES, GL_MAP_PERSISTENT_BIT | GL_MAP_READ_BIT | GL_MAP_COHERENT_BIT);
+    for(int i = 0; i < CYCLIC_FRAMES; i++)
+    {
+      jobToken.readbackBuffers[i]  = cbuf.cull_tokenEmulation[i];
+      jobToken.readbackMappings[i] = (const GLubyte*)glMapNamedBufferRange(
+          cbuf.cull_tokenEmulation[i], 0, chunk.tokenSize, GL_MAP_PERSISTENT_BIT | GL_MAP_READ_BIT | GL_MAP_COHERENT_BIT);
+    }
+  }
+}
+
+int Sample::getTransformParent(const Chunk& chunk, size_t index) const
+{
+  // parents in another chunk are not visible to the dispatch, such
+  // objects become roots and keep their static world matrix
+  int64_t parent = m_sceneParents[chunk.first + index];
+  if(parent < int64_t(chunk.first) || parent >= int64_t(chunk.first + index))
+  {
+    return -1;
+  }
+  return int(parent - chunk.first);
+}
+
+void Sample::fillTransforms(const Chunk& chunk, size_t first, size_t count, TransformObject* dst)
+{
+  for(size_t i = 0; i < count; i++)
+  {
+    size_t obj    = chunk.first + first + i;
+    int    parent = getTransformParent(chunk, first + i);
+
+    // the inverse of the parent is the transpose of its inverse-transpose
+    mat4 local = m_sceneMatrices[obj * 2];
+    if(parent >= 0)
+    {
+      local = glm::transpose(m_sceneMatrices[(chunk.first + parent) * 2 + 1]) * local;
+    }
+
+    TransformObject& transform = dst[i];
+    transform.rows[0]          = glm::row(local, 0);
+    transform.rows[1]          = glm::row(local, 1);
+    transform.rows[2]          = glm::row(local, 2);
+    transform.parent           = parent;
+    // fixed per object, within [-1,1)
+    transform.spin  = float((uint32_t(obj) * 2654435761u) >> 8) / float(1 << 23) - 1.0f;
+    transform._pad0 = 0;
+    transform._pad1 = 0;
+  }
+}
+
+void Sample::initTransforms(Chunk& chunk)
+{
+  ChunkBuffers& cbuf = chunk.buffers;
+  if(cbuf.scene_transforms)
+  {
+    return;
+  }
+
+  // parents always precede their children
+  std::vector<GLuint> depths(chunk.count);
+  GLuint              maxDepth = 0;
+  for(size_t i = 0; i < chunk.count; i++)
+  {
+    int parent = getTransformParent(chunk, i);
+    depths[i]  = parent >= 0 ? depths[parent] + 1 : 0;
+    maxDepth   = std::max(maxDepth, depths[i]);
+  }
+
+  // counting sort by depth, one dispatch per level
+  chunk.transformLevels.assign(maxDepth + 2, 0);
+  for(size_t i = 0; i < chunk.count; i++)
+  {
+    chunk.transformLevels[depths[i] + 1]++;
+  }
+  for(size_t level = 1; level < chunk.transformLevels.size(); level++)
+  {
+    chunk.transformLevels[level] += chunk.transformLevels[level - 1];
+  }
+
+  std::vector<GLuint> order(chunk.count);
+  std::vector<GLuint> levelCursor(chunk.transformLevels.begin(), chunk.transformLevels.end() - 1);
+  for(size_t i = 0; i < chunk.count; i++)
+  {
+    order[levelCursor[depths[i]]++] = GLuint(i);
+  }
+
+  std::vector<TransformObject> transforms(chunk.count);
+  fillTransforms(chunk, 0, chunk.count, transforms.data());
+
+  nvgl::newBuffer(cbuf.scene_transforms);
+  glNamedBufferStorage(cbuf.scene_transforms, sizeof(TransformObject) * chunk.count, transforms.data(), GL_DYNAMIC_STORAGE_BIT);
+
+  nvgl::newBuffer(cbuf.scene_transformOrder);
+  glNamedBufferStorage(cbuf.scene_transformOrder, sizeof(GLuint) * chunk.count, order.data(), 0);
+}
+
+void Sample::transformScene(const glm::mat4& rotator, float spinAngle)
+{
+  NV_PROFILE_GL_SECTION("Anim");
+
+  glUseProgram(m_progManager.get(programs.transform));
+  glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(rotator));
+  glUniform1f(3, spinAngle);
+
+  for(Chunk& chunk : m_chunks)
+  {
+    ChunkBuffers& cbuf = chunk.buffers;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_SSBO_OBJECTS, cbuf.scene_transforms);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_SSBO_ORDER, cbuf.scene_transformOrder);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_SSBO_MATRICES, cbuf.scene_matrices);
+
+    for(size_t level = 0; level + 1 < chunk.transformLevels.size(); level++)
+    {
+      GLuint first = chunk.transformLevels[level];
+      GLuint count = chunk.transformLevels[level + 1] - first;
+      if(level)
+      {
+        // the parents were written by the previous level
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+      }
+      glUniform1ui(0, first);
+      glUniform1ui(1, count);
+      glDispatchCompute(GLuint(snapdiv(count, TRANSFORM_THREADS)), 1, 1);
+    }
+  }
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_SSBO_OBJECTS, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_SSBO_ORDER, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_SSBO_MATRICES, 0);
+  glUseProgram(0);
+
+  // culling reads the matrices as storage buffer, drawing as texture buffer
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void Sample::deinitChunk(Chunk& chunk)
+{
+  if(chunk.cullJobReadback.m_fence)
+  {
+    glDeleteSync(chunk.cullJobReadback.m_fence);
+  }
+  chunk.cullJobToken.resetResults();
+
+  m_cullSys.deinitJob(chunk.cullJobReadback);
+  m_cullSys.deinitJob(chunk.cullJobIndirect);
+  m_cullSys.deinitJob(chunk.cullJobToken);
+
+  ChunkBuffers& cbuf = chunk.buffers;
+  for(GLuint* buffer : {&cbuf.scene_ubo, &cbuf.scene_matrices, &cbuf.scene_bboxes, &cbuf.scene_bboxIndices,
+                        &cbuf.scene_matrixindices, &cbuf.scene_indirect, &cbuf.scene_transforms, &cbuf.scene_transformOrder,
+                        &cbuf.scene_token, &cbuf.scene_tokenSizes, &cbuf.scene_tokenOffsets,
+                        &cbuf.scene_tokenObjects, &cbuf.scene_tokenSequence, &cbuf.scene_sequences, &cbuf.cull_output,
+                        &cbuf.cull_bits, &cbuf.cull_bitsLast, &cbuf.cull_indirect, &cbuf.cull_counter, &cbuf.cull_token,
+                        &cbuf.cull_tokenSizes, &cbuf.cull_tokenScan, &cbuf.cull_tokenScanOffsets, &cbuf.cull_tokenVisible,
+                        &cbuf.cull_tokenVisibleReadback, &cbuf.cull_tokenUsed, &cbuf.cull_tokenUsedReadback})
+  {
+    nvgl::deleteBuffer(*buffer);
+  }
+  for(int i = 0; i < CYCLIC_FRAMES; i++)
+  {
+    nvgl::deleteBuffer(cbuf.cull_bitsReadback[i]);
+    nvgl::deleteBuffer(cbuf.cull_tokenEmulation[i]);
+  }
+
+  nvgl::deleteTexture(chunk.texMatrices);
+}
+
+bool Sample::rebuildScene(int grid)
+{
+  glFinish();
+
+  for(Chunk& chunk : m_chunks)
+  {
+    if(chunk.cullJobReadback.m_fence)
+    {
+      glDeleteSync(chunk.cullJobReadback.m_fence);
+      chunk.cullJobReadback.m_fence = NULL;
+    }
+    chunk.cullJobToken.resetResults();
+  }
+
+  m_sceneCmds.clear();
+  m_sceneMatrices.clear();
+  m_sceneParents.clear();
+  m_sceneEdits.cmds.clear();
+  m_sceneEdits.matrices.clear();
+  m_sceneEditRandom.seed(1);
+
+  while(glGetError() != GL_NO_ERROR)
+  {
+  }
+
+  // large grids may exceed the available memory
+  if(!initScene(grid) || glGetError() == GL_OUT_OF_MEMORY)
+  {
+    return false;
+  }
+  initCullingJobs();
+  systemChange();
 
-  cullJob.m_bufferVisBitsCurrent = CullingSystem::Buffer(buffers.cull_bits);
-  cullJob.m_bufferVisBitsLast    = CullingSystem::Buffer(buffers.cull_bitsLast);
+  m_uploadRing.setMaxFrameSize(sizeof(MatrixData) * m_sceneCmds.size() + UPLOAD_RING_SIZE);
+
+  return true;
 }
 
 bool Sample::begin()
@@ -781,64 +3111,37 @@ bool Sample::begin()
     ScanSystem::Programs scanprograms;
     getScanPrograms(scanprograms);
     s_scanSys.init(scanprograms);
+
+    if(m_scanTest)
+    {
+      bool passed = m_scanTest > 1 ? s_scanSys.test(m_scanTest) : s_scanSys.test();
+      LOGI("scan test: %s\n", passed ? "passed" : "FAILED");
+    }
+    if(m_scanBenchmark)
+    {
+      s_scanSys.benchmark(1024, m_scanBenchmark);
+    }
   }
 
   {
     CullingSystem::Programs cullprograms;
     getCullPrograms(cullprograms);
-    m_cullSys.init(cullprograms, false, m_tweak.rasterType, !!has_GL_NV_representative_fragment_test);
-
-    m_cullFrameCycle = 0;
-
-    for(int i = 0; i < CYCLIC_FRAMES; i++)
-    {
-      m_cullReadbackBuffers[i]  = CullingSystem::Buffer(buffers.cull_bitsReadback[i]);
-      m_cullReadbackMappings[i] = glMapNamedBufferRange(buffers.cull_bitsReadback[i], 0, m_cullReadbackBuffers[i].size,
-                                                        GL_MAP_PERSISTENT_BIT | GL_MAP_READ_BIT | GL_MAP_COHERENT_BIT);
-    }
-
-    initCullingJob(m_cullJobReadback);
-    m_cullJobReadback.m_bufferVisBitsReadback = m_cullReadbackBuffers[0];
-    m_cullJobReadback.m_bufferVisBitsMapping  = m_cullReadbackMappings[0];
-    m_cullJobReadback.m_fence                 = NULL;
-
-
-    initCullingJob(m_cullJobIndirect);
-    m_cullJobIndirect.m_program_indirect_compact = m_progManager.get(programs.indirect_unordered);
-    m_cullJobIndirect.m_bufferObjectIndirects    = CullingSystem::Buffer(buffers.scene_indirect);
-    m_cullJobIndirect.m_bufferIndirectCounter    = CullingSystem::Buffer(buffers.cull_counter);
-    m_cullJobIndirect.m_bufferIndirectResult     = CullingSystem::Buffer(buffers.cull_indirect);
-
-    initCullingJob(m_cullJobToken);
-    m_cullJobToken.program_cmds  = m_progManager.get(programs.token_cmds);
-    m_cullJobToken.program_sizes = m_progManager.get(programs.token_sizes);
-    m_cullJobToken.numTokens     = m_numTokens;
-
-    // if we had multiple stateobjects, we would be using multiple sequences
-    // where each sequence covers the token range per stateobject
-    CullJobToken::Sequence sequence;
-    sequence.first     = 0;
-    sequence.num       = m_numTokens;
-    sequence.offset    = 0;
-    sequence.endoffset = GLuint(m_tokenStream.size() / sizeof(GLuint));
-    m_cullJobToken.sequences.push_back(sequence);
+    m_cullSys.init(cullprograms, m_dualIndex, m_tweak.rasterType, !!has_GL_NV_representative_fragment_test);
 
-
-    m_cullJobToken.tokenOrig    = ScanSystem::Buffer(buffers.scene_token);
-    m_cullJobToken.tokenObjects = ScanSystem::Buffer(buffers.scene_tokenObjects);
-    m_cullJobToken.tokenOffsets = ScanSystem::Buffer(buffers.scene_tokenOffsets);
-    m_cullJobToken.tokenSizes   = ScanSystem::Buffer(buffers.scene_tokenSizes);
-
-    m_cullJobToken.tokenOut           = ScanSystem::Buffer(buffers.cull_token);
-    m_cullJobToken.tokenOutSizes      = ScanSystem::Buffer(buffers.cull_tokenSizes);
-    m_cullJobToken.tokenOutScan       = ScanSystem::Buffer(buffers.cull_tokenScan);
-    m_cullJobToken.tokenOutScanOffset = ScanSystem::Buffer(buffers.cull_tokenScanOffsets);
+    initCullingJobs();
   }
 
+  // grows to the peak demand of a frame, which includes all matrices
+  // when the host animates
+  m_uploadRing.init(UPLOAD_RING_SIZE);
+  m_uploadRing.setMaxFrameSize(sizeof(MatrixData) * m_sceneCmds.size() + UPLOAD_RING_SIZE);
+  m_cullSys.setUploadRing(&m_uploadRing);
+
   {
     m_ui.enumAdd(GUI_OCC_ALGORITHM, CullingSystem::METHOD_FRUSTUM, "frustum");
     m_ui.enumAdd(GUI_OCC_ALGORITHM, CullingSystem::METHOD_HIZ, "hiz");
     m_ui.enumAdd(GUI_OCC_ALGORITHM, CullingSystem::METHOD_RASTER, "raster");
+    m_ui.enumAdd(GUI_OCC_ALGORITHM, CullingSystem::METHOD_QUERIES, "occlusion queries");
 
     m_ui.enumAdd(GUI_RESULT, RESULT_REGULAR_CURRENT, "regular current frame");
     m_ui.enumAdd(GUI_RESULT, RESULT_REGULAR_LASTFRAME, "regular last frame");
@@ -872,6 +3175,11 @@ bool Sample::begin()
 
   m_statsTime = NVPSystem::getTime();
 
+  if(!m_benchmark.filename.empty())
+  {
+    benchmarkInit();
+  }
+
   return validated;
 }
 
@@ -896,14 +3204,194 @@ void Sample::processUI(double time)
     ImGui::SliderFloat("min.pixelsize", &m_tweak.minPixelSize, 0.0f, 16.0f);
     m_ui.enumCombobox(GUI_OCC_ALGORITHM, "algorithm", &m_tweak.method);
     m_ui.enumCombobox(GUI_RASTER_TYPE, "raster type", &m_tweak.rasterType);
+    if(m_tweak.method == CullingSystem::METHOD_QUERIES)
+    {
+      ImGui::SliderInt("query latency", &m_tweak.queryLatency, 0, CullingSystem::QUERY_FRAMES - 1);
+    }
     m_ui.enumCombobox(GUI_RESULT, "result", &m_tweak.result);
     m_ui.enumCombobox(GUI_DRAW, "drawmode", &m_tweak.drawmode);
     ImGui::SliderFloat("animate", &m_tweak.animate, 0.0f, 32.0f);
+    ImGui::Checkbox("gpu transform", &m_tweak.gpuTransform);
+    if(m_tweak.gpuTransform)
+    {
+      ImGui::SliderFloat("spin", &m_tweak.spin, 0.0f, 8.0f);
+    }
+    ImGui::SliderInt("scene edits", &m_tweak.sceneEdits, 0, 1024);
+    if(ImGui::Button("verify edits"))
+    {
+      m_sceneEditVerifyOnce = true;
+    }
   }
   ImGui::End();
 }
 
+void Sample::CullJobToken::updateVisibleRatio()
+{
+  // the slot about to be reused holds the oldest result
+  GLsync fence = visibleFences[visibleCycle];
+  if(!fence)
+  {
+    return;
+  }
+
+  GLenum status = glClientWaitSync(fence, 0, 0);
+  if(status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+  {
+    visibleRatio = numObjectTokens ? float(visibleMapping[visibleCycle]) / float(numObjectTokens) : 1.0f;
+  }
+}
+
 void Sample::CullJobToken::resultFromBits(const CullingSystem::Buffer& bufferVisBitsCurrent)
+{
+  updateVisibleRatio();
+
+  if(mode == MODE_AUTO)
+  {
+    // with most objects visible, replacing the few invisible tokens by NOPs
+    // is cheaper than scanning and compacting the entire stream
+    if(useNops && visibleRatio < NOP_RATIO_LEAVE)
+    {
+      useNops = false;
+    }
+    else if(!useNops && visibleRatio > NOP_RATIO_ENTER)
+    {
+      useNops = true;
+    }
+  }
+  else
+  {
+    useNops = mode == MODE_NOP;
+  }
+
+  glClearNamedBufferSubData(visibleCounter.buffer, GL_R32UI, visibleCounter.offset, sizeof(GLuint), GL_RED_INTEGER,
+                            GL_UNSIGNED_INT, NULL);
+
+  // compaction computes the used size, NOPs keep the original one
+  GLuint used = useNops ? GLuint(tokenOrig.size / sizeof(GLuint)) : 0;
+  glClearNamedBufferSubData(tokenOutUsed.buffer, GL_R32UI, tokenOutUsed.offset, sizeof(GLuint), GL_RED_INTEGER,
+                            GL_UNSIGNED_INT, &used);
+
+  if(readbackRing)
+  {
+    tokenOut.buffer = readbackBuffers[readbackCycle];
+  }
+
+  if(useNops)
+  {
+    resultFromBitsNop(bufferVisBitsCurrent);
+  }
+  else
+  {
+    resultFromBitsCompact(bufferVisBitsCurrent);
+  }
+
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glCopyNamedBufferSubData(visibleCounter.buffer, visibleReadback, visibleCounter.offset, sizeof(GLuint) * visibleCycle,
+                           sizeof(GLuint));
+  if(visibleFences[visibleCycle])
+  {
+    glDeleteSync(visibleFences[visibleCycle]);
+  }
+  visibleFences[visibleCycle] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  visibleCycle                = (visibleCycle + 1) % CYCLIC_FRAMES;
+
+  if(readbackRing)
+  {
+    // the token and NOP shaders write straight into the mapped buffer
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    glCopyNamedBufferSubData(tokenOutUsed.buffer, readbackUsed, tokenOutUsed.offset, sizeof(GLuint) * readbackCycle,
+                             sizeof(GLuint));
+    if(readbackFences[readbackCycle])
+    {
+      glDeleteSync(readbackFences[readbackCycle]);
+    }
+    readbackFences[readbackCycle] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readbackLast                  = readbackCycle;
+    readbackCycle                 = (readbackCycle + 1) % CYCLIC_FRAMES;
+  }
+}
+
+size_t Sample::CullJobToken::readbackResult(void* data)
+{
+  GLsync fence = readbackFences[readbackLast];
+  if(!fence)
+  {
+    return 0;
+  }
+
+  glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+
+  size_t size = readbackUsedMapping[readbackLast] * sizeof(GLuint);
+  memcpy(data, readbackMappings[readbackLast], size);
+  return size;
+}
+
+void Sample::CullJobToken::resetResults()
+{
+  for(int i = 0; i < CYCLIC_FRAMES; i++)
+  {
+    if(visibleFences[i])
+    {
+      glDeleteSync(visibleFences[i]);
+      visibleFences[i] = NULL;
+    }
+    if(readbackFences[i])
+    {
+      glDeleteSync(readbackFences[i]);
+      readbackFences[i] = NULL;
+    }
+  }
+  visibleCycle  = 0;
+  readbackCycle = 0;
+  readbackLast  = 0;
+  visibleRatio  = 1.0f;
+  useNops       = false;
+}
+
+void Sample::CullJobToken::resultFromBitsNop(const CullingSystem::Buffer& bufferVisBitsCurrent)
+{
+  // start from the original stream, then overwrite the tokens of
+  // invisible objects with NOPs, sizes and offsets stay unchanged
+  glCopyNamedBufferSubData(tokenOrig.buffer, tokenOut.buffer, tokenOrig.offset, tokenOut.offset, tokenOrig.size);
+
+  glUseProgram(program_nops);
+
+  glBindBuffer(GL_ARRAY_BUFFER, tokenOffsets.buffer);
+  glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, 0, (const void*)tokenOffsets.offset);
+  glBindBuffer(GL_ARRAY_BUFFER, tokenSizes.buffer);
+  glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 0, (const void*)tokenSizes.offset);
+  glBindBuffer(GL_ARRAY_BUFFER, tokenObjects.buffer);
+  glVertexAttribIPointer(2, 1, GL_INT, 0, (const void*)tokenObjects.offset);
+
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+
+  tokenOut.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 0);
+  bufferVisBitsCurrent.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 1);
+  visibleCounter.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 2);
+
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+  glUniform1ui(glGetUniformLocation(program_nops, "nopCmd"), nvtoken::s_nvcmdlist_header[GL_NOP_COMMAND_NV]);
+
+  glEnable(GL_RASTERIZER_DISCARD);
+  glDrawArrays(GL_POINTS, 0, numTokens);
+  glDisable(GL_RASTERIZER_DISCARD);
+
+  glDisableVertexAttribArray(0);
+  glDisableVertexAttribArray(1);
+  glDisableVertexAttribArray(2);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  for(GLuint i = 0; i < 3; i++)
+  {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+  }
+}
+
+void Sample::CullJobToken::resultFromBitsCompact(const CullingSystem::Buffer& bufferVisBitsCurrent)
 {
   // First we compute sizes based on culling result
   // it generates an output stream where size[token] is either 0 or original size
@@ -920,6 +3408,7 @@ void Sample::CullJobToken::resultFromBits(const CullingSystem::Buffer& bufferVis
 
   tokenOutSizes.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 0);
   bufferVisBitsCurrent.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 1);
+  visibleCounter.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 2);
 
   glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
 
@@ -932,7 +3421,7 @@ void Sample::CullJobToken::resultFromBits(const CullingSystem::Buffer& bufferVis
   // now let the scan system compute the running offsets for the visible tokens
   // that way we get a compact token stream with the original ordering back
 
-  s_scanSys.scanData(((numTokens + 3) / 4) * 4, tokenOutSizes, tokenOutScan, tokenOutScanOffset);
+  bool segmented = s_scanSys.scanDataSegmented(numTokens, tokenOutSizes, tokenSequence, tokenOutScan, tokenOutScanOffset);
 
   // finally we build the actual culled tokenbuffer, using those offsets
 
@@ -944,39 +3433,35 @@ void Sample::CullJobToken::resultFromBits(const CullingSystem::Buffer& bufferVis
   glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 0, (const void*)tokenOutSizes.offset);
   glBindBuffer(GL_ARRAY_BUFFER, tokenOutScan.buffer);
   glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, 0, (const void*)tokenOutScan.offset);
+  glBindBuffer(GL_ARRAY_BUFFER, tokenSequence.buffer);
+  glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, (const void*)tokenSequence.offset);
 
   glEnableVertexAttribArray(0);
   glEnableVertexAttribArray(1);
   glEnableVertexAttribArray(2);
+  glEnableVertexAttribArray(3);
 
   tokenOut.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 0);
   tokenOrig.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 1);
   tokenOutSizes.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 2);
   tokenOutScan.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 3);
-  tokenOutScanOffset.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 4);
+  sequenceInfos.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 4);
+  tokenOutUsed.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 5);
 
   glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
 
-  for(size_t i = 0; i < sequences.size(); i++)
-  {
-    const Sequence& sequence = sequences[i];
-
-    glUniform1ui(glGetUniformLocation(program_cmds, "startOffset"), sequence.offset);
-    glUniform1i(glGetUniformLocation(program_cmds, "startID"), sequence.first);
-    glUniform1ui(glGetUniformLocation(program_cmds, "endOffset"), sequence.endoffset);
-    glUniform1i(glGetUniformLocation(program_cmds, "endID"), sequence.first + sequence.num - 1);
-    glUniform1ui(glGetUniformLocation(program_cmds, "terminateCmd"), nvtoken::s_nvcmdlist_header[GL_TERMINATE_SEQUENCE_COMMAND_NV]);
-    glDrawArrays(GL_POINTS, sequence.first, sequence.num);
-  }
-
+  glUniform1ui(glGetUniformLocation(program_cmds, "terminateCmd"), nvtoken::s_nvcmdlist_header[GL_TERMINATE_SEQUENCE_COMMAND_NV]);
+  glUniform1i(glGetUniformLocation(program_cmds, "globalScan"), segmented ? 0 : 1);
+  glDrawArrays(GL_POINTS, 0, numTokens);
 
   glDisableVertexAttribArray(0);
   glDisableVertexAttribArray(1);
   glDisableVertexAttribArray(2);
+  glDisableVertexAttribArray(3);
 
   glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-  for(GLuint i = 0; i < 5; i++)
+  for(GLuint i = 0; i < 6; i++)
   {
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
   }
@@ -986,16 +3471,26 @@ void Sample::CullJobToken::resultFromBits(const CullingSystem::Buffer& bufferVis
 
 void Sample::systemChange()
 {
-  // clear last visibles to 0
-  glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.cull_bitsLast);
-  glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
   // current are all visible
   memset(m_sceneVisBits.data(), 0xFFFFFFFF, sizeof(uint32_t) * m_sceneVisBits.size());
-  // rest token buffer
-  glCopyNamedBufferSubData(buffers.scene_token, buffers.cull_token, 0, 0, m_tokenStream.size());
-  glCopyNamedBufferSubData(buffers.scene_token, buffers.cull_tokenEmulation, 0, 0, m_tokenStream.size());
-  // reset indirect buffer
-  glCopyNamedBufferSubData(buffers.scene_indirect, buffers.cull_indirect, 0, 0, m_sceneCmds.size() * sizeof(DrawCmd));
+
+  for(Chunk& chunk : m_chunks)
+  {
+    ChunkBuffers& cbuf = chunk.buffers;
+
+    // clear last visibles to 0
+    glBindBuffer(GL_COPY_WRITE_BUFFER, cbuf.cull_bitsLast);
+    glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    // rest token buffer
+    glCopyNamedBufferSubData(cbuf.scene_token, cbuf.cull_token, 0, 0, chunk.tokenSize);
+    for(int i = 0; i < CYCLIC_FRAMES; i++)
+    {
+      glCopyNamedBufferSubData(cbuf.scene_token, cbuf.cull_tokenEmulation[i], 0, 0, chunk.tokenSize);
+    }
+    // reset indirect buffer
+    glCopyNamedBufferSubData(cbuf.scene_indirect, cbuf.cull_indirect, 0, 0, chunk.count * sizeof(DrawCmd));
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 }
 
 void Sample::drawScene(bool depthonly, const char* what)
@@ -1027,41 +3522,54 @@ void Sample::drawScene(bool depthonly, const char* what)
 
   glUseProgram(m_progManager.get(programs.draw_scene));
 
-  // these bindings are replicated in the tokenbuffer as well
-  glBindBufferBase(GL_UNIFORM_BUFFER, UBO_SCENE, buffers.scene_ubo);
   glBindVertexBuffer(0, buffers.scene_vbo, 0, sizeof(Vertex));
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.scene_ibo);
-  glBindVertexBuffer(1, buffers.scene_matrixindices, 0, sizeof(GLint));
 
-
-  if(!has_GL_ARB_bindless_texture)
-  {
-    glActiveTexture(GL_TEXTURE0 + TEX_MATRICES);
-    glBindTexture(GL_TEXTURE_BUFFER, textures.scene_matrices);
-  }
+  // every chunk has its own matrices, the bindings of the ubo and
+  // matrix indices are replicated in the tokenbuffer as well
+  auto bindChunk = [&](const Chunk& chunk) {
+    glBindBufferBase(GL_UNIFORM_BUFFER, UBO_SCENE, chunk.buffers.scene_ubo);
+    glBindVertexBuffer(1, chunk.buffers.scene_matrixindices, 0, sizeof(GLint));
+    if(!has_GL_ARB_bindless_texture)
+    {
+      glActiveTexture(GL_TEXTURE0 + TEX_MATRICES);
+      glBindTexture(GL_TEXTURE_BUFFER, chunk.texMatrices);
+    }
+  };
 
   if(m_tweak.drawmode == DRAW_MULTIDRAWINDIRECT)
   {
-    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_tweak.culling ? buffers.cull_indirect : buffers.scene_indirect);
     if(m_tweak.culling)
     {
       glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
     }
-    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, (GLsizei)m_sceneCmds.size(), 0);
+    for(const Chunk& chunk : m_chunks)
+    {
+      bindChunk(chunk);
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_tweak.culling ? chunk.buffers.cull_indirect : chunk.buffers.scene_indirect);
+      glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, (GLsizei)chunk.count, 0);
+    }
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
   }
   else if(m_tweak.drawmode == DRAW_MULTIDRAWINDIRECT_COUNT)
   {
-    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_tweak.culling ? buffers.cull_indirect : buffers.scene_indirect);
     if(m_tweak.culling)
     {
-      glBindBuffer(GL_PARAMETER_BUFFER_ARB, buffers.cull_counter);
       glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
-      glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, 0, (GLsizei)m_sceneCmds.size(), 0);
     }
-    else
+    for(const Chunk& chunk : m_chunks)
     {
-      glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, (GLsizei)m_sceneCmds.size(), 0);
+      bindChunk(chunk);
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_tweak.culling ? chunk.buffers.cull_indirect : chunk.buffers.scene_indirect);
+      if(m_tweak.culling)
+      {
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, chunk.buffers.cull_counter);
+        glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, 0, (GLsizei)chunk.count, 0);
+      }
+      else
+      {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, (GLsizei)chunk.count, 0);
+      }
     }
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
     glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
@@ -1074,12 +3582,19 @@ void Sample::drawScene(bool depthonly, const char* what)
       glEnableClientState(GL_VERTEX_ATTRIB_ARRAY_UNIFIED_NV);
       glEnableClientState(GL_ELEMENT_ARRAY_UNIFIED_NV);
     }
+    // the culled stream is only used once every chunk has a result
+    bool useCulled = m_tweak.culling;
     if(m_tweak.culling)
     {
       if(m_tweak.drawmode == DRAW_TOKENBUFFER_EMULATION)
       {
         NV_PROFILE_GL_SECTION("Read");
-        m_cullJobToken.tokenOut.GetNamedBufferSubData(&m_tokenStreamCulled[0]);
+        for(Chunk& chunk : m_chunks)
+        {
+          // only the used part of the culled stream is copied
+          chunk.culledSize = chunk.cullJobToken.readbackResult(&m_tokenStreamCulled[chunk.tokenOffset]);
+          useCulled        = useCulled && chunk.culledSize;
+        }
       }
       else
       {
@@ -1089,21 +3604,46 @@ void Sample::drawScene(bool depthonly, const char* what)
       NV_PROFILE_GL_SPLIT();
     }
 
-    GLintptr offset = 0;
-    GLsizei  size   = GLsizei(m_tokenStream.size());
-    if(m_tweak.drawmode == DRAW_TOKENBUFFER_EMULATION)
-    {
-      StateSystem::State state;
-      state.vertexformat.bindings[0].stride = sizeof(Vertex);
-      state.vertexformat.bindings[1].stride = sizeof(GLint);
+    StateSystem::State state;
+    state.vertexformat.bindings[0].stride = sizeof(Vertex);
+    state.vertexformat.bindings[1].stride = sizeof(GLint);
 
-      const std::string& stream = m_tweak.culling ? m_tokenStreamCulled : m_tokenStream;
+    for(const Chunk& chunk : m_chunks)
+    {
+      // the matrix texture is not part of the stream
+      bindChunk(chunk);
 
-      nvtokenDrawCommandsSW(GL_TRIANGLES, stream.data(), stream.size(), &offset, &size, 1, state);
+      GLintptr offset = 0;
+      GLsizei  size   = GLsizei(chunk.tokenSize);
+      if(m_tweak.drawmode == DRAW_TOKENBUFFER_EMULATION)
+      {
+        offset = GLintptr(chunk.tokenOffset);
+        if(useCulled)
+        {
+          size = GLsizei(chunk.culledSize);
+          nvtokenDrawCommandsSW(GL_TRIANGLES, m_tokenStreamCulled.data(), m_tokenStreamCulled.size(), &offset, &size, 1, state);
+        }
+        else
+        {
+          // the original stream never changes, replay without decoding headers
+          nvtokenDrawCommandsSW(GL_TRIANGLES, m_tokenStream.data(), m_tokenStream.size(), m_tokenStreamDecoded, &offset,
+                                &size, 1, state);
+        }
+      }
+      else
+      {
+        glDrawCommandsNV(GL_TRIANGLES, m_tweak.culling ? chunk.buffers.cull_token : chunk.buffers.scene_token, &offset, &size, 1);
+      }
     }
-    else
+
+    if(m_tweak.drawmode == DRAW_TOKENBUFFER_EMULATION)
     {
-      glDrawCommandsNV(GL_TRIANGLES, m_tweak.culling ? buffers.cull_token : buffers.scene_token, &offset, &size, 1);
+      if(m_statsPrint)
+      {
+        LOGI("%s binds: %u issued, %u elided\n", what, s_nvcmdlist_statsSW.issued, s_nvcmdlist_statsSW.elided);
+      }
+      s_nvcmdlist_statsSW.issued = 0;
+      s_nvcmdlist_statsSW.elided = 0;
     }
 
     if(m_bindlessVboUbo)
@@ -1115,18 +3655,22 @@ void Sample::drawScene(bool depthonly, const char* what)
   }
   else
   {
-    int visible = 0;
-    for(size_t i = 0; i < m_sceneCmds.size(); i++)
+    size_t visible = 0;
+    for(const Chunk& chunk : m_chunks)
     {
-      if(m_sceneVisBits[i / 32] & (1 << (i % 32)))
+      bindChunk(chunk);
+      for(size_t i = chunk.first; i < chunk.first + chunk.count; i++)
       {
-        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, &m_sceneCmds[i]);
-        visible++;
+        if(m_sceneVisBits[i / 32] & (1 << (i % 32)))
+        {
+          glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, &m_sceneCmds[i]);
+          visible++;
+        }
       }
     }
     if(m_statsPrint)
     {
-      LOGI("%s visible: %d pct, %d\n", what, (visible * 100) / (int)m_sceneCmds.size(), visible);
+      LOGI("%s visible: %d pct, %zu\n", what, int((visible * 100) / m_sceneCmds.size()), visible);
     }
   }
 
@@ -1152,9 +3696,65 @@ void Sample::drawScene(bool depthonly, const char* what)
   }
 }
 
+CullingSystem::Job& Sample::getCullJob(Chunk& chunk)
+{
+  switch(m_tweak.drawmode)
+  {
+    case DRAW_STANDARD:
+      return chunk.cullJobReadback;
+    case DRAW_MULTIDRAWINDIRECT:
+    case DRAW_MULTIDRAWINDIRECT_COUNT:
+      return chunk.cullJobIndirect;
+    default:
+      return chunk.cullJobToken;
+  }
+}
+
+// every chunk is culled by its own job, the steps are the same for all
+
+void Sample::cullOutput(CullingSystem::MethodType method, const CullingSystem::View& view)
+{
+  for(Chunk& chunk : m_chunks)
+  {
+    m_cullSys.buildOutput(method, getCullJob(chunk), view);
+  }
+}
+
+void Sample::cullBits(CullingSystem::BitType type)
+{
+  for(Chunk& chunk : m_chunks)
+  {
+    m_cullSys.bitsFromOutput(getCullJob(chunk), type);
+  }
+}
+
+void Sample::cullResult()
+{
+  for(Chunk& chunk : m_chunks)
+  {
+    m_cullSys.resultFromBits(getCullJob(chunk));
+  }
+}
+
+void Sample::cullResultClient()
+{
+  for(Chunk& chunk : m_chunks)
+  {
+    m_cullSys.resultClient(getCullJob(chunk));
+  }
+}
+
+void Sample::cullSwapBits()
+{
+  for(Chunk& chunk : m_chunks)
+  {
+    m_cullSys.swapBits(getCullJob(chunk));
+  }
+}
+
 #define CULL_TEMPORAL_NOFRUSTUM 1
 
-void Sample::drawCullingTemporal(CullingSystem::Job& cullJob)
+void Sample::drawCullingTemporal()
 {
   CullingSystem::View view;
   view.viewWidth         = float(m_windowState.m_winSize[0]);
@@ -1170,10 +3770,10 @@ void Sample::drawCullingTemporal(CullingSystem::Job& cullJob)
       // kinda pointless to use temporal ;)
       {
         NV_PROFILE_GL_SECTION("CullF");
-        m_cullSys.buildOutput(m_tweak.method, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
-        m_cullSys.resultFromBits(cullJob);
-        m_cullSys.resultClient(cullJob);
+        cullOutput(m_tweak.method, view);
+        cullBits(CullingSystem::BITS_CURRENT);
+        cullResult();
+        cullResultClient();
       }
 
       drawScene(false, "Scene");
@@ -1183,13 +3783,13 @@ void Sample::drawCullingTemporal(CullingSystem::Job& cullJob)
       {
         NV_PROFILE_GL_SECTION("CullF");
 #if !CULL_TEMPORAL_NOFRUSTUM
-        m_cullSys.buildOutput(CullingSystem::METHOD_FRUSTUM, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT_AND_LAST);
+        cullOutput(CullingSystem::METHOD_FRUSTUM, view);
+        cullBits(CullingSystem::BITS_CURRENT_AND_LAST);
 #endif
-        m_cullSys.resultFromBits(cullJob);
-        m_cullSys.resultClient(cullJob);
+        cullResult();
+        cullResultClient();
 #if CULL_TEMPORAL_NOFRUSTUM
-        m_cullSys.swapBits(cullJob);  // last/output
+        cullSwapBits();  // last/output
 #endif
       }
 
@@ -1200,16 +3800,16 @@ void Sample::drawCullingTemporal(CullingSystem::Job& cullJob)
 
       {
         NV_PROFILE_GL_SECTION("CullH");
-        m_cullSys.buildOutput(CullingSystem::METHOD_HIZ, cullJob, view);
+        cullOutput(CullingSystem::METHOD_HIZ, view);
 
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT_AND_NOT_LAST);
-        m_cullSys.resultFromBits(cullJob);
-        m_cullSys.resultClient(cullJob);
+        cullBits(CullingSystem::BITS_CURRENT_AND_NOT_LAST);
+        cullResult();
+        cullResultClient();
 
         // for next frame
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
+        cullBits(CullingSystem::BITS_CURRENT);
 #if !CULL_TEMPORAL_NOFRUSTUM
-        m_cullSys.swapBits(cullJob);  // last/output
+        cullSwapBits();  // last/output
 #endif
       }
 
@@ -1217,33 +3817,34 @@ void Sample::drawCullingTemporal(CullingSystem::Job& cullJob)
       drawScene(false, "New");
     }
     break;
-    case CullingSystem::METHOD_RASTER: {
+    case CullingSystem::METHOD_RASTER:
+    case CullingSystem::METHOD_QUERIES: {
       {
         NV_PROFILE_GL_SECTION("CullF");
 #if !CULL_TEMPORAL_NOFRUSTUM
-        m_cullSys.buildOutput(CullingSystem::METHOD_FRUSTUM, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT_AND_LAST);
+        cullOutput(CullingSystem::METHOD_FRUSTUM, view);
+        cullBits(CullingSystem::BITS_CURRENT_AND_LAST);
 #endif
-        m_cullSys.resultFromBits(cullJob);
-        m_cullSys.resultClient(cullJob);
+        cullResult();
+        cullResultClient();
 #if CULL_TEMPORAL_NOFRUSTUM
-        m_cullSys.swapBits(cullJob);  // last/output
+        cullSwapBits();  // last/output
 #endif
       }
 
       drawScene(false, "Last");
 
       {
-        NV_PROFILE_GL_SECTION("CullR");
-        m_cullSys.buildOutput(CullingSystem::METHOD_RASTER, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT_AND_NOT_LAST);
-        m_cullSys.resultFromBits(cullJob);
-        m_cullSys.resultClient(cullJob);
+        NV_PROFILE_GL_SECTION(m_tweak.method == CullingSystem::METHOD_QUERIES ? "CullQ" : "CullR");
+        cullOutput(m_tweak.method, view);
+        cullBits(CullingSystem::BITS_CURRENT_AND_NOT_LAST);
+        cullResult();
+        cullResultClient();
 
         // for next frame
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
+        cullBits(CullingSystem::BITS_CURRENT);
 #if !CULL_TEMPORAL_NOFRUSTUM
-        m_cullSys.swapBits(cullJob);  // last/output
+        cullSwapBits();  // last/output
 #endif
       }
 
@@ -1253,7 +3854,7 @@ void Sample::drawCullingTemporal(CullingSystem::Job& cullJob)
   }
 }
 
-void Sample::drawCullingRegular(CullingSystem::Job& cullJob)
+void Sample::drawCullingRegular()
 {
   CullingSystem::View view;
   view.viewWidth         = float(m_windowState.m_winSize[0]);
@@ -1268,10 +3869,10 @@ void Sample::drawCullingRegular(CullingSystem::Job& cullJob)
     case CullingSystem::METHOD_FRUSTUM: {
       {
         NV_PROFILE_GL_SECTION("CullF");
-        m_cullSys.buildOutput(m_tweak.method, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
-        m_cullSys.resultFromBits(cullJob);
-        m_cullSys.resultClient(cullJob);
+        cullOutput(m_tweak.method, view);
+        cullBits(CullingSystem::BITS_CURRENT);
+        cullResult();
+        cullResultClient();
       }
 
       drawScene(false, "Scene");
@@ -1280,10 +3881,10 @@ void Sample::drawCullingRegular(CullingSystem::Job& cullJob)
     case CullingSystem::METHOD_HIZ: {
       {
         NV_PROFILE_GL_SECTION("CullF");
-        m_cullSys.buildOutput(CullingSystem::METHOD_FRUSTUM, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
-        m_cullSys.resultFromBits(cullJob);
-        m_cullSys.resultClient(cullJob);
+        cullOutput(CullingSystem::METHOD_FRUSTUM, view);
+        cullBits(CullingSystem::BITS_CURRENT);
+        cullResult();
+        cullResultClient();
       }
 
       drawScene(true, "Depth");
@@ -1297,34 +3898,35 @@ void Sample::drawCullingRegular(CullingSystem::Job& cullJob)
 
       {
         NV_PROFILE_GL_SECTION("CullH");
-        m_cullSys.buildOutput(CullingSystem::METHOD_HIZ, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
-        m_cullSys.resultFromBits(cullJob);
-        m_cullSys.resultClient(cullJob);
+        cullOutput(CullingSystem::METHOD_HIZ, view);
+        cullBits(CullingSystem::BITS_CURRENT);
+        cullResult();
+        cullResultClient();
       }
 
       glBindFramebuffer(GL_FRAMEBUFFER, fbos.scene);
       drawScene(false, "Scene");
     }
     break;
-    case CullingSystem::METHOD_RASTER: {
+    case CullingSystem::METHOD_RASTER:
+    case CullingSystem::METHOD_QUERIES: {
       {
         NV_PROFILE_GL_SECTION("CullF");
-        m_cullSys.buildOutput(CullingSystem::METHOD_FRUSTUM, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
-        m_cullSys.resultFromBits(cullJob);
-        m_cullSys.resultClient(cullJob);
+        cullOutput(CullingSystem::METHOD_FRUSTUM, view);
+        cullBits(CullingSystem::BITS_CURRENT);
+        cullResult();
+        cullResultClient();
       }
 
       drawScene(true, "Depth");
 
 
       {
-        NV_PROFILE_GL_SECTION("CullR");
-        m_cullSys.buildOutput(CullingSystem::METHOD_RASTER, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
-        m_cullSys.resultFromBits(cullJob);
-        m_cullSys.resultClient(cullJob);
+        NV_PROFILE_GL_SECTION(m_tweak.method == CullingSystem::METHOD_QUERIES ? "CullQ" : "CullR");
+        cullOutput(m_tweak.method, view);
+        cullBits(CullingSystem::BITS_CURRENT);
+        cullResult();
+        cullResultClient();
       }
 
       drawScene(false, "Scene");
@@ -1333,7 +3935,7 @@ void Sample::drawCullingRegular(CullingSystem::Job& cullJob)
   }
 }
 
-void Sample::drawCullingRegularLastFrame(CullingSystem::Job& cullJob)
+void Sample::drawCullingRegularLastFrame()
 {
   CullingSystem::View view;
   view.viewWidth         = float(m_windowState.m_winSize[0]);
@@ -1348,16 +3950,16 @@ void Sample::drawCullingRegularLastFrame(CullingSystem::Job& cullJob)
     case CullingSystem::METHOD_FRUSTUM: {
       {
         NV_PROFILE_GL_SECTION("Wait");
-        m_cullSys.resultClient(cullJob);
+        cullResultClient();
       }
 
       drawScene(false, "Scene");
 
       {
         NV_PROFILE_GL_SECTION("CullF");
-        m_cullSys.buildOutput(CullingSystem::METHOD_FRUSTUM, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
-        m_cullSys.resultFromBits(cullJob);
+        cullOutput(CullingSystem::METHOD_FRUSTUM, view);
+        cullBits(CullingSystem::BITS_CURRENT);
+        cullResult();
       }
     }
     break;
@@ -1365,7 +3967,7 @@ void Sample::drawCullingRegularLastFrame(CullingSystem::Job& cullJob)
 
       {
         NV_PROFILE_GL_SECTION("Wait");
-        m_cullSys.resultClient(cullJob);
+        cullResultClient();
       }
 
       drawScene(false, "Scene");
@@ -1378,25 +3980,26 @@ void Sample::drawCullingRegularLastFrame(CullingSystem::Job& cullJob)
 
       {
         NV_PROFILE_GL_SECTION("Cull");
-        m_cullSys.buildOutput(CullingSystem::METHOD_HIZ, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
-        m_cullSys.resultFromBits(cullJob);
+        cullOutput(CullingSystem::METHOD_HIZ, view);
+        cullBits(CullingSystem::BITS_CURRENT);
+        cullResult();
       }
     }
     break;
-    case CullingSystem::METHOD_RASTER: {
+    case CullingSystem::METHOD_RASTER:
+    case CullingSystem::METHOD_QUERIES: {
       {
         NV_PROFILE_GL_SECTION("Wait");
-        m_cullSys.resultClient(cullJob);
+        cullResultClient();
       }
 
       drawScene(false, "Scene");
 
       {
         NV_PROFILE_GL_SECTION("Cull");
-        m_cullSys.buildOutput(CullingSystem::METHOD_RASTER, cullJob, view);
-        m_cullSys.bitsFromOutput(cullJob, CullingSystem::BITS_CURRENT);
-        m_cullSys.resultFromBits(cullJob);
+        cullOutput(m_tweak.method, view);
+        cullBits(CullingSystem::BITS_CURRENT);
+        cullResult();
       }
     }
     break;
@@ -1423,18 +4026,41 @@ void Sample::think(double time)
 
     CullingSystem::Programs cullprograms;
     getCullPrograms(cullprograms);
-    m_cullSys.update(cullprograms, false, m_tweak.rasterType, !!has_GL_NV_representative_fragment_test);
-    m_cullJobIndirect.m_program_indirect_compact = m_progManager.get(programs.indirect_unordered);
-    m_cullJobToken.program_cmds                  = m_progManager.get(programs.token_cmds);
-    m_cullJobToken.program_sizes                 = m_progManager.get(programs.token_sizes);
+    m_cullSys.update(cullprograms, m_dualIndex, m_tweak.rasterType, !!has_GL_NV_representative_fragment_test);
+    for(Chunk& chunk : m_chunks)
+    {
+      chunk.cullJobIndirect.m_program_indirect_compact = m_progManager.get(programs.indirect_unordered);
+      chunk.cullJobToken.program_cmds                  = m_progManager.get(programs.token_cmds);
+      chunk.cullJobToken.program_sizes                 = m_progManager.get(programs.token_sizes);
+      chunk.cullJobToken.program_nops                  = m_progManager.get(programs.token_nops);
+    }
   }
 
   if(!m_progManager.areProgramsValid())
   {
-    waitEvents();
+    if(!m_headless)
+    {
+      waitEvents();
+    }
     return;
   }
 
+  m_uploadRing.beginFrame();
+
+  benchmarkAdvance();
+
+  bool sceneRebuilt = false;
+  if(m_tweak.grid != m_tweakLast.grid)
+  {
+    sceneRebuilt = rebuildScene(m_tweak.grid);
+    if(!sceneRebuilt)
+    {
+      LOGW("grid %d: scene could not be created, returning to grid %d\n", m_tweak.grid, m_tweakLast.grid);
+      m_tweak.grid = m_tweakLast.grid;
+      sceneRebuilt = rebuildScene(m_tweak.grid);
+    }
+  }
+
   if(memcmp(&m_tweak, &m_tweakLast, sizeof(Tweak)) != 0 && m_tweak.freeze == m_tweakLast.freeze)
   {
     systemChange();
@@ -1463,7 +4089,8 @@ void Sample::think(double time)
   }
 #endif
 
-  if(m_tweak.drawmode == DRAW_STANDARD && (NVPSystem::getTime() - m_statsTime) > 2.0)
+  if((m_tweak.drawmode == DRAW_STANDARD || m_tweak.drawmode == DRAW_TOKENBUFFER_EMULATION)
+     && (NVPSystem::getTime() - m_statsTime) > 2.0)
   {
     m_statsTime  = NVPSystem::getTime();
     m_statsPrint = true;
@@ -1496,74 +4123,143 @@ void Sample::think(double time)
       m_sceneUbo.viewPos = glm::row(m_sceneUbo.viewMatrixIT, 3);
       m_sceneUbo.viewDir = -glm::row(view, 2);
 
-      glBindBuffer(GL_UNIFORM_BUFFER, buffers.scene_ubo);
-      glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SceneData), &m_sceneUbo);
+      // the token streams reference the chunk UBOs by address, so the
+      // data is copied there rather than bound from the ring
+      for(const Chunk& chunk : m_chunks)
+      {
+        m_uploadRing.upload(chunk.buffers.scene_ubo, 0, sizeof(SceneData), &m_sceneUbo);
+      }
     }
   }
 
-  if(m_tweak.animate || m_tweak.animateOffset != m_tweakLast.animateOffset)
+  if(m_tweak.sceneEdits)
+  {
+    editScene(m_tweak.sceneEdits);
+  }
+
+  mat4 rotator = glm::rotate(glm::mat4(1), float(time) * 0.1f * m_tweak.animate + m_tweak.animateOffset, glm::vec3(0, 1, 0));
+  bool transformChanged = m_tweak.gpuTransform != m_tweakLast.gpuTransform;
+  if(m_tweak.gpuTransform)
+  {
+    for(Chunk& chunk : m_chunks)
+    {
+      initTransforms(chunk);
+    }
+
+    // edits only upload their inputs, the whole hierarchy is recomputed,
+    // so children follow their edited parents
+    bool edited = !m_sceneEdits.matrices.empty();
+    flushSceneEdits();
+
+    if(rotator != m_sceneRotator || m_tweak.spin != 0 || edited || sceneRebuilt || transformChanged)
+    {
+      m_sceneRotator = rotator;
+      transformScene(rotator, float(time) * m_tweak.spin);
+    }
+  }
+  else if(rotator != m_sceneRotator || sceneRebuilt || transformChanged)
   {
-    mat4 rotator = glm::rotate(glm::mat4(1), float(time) * 0.1f * m_tweak.animate + m_tweak.animateOffset, glm::vec3(0,1,0));
+    NV_PROFILE_GL_SECTION("Anim");
+    m_sceneRotator = rotator;
+
+    // every object changed, pending matrix edits are covered as well
+    m_sceneEdits.matrices.clear();
 
-    for(size_t i = 0; i < m_sceneMatrices.size() / 2; i++)
+    const size_t            pieceObjects = ANIMATE_PIECE_SIZE / sizeof(MatrixData);
+    std::vector<MatrixData> fallback;
+    for(Chunk& chunk : m_chunks)
     {
-      mat4 changed                       = rotator * m_sceneMatrices[i * 2 + 0];
-      m_sceneMatricesAnimated[i * 2 + 0] = changed;
-      m_sceneMatricesAnimated[i * 2 + 1] = glm::transpose(glm::inverse(changed));
+      for(size_t piece = 0; piece < chunk.count; piece += pieceObjects)
+      {
+        size_t count = std::min(pieceObjects, chunk.count - piece);
+        size_t size  = sizeof(MatrixData) * count;
+        size_t ringOffset;
+        void*  ringData = m_uploadRing.alloc(size, 16, ringOffset);
+
+        MatrixData* dst = (MatrixData*)ringData;
+        if(!dst)
+        {
+          fallback.resize(count);
+          dst = fallback.data();
+        }
+
+        ThreadPool::get().parallelFor(count, 16 * 1024, [&](size_t begin, size_t end) {
+          animateMatrices(chunk.first + piece + begin, end - begin, dst + begin);
+        });
+
+        if(ringData)
+        {
+          glCopyNamedBufferSubData(m_uploadRing.getBuffer(), chunk.buffers.scene_matrices, ringOffset,
+                                   sizeof(MatrixData) * piece, size);
+        }
+        else
+        {
+          glNamedBufferSubData(chunk.buffers.scene_matrices, sizeof(MatrixData) * piece, size, dst);
+        }
+      }
     }
+  }
+
+  flushSceneEdits();
 
-    glNamedBufferSubData(buffers.scene_matrices, 0, sizeof(mat4) * m_sceneMatricesAnimated.size(),
-                         m_sceneMatricesAnimated.data());
+  if(m_sceneEditVerify || m_sceneEditVerifyOnce)
+  {
+    bool ok = verifySceneEdits();
+    if(!ok || m_sceneEditVerifyOnce)
+    {
+      LOGI("scene edits: %s\n", ok ? "match" : "MISMATCH");
+    }
+    m_sceneEditVerifyOnce = false;
   }
 
 
   if(m_tweak.culling && !m_tweak.freeze)
   {
     m_cullSys.setRasterType(m_tweak.rasterType);
+    m_cullSys.setQueryLatency(m_tweak.queryLatency);
 
-    m_cullJobReadback.m_hostVisBits = m_sceneVisBits.data();
-
-    // no need to clear results given the count buffer will only cause filled content to be rendered
-    m_cullJobIndirect.m_clearResults = m_tweak.drawmode != DRAW_MULTIDRAWINDIRECT_COUNT;
+    for(Chunk& chunk : m_chunks)
+    {
+      // chunks start at full words of the visibility bits
+      chunk.cullJobReadback.m_hostVisBits = &m_sceneVisBits[chunk.first / 32];
 
-    // We change the output buffer for token emulation, as once the driver sees frequent readbacks on buffers
-    // it moves the allocation to read-friendly memory. This would be bad for the native tokenbuffer.
-    m_cullJobToken.tokenOut.buffer =
-        (m_tweak.drawmode == DRAW_TOKENBUFFER_EMULATION ? buffers.cull_tokenEmulation : buffers.cull_token);
+      // no need to clear results given the count buffer will only cause filled content to be rendered
+      chunk.cullJobIndirect.m_clearResults = m_tweak.drawmode != DRAW_MULTIDRAWINDIRECT_COUNT;
 
-    CullingSystem::Job& cullJob = (m_tweak.drawmode == DRAW_STANDARD) ?
-                                      (CullingSystem::Job&)m_cullJobReadback :
-                                      (m_tweak.drawmode == DRAW_MULTIDRAWINDIRECT || m_tweak.drawmode == DRAW_MULTIDRAWINDIRECT_COUNT ?
-                                           (CullingSystem::Job&)m_cullJobIndirect :
-                                           (CullingSystem::Job&)m_cullJobToken);
+      // We change the output buffer for token emulation, as once the driver sees frequent readbacks on buffers
+      // it moves the allocation to read-friendly memory. This would be bad for the native tokenbuffer.
+      chunk.cullJobToken.tokenOut.buffer = chunk.buffers.cull_token;
+      chunk.cullJobToken.readbackRing    = m_tweak.drawmode == DRAW_TOKENBUFFER_EMULATION;
+      chunk.cullJobToken.mode            = m_tweak.tokenCullMode;
 
-    if(m_tweak.drawmode == DRAW_STANDARD)
-    {
-      if(m_tweak.result == RESULT_REGULAR_LASTFRAME)
-      {
-        // When using persistent mapped bindings, we optimize our readback behavior.
-        // We perform the "server-side" result copy for the current frame,
-        // but read the client-side mapped results from the previous frame.
-        m_cullJobReadback.m_bufferVisBitsReadback = m_cullReadbackBuffers[m_cullFrameCycle];
-        m_cullJobReadback.m_bufferVisBitsMapping  = m_cullReadbackMappings[m_cullFrameCycle ^ 1];
-      }
-      else
+      if(m_tweak.drawmode == DRAW_STANDARD)
       {
-        m_cullJobReadback.m_bufferVisBitsReadback = m_cullReadbackBuffers[0];
-        m_cullJobReadback.m_bufferVisBitsMapping  = m_cullReadbackMappings[0];
+        if(m_tweak.result == RESULT_REGULAR_LASTFRAME)
+        {
+          // When using persistent mapped bindings, we optimize our readback behavior.
+          // We perform the "server-side" result copy for the current frame,
+          // but read the client-side mapped results from the previous frame.
+          chunk.cullJobReadback.m_bufferVisBitsReadback = chunk.cullReadbackBuffers[m_cullFrameCycle];
+          chunk.cullJobReadback.m_bufferVisBitsMapping  = chunk.cullReadbackMappings[m_cullFrameCycle ^ 1];
+        }
+        else
+        {
+          chunk.cullJobReadback.m_bufferVisBitsReadback = chunk.cullReadbackBuffers[0];
+          chunk.cullJobReadback.m_bufferVisBitsMapping  = chunk.cullReadbackMappings[0];
+        }
       }
     }
 
     switch(m_tweak.result)
     {
       case RESULT_REGULAR_CURRENT:
-        drawCullingRegular(cullJob);
+        drawCullingRegular();
         break;
       case RESULT_REGULAR_LASTFRAME:
-        drawCullingRegularLastFrame(cullJob);
+        drawCullingRegularLastFrame();
         break;
       case RESULT_TEMPORAL_CURRENT:
-        drawCullingTemporal(cullJob);
+        drawCullingTemporal();
         break;
     }
 
@@ -1580,13 +4276,22 @@ void Sample::think(double time)
   }
 
 
-  // blit to background
-  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos.scene);
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  // blit to background, headless contexts have no default framebuffer
+  if(!m_headless)
+  {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos.scene);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  }
 
   m_tweakLast = m_tweak;
 
+  if(!m_tokenReport.empty())
+  {
+    writeTokenReport(m_tokenReport.c_str());
+    m_tokenReport.clear();
+  }
+
   if(!m_tweak.noui)
   {
     NV_PROFILE_GL_SECTION("GUI");
@@ -1594,6 +4299,8 @@ void Sample::think(double time)
     ImGui::RenderDrawDataGL(ImGui::GetDrawData());
   }
 
+  m_uploadRing.endFrame();
+
   ImGui::EndFrame();
 }
 
@@ -1602,6 +4309,56 @@ void Sample::resize(int width, int height)
   initFramebuffers(width, height);
 }
 
+int Sample::runHeadless(int argc, const char** argv, int width, int height)
+{
+  m_headless                 = true;
+  m_windowState.m_winSize[0] = width;
+  m_windowState.m_winSize[1] = height;
+  m_parameterList.applyTokens(uint32_t(argc - 1), argv + 1, "-", NVPSystem::exePath().c_str());
+
+  if(m_benchmark.filename.empty())
+  {
+    LOGE("headless: requires -benchmarkmatrix <file>\n");
+    return EXIT_FAILURE;
+  }
+  // nothing is shown
+  m_tweak.noui = true;
+
+#ifdef NDEBUG
+  bool debug = false;
+#else
+  bool debug = true;
+#endif
+  if(!m_headlessGL.init(4, 5, debug))
+  {
+    return EXIT_FAILURE;
+  }
+  m_profilerGL.init();
+
+  if(!begin())
+  {
+    LOGE("headless: sample could not be initialized\n");
+    m_profilerGL.deinit();
+    m_headlessGL.deinit();
+    return EXIT_FAILURE;
+  }
+
+  // the frame loop of the window, without events and swaps
+  double startTime = NVPSystem::getTime();
+  while(m_benchmark.current < m_benchmark.runs.size())
+  {
+    m_profiler.beginFrame();
+    think(NVPSystem::getTime() - startTime);
+    m_profiler.endFrame();
+    glFlush();
+  }
+
+  end();
+  m_profilerGL.deinit();
+  m_headlessGL.deinit();
+  return EXIT_SUCCESS;
+}
+
 }  // namespace ocull
 
 using namespace ocull;
@@ -1611,5 +4368,13 @@ int main(int argc, const char** argv)
   NVPSystem system(PROJECT_NAME);
 
   Sample sample;
+  for(int i = 1; i < argc; i++)
+  {
+    // decided before a window would be opened
+    if(strcmp(argv[i], "-headless") == 0)
+    {
+      return sample.runHeadless(argc, argv, SAMPLE_SIZE_WIDTH, SAMPLE_SIZE_HEIGHT);
+    }
+  }
   return sample.run(PROJECT_NAME, argc, argv, SAMPLE_SIZE_WIDTH, SAMPLE_SIZE_HEIGHT);
 }
@@ -21,9 +21,20 @@
 #version 430
 /**/
 
+// SUBGROUP_SIZE is provided by the app (ScanSystem::getSubgroupSize)
+// when the KHR subgroup path should be used instead of the NV one
+#ifdef SUBGROUP_SIZE
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#endif
+
 #define TASK_SUM      0
 #define TASK_OFFSETS  1
 #define TASK_COMBINE  2
+#define TASK_LOOKBACK 3
+#define TASK_COMPACT  4
+#define TASK_RADIX_COUNT    5
+#define TASK_RADIX_SCATTER  6
 
 #ifndef TASK
 #define TASK TASK_SUM
@@ -32,8 +43,17 @@
 #define THREADBLOCK_SIZE  512
 #define BATCH_SIZE        (THREADBLOCK_SIZE*4)
 
+#define RADIX_BITS    4
+#define RADIX_DIGITS  (1 << RADIX_BITS)
+#define RADIX_MASK    (RADIX_DIGITS - 1)
+
+layout(location=0) uniform uint numElements;
 
-uniform uint numElements;
+// for dispatches that exceed the maximum x dimension
+uint getGroupID()
+{
+  return gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x;
+}
 
 ///////////////////////////////////////////////////////
 // based on CUDA Sample "scan.cu" 
@@ -47,7 +67,49 @@ uint threadIdx = gl_LocalInvocationID.x;
 #extension GL_NV_shader_thread_group : enable
 #extension GL_NV_shader_thread_shuffle : enable
 
-#if GL_NV_shader_thread_group
+#if defined(SUBGROUP_SIZE)
+
+#define      WARP_SIZE uint(SUBGROUP_SIZE)
+#define      NUM_WARPS (THREADBLOCK_SIZE / WARP_SIZE)
+
+shared uint s_Data[NUM_WARPS];
+
+// assumes subgroups are filled linearly by gl_LocalInvocationID.x,
+// which all implementations do for one-dimensional workgroups
+
+uint scan1Inclusive(uint idata, uint size)
+{
+  uint warpResult = subgroupInclusiveAdd(idata);
+  if (size <= WARP_SIZE){
+    return warpResult;
+  }
+
+  //Save top elements of each subgroup
+  if (gl_SubgroupInvocationID == WARP_SIZE - 1)
+    s_Data[gl_SubgroupID] = warpResult;
+
+  //wait for subgroup scans to complete
+  memoryBarrierShared();
+  barrier();
+  if (gl_SubgroupID == 0){
+    //exclusive scan of the top elements, small subgroups need several steps
+    uint carry = 0;
+    for (uint i = 0; i < NUM_WARPS; i += WARP_SIZE){
+      uint  lane  = i + gl_SubgroupInvocationID;
+      uint  val   = lane < NUM_WARPS ? s_Data[lane] : 0;
+      uint  scan  = subgroupExclusiveAdd(val);
+      if (lane < NUM_WARPS) s_Data[lane] = scan + carry;
+      carry += subgroupAdd(val);
+    }
+  }
+
+  //return updated subgroup scans with exclusive scan results
+  memoryBarrierShared();
+  barrier();
+  return warpResult + s_Data[gl_SubgroupID];
+}
+
+#elif GL_NV_shader_thread_group
 
 #define USESHUFFLE
 #define LOG2_WARP_SIZE 5U
@@ -200,32 +262,185 @@ uvec4 scan4Exclusive(uvec4 idata4, uint size)
 #endif
 
 
-#if TASK == TASK_SUM
+#if TASK == TASK_SUM || TASK == TASK_LOOKBACK
 
 layout (std430, binding=1) buffer inputBuffer {
-  uvec4 indata[];
+  uint indata[];
 };
 
 layout (std430, binding=0) buffer outputBuffer {
-  uvec4 outdata[];
+  uint outdata[];
 };
 
+// element-wise so numElements does not need to be a multiple of 4
+uvec4 load4(uint idx)
+{
+  uvec4 idata4 = uvec4(0);
+  for (uint i = 0; i < 4; i++){
+    if (idx * 4 + i < numElements) idata4[i] = indata[idx * 4 + i];
+  }
+  return idata4;
+}
+
+void store4(uint idx, uvec4 odata4)
+{
+  for (uint i = 0; i < 4; i++){
+    if (idx * 4 + i < numElements) outdata[idx * 4 + i] = odata4[i];
+  }
+}
+
+#endif
+
+#if TASK == TASK_SUM
+
 void main()
 {
   uint idx = gl_GlobalInvocationID.x;
-  uint maxidx = ((numElements + 3) / 4);
-  
-  bool valid = idx < maxidx;
 
   //Load data
-  uvec4 idata4 = valid ? indata[idx] : uvec4(0);
+  uvec4 idata4 = load4(idx);
 
   // Calculate scan
   //uvec4 odata4 = scan4Inclusive(idata4, min(BATCH_SIZE,  (maxidx-idx)*4));
   uvec4 odata4 = scan4Inclusive(idata4, BATCH_SIZE);
 
   //Write back
-  if (valid) outdata[idx] = odata4;
+  store4(idx, odata4);
+}
+#endif
+
+#if TASK == TASK_LOOKBACK
+
+///////////////////////////////////////////////////////
+// single-pass chained scan with decoupled look-back
+// based on "Single-pass Parallel Prefix Scan with Decoupled Look-back"
+// by Merrill and Garland
+//
+// Every workgroup scans one partition of BATCH_SIZE elements, publishes
+// its local aggregate and then walks backwards over the predecessors' status
+// until it finds an inclusive prefix. Partitions are handed out in launch order
+// through an atomic counter, so a predecessor has always been scheduled.
+//
+// The status packs a flag into the upper 2 bits, therefore
+// the total sum must stay below 2^30.
+//
+// With SEGMENTED the sum restarts wherever the segment index changes.
+// A partition containing a segment start knows its inclusive prefix
+// right away, only the elements before its first start need the
+// look-back result. Here the 2^30 limit applies per segment.
+
+#define STATUS_INVALID    0u
+#define STATUS_AGGREGATE  1u
+#define STATUS_PREFIX     2u
+#define STATUS_SHIFT      30
+#define STATUS_VALUE      ((1u << STATUS_SHIFT) - 1u)
+
+layout (std430, binding=2) coherent buffer stateBuffer {
+  uint partitionCounter;
+  uint partitionStatus[];
+};
+
+shared uint s_partition;
+shared uint s_exclusive;
+
+#ifdef SEGMENTED
+layout (std430, binding=3) buffer segmentBuffer {
+  uint segments[];
+};
+
+shared uint s_localExclusive[BATCH_SIZE];
+shared uint s_heads[THREADBLOCK_SIZE];
+#endif
+
+void main()
+{
+  if (threadIdx == 0){
+    s_partition = atomicAdd(partitionCounter, 1);
+  }
+  memoryBarrierShared();
+  barrier();
+  
+  uint partition = s_partition;
+  // the app may launch more workgroups than partitions
+  if (partition * BATCH_SIZE >= numElements) return;
+
+  uint idx = partition * THREADBLOCK_SIZE + threadIdx;
+
+  uvec4 idata4 = load4(idx);
+  uvec4 odata4 = scan4Inclusive(idata4, BATCH_SIZE);
+
+#ifdef SEGMENTED
+  // local index + 1 of the last segment start up to each element, 0 if none
+  uvec4 head4 = uvec4(0);
+  uint  head  = 0;
+  for (uint i = 0; i < 4; i++){
+    uint e = idx * 4 + i;
+    if (e < numElements && (e == 0 || segments[e] != segments[e-1])){
+      head = threadIdx * 4 + i + 1;
+    }
+    head4[i] = head;
+    s_localExclusive[threadIdx * 4 + i] = odata4[i] - idata4[i];
+  }
+  
+  // max-scan of the heads across the workgroup
+  s_heads[threadIdx] = head;
+  memoryBarrierShared();
+  barrier();
+  for (uint offset = 1; offset < THREADBLOCK_SIZE; offset <<= 1){
+    uint other = threadIdx >= offset ? s_heads[threadIdx - offset] : 0;
+    memoryBarrierShared();
+    barrier();
+    s_heads[threadIdx] = max(s_heads[threadIdx], other);
+    memoryBarrierShared();
+    barrier();
+  }
+  head4 = max(head4, uvec4(threadIdx > 0 ? s_heads[threadIdx - 1] : 0));
+  
+  // restart at the segment start within the partition
+  for (uint i = 0; i < 4; i++){
+    if (head4[i] != 0) odata4[i] -= s_localExclusive[head4[i] - 1];
+  }
+#endif
+
+  if (threadIdx == THREADBLOCK_SIZE - 1){
+    uint aggregate = odata4.w;
+    uint exclusive = 0;
+    bool isPrefix  = partition == 0;
+  #ifdef SEGMENTED
+    isPrefix = isPrefix || head4.w != 0;
+  #endif
+    
+    atomicExchange(partitionStatus[partition], ((isPrefix ? STATUS_PREFIX : STATUS_AGGREGATE) << STATUS_SHIFT) | aggregate);
+    
+    if (partition > 0){
+      int look = int(partition) - 1;
+      while (look >= 0){
+        uint status = atomicAdd(partitionStatus[look], 0);
+        uint flag   = status >> STATUS_SHIFT;
+        if (flag == STATUS_INVALID) continue;
+        
+        exclusive += status & STATUS_VALUE;
+        if (flag == STATUS_PREFIX) break;
+        look--;
+      }
+      
+      if (!isPrefix){
+        atomicExchange(partitionStatus[partition], (STATUS_PREFIX << STATUS_SHIFT) | (exclusive + aggregate));
+      }
+    }
+    s_exclusive = exclusive;
+  }
+  memoryBarrierShared();
+  barrier();
+  
+#ifdef SEGMENTED
+  for (uint i = 0; i < 4; i++){
+    if (head4[i] == 0) odata4[i] += s_exclusive;
+  }
+  store4(idx, odata4);
+#else
+  store4(idx, odata4 + uvec4(s_exclusive));
+#endif
 }
 #endif
 
@@ -286,3 +501,174 @@ void main()
   }
 }
 #endif
+
+#if TASK == TASK_COMPACT
+
+layout (std430, binding=1) buffer flagBuffer {
+  uint flags[];
+};
+
+layout (std430, binding=2) buffer flagScanBuffer {
+  uint flagScan[];
+};
+
+layout (std430, binding=3) buffer inputBuffer {
+  uint indata[];
+};
+
+layout (std430, binding=0) buffer outputBuffer {
+  uint outdata[];
+};
+
+layout (std430, binding=4) buffer countBuffer {
+  uint count;
+};
+
+void main()
+{
+  uint idx = getGroupID() * THREADBLOCK_SIZE + gl_LocalInvocationID.x;
+  if (idx >= numElements) return;
+  
+  // flagScan is inclusive
+  if (flags[idx] != 0) {
+    outdata[flagScan[idx] - 1] = indata[idx];
+  }
+  if (idx == numElements - 1) {
+    count = flagScan[idx];
+  }
+}
+#endif
+
+///////////////////////////////////////////////////////
+// radix sort
+//
+// Every pass sorts by RADIX_BITS of the key starting at radixShift.
+// TASK_RADIX_COUNT builds a digit histogram per partition of BATCH_SIZE
+// elements, stored digit-major as counts[digit * numPartitions + partition],
+// so that the scan of it provides the output offset of every digit in every
+// partition. TASK_RADIX_SCATTER ranks the elements within the partition and
+// writes them to their sorted location, which keeps the sort stable.
+
+#if TASK == TASK_RADIX_COUNT || TASK == TASK_RADIX_SCATTER
+
+layout(location=1) uniform uint radixShift;
+
+uint numPartitions = (numElements + BATCH_SIZE - 1) / BATCH_SIZE;
+
+#endif
+
+#if TASK == TASK_RADIX_COUNT
+
+layout (std430, binding=1) buffer keyBuffer {
+  uint keys[];
+};
+
+layout (std430, binding=0) buffer countBuffer {
+  uint counts[];
+};
+
+shared uint s_counts[RADIX_DIGITS];
+
+void main()
+{
+  uint partition = getGroupID();
+  if (partition >= numPartitions) return;
+
+  if (threadIdx < RADIX_DIGITS) {
+    s_counts[threadIdx] = 0;
+  }
+  memoryBarrierShared();
+  barrier();
+
+  for (uint i = 0; i < 4; i++){
+    uint e = partition * BATCH_SIZE + i * THREADBLOCK_SIZE + threadIdx;
+    if (e < numElements) {
+      atomicAdd(s_counts[(keys[e] >> radixShift) & RADIX_MASK], 1);
+    }
+  }
+  memoryBarrierShared();
+  barrier();
+
+  if (threadIdx < RADIX_DIGITS) {
+    counts[threadIdx * numPartitions + partition] = s_counts[threadIdx];
+  }
+}
+#endif
+
+#if TASK == TASK_RADIX_SCATTER
+
+layout (std430, binding=1) buffer keyInBuffer {
+  uint keysIn[];
+};
+
+layout (std430, binding=2) buffer valueInBuffer {
+  uint valuesIn[];
+};
+
+layout (std430, binding=0) buffer keyOutBuffer {
+  uint keysOut[];
+};
+
+layout (std430, binding=3) buffer valueOutBuffer {
+  uint valuesOut[];
+};
+
+layout (std430, binding=4) buffer countBuffer {
+  uint counts[];
+};
+
+layout (std430, binding=5) buffer countScanBuffer {
+  uint countScan[];
+};
+
+shared uint s_base[RADIX_DIGITS];
+
+void main()
+{
+  uint partition = getGroupID();
+  if (partition >= numPartitions) return;
+
+  if (threadIdx < RADIX_DIGITS) {
+    uint c = threadIdx * numPartitions + partition;
+    s_base[threadIdx] = countScan[c] - counts[c];
+  }
+
+  uint idx = partition * THREADBLOCK_SIZE + threadIdx;
+
+  uvec4 key4   = uvec4(0);
+  uvec4 value4 = uvec4(0);
+  uvec4 digit4 = uvec4(RADIX_DIGITS); // never matches
+  for (uint i = 0; i < 4; i++){
+    uint e = idx * 4 + i;
+    if (e < numElements) {
+      key4[i]   = keysIn[e];
+      value4[i] = valuesIn[e];
+      digit4[i] = (key4[i] >> radixShift) & RADIX_MASK;
+    }
+  }
+
+  // rank within partition, two digits at once in the 16-bit halves
+  uvec4 rank4 = uvec4(0);
+  for (uint d = 0; d < RADIX_DIGITS / 2; d++){
+    uvec4 flags4 = uvec4(equal(digit4, uvec4(d))) | (uvec4(equal(digit4, uvec4(d + RADIX_DIGITS / 2))) << 16);
+    // scan4Inclusive reuses shared memory
+    memoryBarrierShared();
+    barrier();
+    uvec4 scan4 = scan4Inclusive(flags4, BATCH_SIZE);
+    for (uint i = 0; i < 4; i++){
+      if (digit4[i] == d) rank4[i] = (scan4[i] & 0xFFFF) - 1;
+      if (digit4[i] == d + RADIX_DIGITS / 2) rank4[i] = (scan4[i] >> 16) - 1;
+    }
+  }
+  memoryBarrierShared();
+  barrier();
+
+  for (uint i = 0; i < 4; i++){
+    if (digit4[i] < RADIX_DIGITS) {
+      uint pos = s_base[digit4[i]] + rank4[i];
+      keysOut[pos]   = key4[i];
+      valuesOut[pos] = value4[i];
+    }
+  }
+}
+#endif
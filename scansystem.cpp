@@ -21,13 +21,28 @@
 /* Contact ckubisch@nvidia.com (Christoph Kubisch) for feedback */
 
 #include "scansystem.hpp"
+#include "threadpool.hpp"
 #include <assert.h>
 
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <nvh/nvprint.hpp>
+
+// conservative GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT for sub-ranges
+static const size_t BUFFER_ALIGN = 256;
+
 inline static GLuint snapdiv(GLuint input, GLuint align)
 {
   return (input + align - 1) / align;
 }
 
+inline static size_t snapsize(size_t input, size_t align)
+{
+  return ((input + align - 1) / align) * align;
+}
+
 size_t ScanSystem::getOffsetSize(GLuint elements)
 {
   GLuint groups = snapdiv(elements,BATCH_ELEMENTS);
@@ -46,9 +61,28 @@ size_t ScanSystem::getOffsetSize(GLuint elements)
   return GLsizei(size);
 }
 
+size_t ScanSystem::getLookbackSize(GLuint elements)
+{
+  // partition counter + status per partition
+  return (1 + snapdiv(elements,BATCH_ELEMENTS)) * sizeof(GLuint);
+}
+
+size_t ScanSystem::getScratchSize(GLuint elements)
+{
+  size_t offsets  = getOffsetSize(elements);
+  size_t lookback = getLookbackSize(elements);
+  return offsets > lookback ? offsets : lookback;
+}
+
+size_t ScanSystem::getRadixSortTempSize(GLuint elements)
+{
+  GLuint counts = snapdiv(elements,BATCH_ELEMENTS) * RADIX_DIGITS;
+  // counts, scanned counts, scratch
+  return snapsize(counts * sizeof(GLuint), BUFFER_ALIGN) * 2 + getScratchSize(counts);
+}
+
 bool ScanSystem::scanData( GLuint elements, const Buffer& input, const Buffer& output, const Buffer& offsets )
 {
-  assert( (elements % 4) == 0 );
   assert( size_t(elements) < (GLuint64)BATCH_ELEMENTS*BATCH_ELEMENTS*BATCH_ELEMENTS);
   assert( size_t(elements) * sizeof(GLuint) <= size_t(input.size) );
   assert( input.size <= output.size );
@@ -105,11 +139,193 @@ bool ScanSystem::scanData( GLuint elements, const Buffer& input, const Buffer& o
   }
 
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER,0,0);
-  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,0,1);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,1,0);
   
   return groups > 1;
 }
 
+void ScanSystem::scanDataCombined( GLuint elements, const Buffer& input, const Buffer& output, const Buffer& scratch )
+{
+  if (!elements) return;
+
+  if (!useLookback || !programs.lookback){
+    if (scanData(elements, input, output, scratch)){
+      combineWithOffsets(elements, output, scratch);
+    }
+    return;
+  }
+
+  dispatchLookback(programs.lookback, elements, input, output, scratch);
+}
+
+bool ScanSystem::scanDataSegmented( GLuint elements, const Buffer& input, const Buffer& segments, const Buffer& output, const Buffer& scratch )
+{
+  if (!useLookback || !programs.segmented){
+    scanDataCombined(elements, input, output, scratch);
+    return false;
+  }
+
+  if (!elements) return true;
+
+  assert( size_t(elements) * sizeof(GLuint) <= size_t(segments.size) );
+
+  segments.BindBufferRange(GL_SHADER_STORAGE_BUFFER,3);
+
+  dispatchLookback(programs.segmented, elements, input, output, scratch);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,3,0);
+
+  return true;
+}
+
+void ScanSystem::dispatchLookback( GLuint program, GLuint elements, const Buffer& input, const Buffer& output, const Buffer& scratch )
+{
+  assert( size_t(elements) * sizeof(GLuint) <= size_t(input.size) );
+  assert( input.size <= output.size );
+  assert( getLookbackSize(elements) <= size_t(scratch.size) );
+
+  // reset partition counter and status
+  glClearNamedBufferSubData(scratch.buffer, GL_R32UI, scratch.offset, getLookbackSize(elements), GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+
+  glUseProgram(program);
+  glUniform1ui(0,elements);
+
+  input.BindBufferRange(GL_SHADER_STORAGE_BUFFER,1);
+  output.BindBufferRange(GL_SHADER_STORAGE_BUFFER,0);
+  scratch.BindBufferRange(GL_SHADER_STORAGE_BUFFER,2);
+
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  // partitions are assigned dynamically, so the grid shape does not matter
+  dispatchGroups(snapdiv(elements,BATCH_ELEMENTS));
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,0,0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,1,0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,2,0);
+}
+
+void ScanSystem::dispatchGroups( GLuint groups )
+{
+  // shaders use getGroupID, so the grid may exceed the dimension limit
+  GLuint groupsX = groups < maxGrpsPrefix ? groups : maxGrpsPrefix;
+  glDispatchCompute(groupsX,snapdiv(groups,groupsX),1);
+}
+
+void ScanSystem::compact( GLuint elements, const Buffer& flags, const Buffer& input, const Buffer& output, const Buffer& count, const Buffer& temp, const Buffer& scratch )
+{
+  if (!elements){
+    glClearNamedBufferSubData(count.buffer, GL_R32UI, count.offset, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+    return;
+  }
+
+  assert( programs.compact );
+  assert( size_t(elements) * sizeof(GLuint) <= size_t(input.size) );
+  assert( size_t(elements) * sizeof(GLuint) <= size_t(output.size) );
+  assert( sizeof(GLuint) <= size_t(count.size) );
+
+  scanDataCombined(elements, flags, temp, scratch);
+
+  glUseProgram(programs.compact);
+  glUniform1ui(0,elements);
+
+  output.BindBufferRange(GL_SHADER_STORAGE_BUFFER,0);
+  flags.BindBufferRange(GL_SHADER_STORAGE_BUFFER,1);
+  temp.BindBufferRange(GL_SHADER_STORAGE_BUFFER,2);
+  input.BindBufferRange(GL_SHADER_STORAGE_BUFFER,3);
+  count.BindBufferRange(GL_SHADER_STORAGE_BUFFER,4);
+
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  dispatchGroups(snapdiv(elements,GROUPSIZE));
+
+  for (GLuint i = 0; i < 5; i++){
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,i,0);
+  }
+}
+
+void ScanSystem::radixSort( GLuint elements, const Buffer& keys, const Buffer& values, const Buffer& tempKeys, const Buffer& tempValues, const Buffer& temp, GLuint keyBits )
+{
+  if (!elements) return;
+
+  assert( programs.radixCount && programs.radixScatter );
+  assert( keyBits > 0 && keyBits <= 32 );
+  assert( size_t(elements) * sizeof(GLuint) <= size_t(keys.size) );
+  assert( size_t(elements) * sizeof(GLuint) <= size_t(values.size) );
+  assert( size_t(elements) * sizeof(GLuint) <= size_t(tempKeys.size) );
+  assert( size_t(elements) * sizeof(GLuint) <= size_t(tempValues.size) );
+  assert( getRadixSortTempSize(elements) <= size_t(temp.size) );
+
+  GLuint partitions = snapdiv(elements,BATCH_ELEMENTS);
+  GLuint numCounts  = partitions * RADIX_DIGITS;
+  GLintptr required = snapsize(numCounts * sizeof(GLuint), BUFFER_ALIGN);
+
+  Buffer counts = temp; // derive from temp
+  counts.size = numCounts * sizeof(GLuint);
+
+  Buffer countScan = counts;
+  countScan.offset += required;
+
+  Buffer scratch = temp;
+  scratch.offset += required * 2;
+  scratch.size = temp.size - required * 2;
+
+  const Buffer* keysIn    = &keys;
+  const Buffer* valuesIn  = &values;
+  const Buffer* keysOut   = &tempKeys;
+  const Buffer* valuesOut = &tempValues;
+
+  GLuint passes = snapdiv(keyBits,RADIX_BITS);
+  for (GLuint pass = 0; pass < passes; pass++){
+    // histogram of digits per partition
+    glUseProgram(programs.radixCount);
+    glUniform1ui(0,elements);
+    glUniform1ui(1,pass * RADIX_BITS);
+
+    counts.BindBufferRange(GL_SHADER_STORAGE_BUFFER,0);
+    keysIn->BindBufferRange(GL_SHADER_STORAGE_BUFFER,1);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    dispatchGroups(partitions);
+
+    // output offset per digit and partition
+    scanDataCombined(numCounts, counts, countScan, scratch);
+
+    glUseProgram(programs.radixScatter);
+    glUniform1ui(0,elements);
+    glUniform1ui(1,pass * RADIX_BITS);
+
+    keysOut->BindBufferRange(GL_SHADER_STORAGE_BUFFER,0);
+    keysIn->BindBufferRange(GL_SHADER_STORAGE_BUFFER,1);
+    valuesIn->BindBufferRange(GL_SHADER_STORAGE_BUFFER,2);
+    valuesOut->BindBufferRange(GL_SHADER_STORAGE_BUFFER,3);
+    counts.BindBufferRange(GL_SHADER_STORAGE_BUFFER,4);
+    countScan.BindBufferRange(GL_SHADER_STORAGE_BUFFER,5);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    dispatchGroups(partitions);
+
+    const Buffer* swapKeys   = keysIn;
+    const Buffer* swapValues = valuesIn;
+    keysIn    = keysOut;
+    valuesIn  = valuesOut;
+    keysOut   = swapKeys;
+    valuesOut = swapValues;
+  }
+
+  for (GLuint i = 0; i < 6; i++){
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,i,0);
+  }
+
+  if (passes % 2){
+    // result ended up in the temp buffers
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glCopyNamedBufferSubData(tempKeys.buffer, keys.buffer, tempKeys.offset, keys.offset, elements * sizeof(GLuint));
+    glCopyNamedBufferSubData(tempValues.buffer, values.buffer, tempValues.offset, values.offset, elements * sizeof(GLuint));
+  }
+}
+
 void ScanSystem::combineWithOffsets(GLuint elements, const Buffer& output, const Buffer& offsets )
 {
   //assert((elements % 4) == 0);
@@ -128,8 +344,30 @@ void ScanSystem::combineWithOffsets(GLuint elements, const Buffer& output, const
   glDispatchCompute(groups,1,1);
 }
 
+GLuint ScanSystem::getSubgroupSize()
+{
+  if (has_GL_NV_shader_thread_group && has_GL_NV_shader_thread_shuffle) return 0;
+  if (!has_GL_KHR_shader_subgroup) return 0;
+
+  GLint stages   = 0;
+  GLint features = 0;
+  GLint size     = 0;
+  glGetIntegerv(GL_SUBGROUP_SUPPORTED_STAGES_KHR, &stages);
+  glGetIntegerv(GL_SUBGROUP_SUPPORTED_FEATURES_KHR, &features);
+  glGetIntegerv(GL_SUBGROUP_SIZE_KHR, &size);
+
+  GLint required = GL_SUBGROUP_FEATURE_BASIC_BIT_KHR | GL_SUBGROUP_FEATURE_ARITHMETIC_BIT_KHR;
+  if (!(stages & GL_COMPUTE_SHADER_BIT) || (features & required) != required) return 0;
+
+  // the shader needs a power of two that divides GROUPSIZE
+  if (size < 8 || size > 64 || (size & (size - 1))) return 0;
+
+  return GLuint(size);
+}
+
 void ScanSystem::init( const Programs& progs )
 {
+  useLookback = true;
   update(progs);
 }
 
@@ -149,7 +387,7 @@ void ScanSystem::update( const Programs& progs )
   programs = progs;
 }
 
-void ScanSystem::test()
+void ScanSystem::testFixed()
 {
   GLuint scanbuffers[3];
   glCreateBuffers(3,scanbuffers);
@@ -200,6 +438,387 @@ void ScanSystem::test()
   glGetNamedBufferSubData(scanbuffers[1],sizeof(GLuint) * (high-1), sizeof(GLuint), &result);
   assert(result == high);
 
+  // combined, not a multiple of 4
+  GLuint odd = high - 3;
+  assert(getScratchSize(odd) <= offsize);
+  scanDataCombined(odd, scanbuffers[0], scanbuffers[1], scanbuffers[2]);
+  result = 0;
+  glGetNamedBufferSubData(scanbuffers[1],sizeof(GLuint) * (odd-1), sizeof(GLuint), &result);
+  assert(result == odd);
+
+  // segmented, restarts every segsize elements
+  GLuint segsize = 1000;
+  GLuint* segs = new GLuint[odd];
+  for (GLuint i = 0; i < odd; i++){
+    segs[i] = i / segsize;
+  }
+  GLuint segbuffer;
+  glCreateBuffers(1,&segbuffer);
+  glNamedBufferStorage(segbuffer, odd * sizeof(GLuint), &segs[0], 0 );
+  delete [] segs;
+
+  scanDataSegmented(odd, scanbuffers[0], segbuffer, scanbuffers[1], scanbuffers[2]);
+  result = 0;
+  glGetNamedBufferSubData(scanbuffers[1],sizeof(GLuint) * (odd-1), sizeof(GLuint), &result);
+  assert(result == ((odd-1) % segsize) + 1);
+  glGetNamedBufferSubData(scanbuffers[1],sizeof(GLuint) * (segsize-1), sizeof(GLuint), &result);
+  assert(result == segsize);
+
+  glDeleteBuffers(1,&segbuffer);
+
+  // compaction, keep every third element
+  {
+    GLuint* flags = new GLuint[odd];
+    GLuint* input = new GLuint[odd];
+    for (GLuint i = 0; i < odd; i++){
+      flags[i] = (i % 3) == 0 ? 1 : 0;
+      input[i] = i;
+    }
+    GLuint compactbuffers[4];
+    glCreateBuffers(4,compactbuffers);
+    glNamedBufferStorage(compactbuffers[0], odd * sizeof(GLuint), &flags[0], 0 );
+    glNamedBufferStorage(compactbuffers[1], odd * sizeof(GLuint), &input[0], 0 );
+    glNamedBufferStorage(compactbuffers[2], odd * sizeof(GLuint), 0, 0 );
+    glNamedBufferStorage(compactbuffers[3], sizeof(GLuint), 0, 0 );
+    delete [] flags;
+    delete [] input;
+
+    compact(odd, compactbuffers[0], compactbuffers[1], compactbuffers[2], compactbuffers[3], scanbuffers[1], scanbuffers[2]);
+    glGetNamedBufferSubData(compactbuffers[3], 0, sizeof(GLuint), &result);
+    assert(result == (odd + 2) / 3);
+    glGetNamedBufferSubData(compactbuffers[2], sizeof(GLuint) * (result-1), sizeof(GLuint), &result);
+    assert(result == ((odd + 2) / 3 - 1) * 3);
+
+    glDeleteBuffers(4,compactbuffers);
+  }
+
+  // radix sort of hashed keys, values are the original index
+  {
+    GLuint* keys   = new GLuint[odd];
+    GLuint* values = new GLuint[odd];
+    for (GLuint i = 0; i < odd; i++){
+      keys[i]   = i * 2654435761u;
+      values[i] = i;
+    }
+    GLuint sortbuffers[5];
+    glCreateBuffers(5,sortbuffers);
+    glNamedBufferStorage(sortbuffers[0], odd * sizeof(GLuint), &keys[0], GL_MAP_READ_BIT );
+    glNamedBufferStorage(sortbuffers[1], odd * sizeof(GLuint), &values[0], GL_MAP_READ_BIT );
+    glNamedBufferStorage(sortbuffers[2], odd * sizeof(GLuint), 0, 0 );
+    glNamedBufferStorage(sortbuffers[3], odd * sizeof(GLuint), 0, 0 );
+    glNamedBufferStorage(sortbuffers[4], getRadixSortTempSize(odd), 0, 0 );
+
+    radixSort(odd, sortbuffers[0], sortbuffers[1], sortbuffers[2], sortbuffers[3], sortbuffers[4]);
+
+    glGetNamedBufferSubData(sortbuffers[0], 0, odd * sizeof(GLuint), &keys[0]);
+    glGetNamedBufferSubData(sortbuffers[1], 0, odd * sizeof(GLuint), &values[0]);
+    for (GLuint i = 0; i < odd; i++){
+      assert(i == 0 || keys[i-1] <= keys[i]);
+      assert(keys[i] == values[i] * 2654435761u);
+    }
+
+    delete [] keys;
+    delete [] values;
+    glDeleteBuffers(5,sortbuffers);
+  }
+
   glDeleteBuffers(3,scanbuffers);
 }
 
+void ScanSystem::scanReference( const GLuint* input, GLuint* output, size_t elements, const GLuint* segments )
+{
+  if (!elements) return;
+
+  size_t numThreads = ThreadPool::get().getNumThreads();
+  size_t chunkSize  = std::max((elements + numThreads - 1) / numThreads, size_t(BATCH_ELEMENTS));
+  size_t numChunks  = (elements + chunkSize - 1) / chunkSize;
+
+  // per chunk: local (segmented) scan, whether it contains a segment start
+  // and where the first one is
+  std::vector<size_t> firstHead(numChunks);
+
+  ThreadPool::get().run(numChunks, [&](size_t c){
+    size_t begin = c * chunkSize;
+    size_t end   = std::min(begin + chunkSize, elements);
+    size_t first = end;
+    GLuint sum   = 0;
+    for (size_t i = begin; i < end; i++){
+      if (segments && (i == 0 || segments[i] != segments[i-1])){
+        sum = 0;
+        if (first == end) first = i;
+      }
+      sum += input[i];
+      output[i] = sum;
+    }
+    firstHead[c] = first;
+  });
+
+  // carry into every chunk
+  std::vector<GLuint> carry(numChunks, 0);
+  for (size_t c = 1; c < numChunks; c++){
+    size_t begin = (c - 1) * chunkSize;
+    size_t last  = std::min(begin + chunkSize, elements) - 1;
+    bool   reset = firstHead[c-1] != std::min(begin + chunkSize, elements);
+    carry[c] = output[last] + (reset ? 0 : carry[c-1]);
+  }
+
+  ThreadPool::get().run(numChunks - 1, [&](size_t task){
+    size_t c     = task + 1;
+    size_t begin = c * chunkSize;
+    for (size_t i = begin; i < firstHead[c]; i++){
+      output[i] += carry[c];
+    }
+  });
+}
+
+bool ScanSystem::test( GLuint maxElements, GLuint seed )
+{
+  testFixed();
+
+  std::vector<GLuint> sizes;
+  const GLuint fixedSizes[] = {
+    1, 2, 3, 4, 5, 7,
+    GLuint(GROUPSIZE - 1), GLuint(GROUPSIZE), GLuint(GROUPSIZE + 1),
+    GLuint(BATCH_ELEMENTS - 1), GLuint(BATCH_ELEMENTS), GLuint(BATCH_ELEMENTS + 1), GLuint(BATCH_ELEMENTS * 2 + 3),
+    GLuint(BATCH_ELEMENTS * BATCH_ELEMENTS - 1), GLuint(BATCH_ELEMENTS * BATCH_ELEMENTS), GLuint(BATCH_ELEMENTS * BATCH_ELEMENTS + 1),
+    maxElements,
+  };
+  std::mt19937 rnd(seed);
+  for (size_t i = 0; i < sizeof(fixedSizes)/sizeof(fixedSizes[0]); i++){
+    if (fixedSizes[i] <= maxElements) sizes.push_back(fixedSizes[i]);
+  }
+  for (int i = 0; i < 8; i++){
+    sizes.push_back(1 + rnd() % maxElements);
+  }
+  // last run uses the largest total
+  sizes.push_back(maxElements);
+  const GLuint maxTotal = (1u << 30) - 1;
+
+  size_t bufferSize = size_t(maxElements) * sizeof(GLuint);
+  size_t scratchSize = std::max(getScratchSize(maxElements), getRadixSortTempSize(maxElements));
+
+  // input, output, scratch, segments, values, tempKeys, tempValues, count
+  GLuint buffers[8];
+  glCreateBuffers(8,buffers);
+  for (int i = 0; i < 7; i++){
+    glNamedBufferStorage(buffers[i], i == 2 ? scratchSize : bufferSize, 0, GL_DYNAMIC_STORAGE_BIT);
+  }
+  glNamedBufferStorage(buffers[7], sizeof(GLuint), 0, GL_DYNAMIC_STORAGE_BIT);
+
+  std::vector<GLuint> input(maxElements);
+  std::vector<GLuint> segments(maxElements);
+  std::vector<GLuint> values(maxElements);
+  std::vector<GLuint> reference(maxElements);
+  std::vector<GLuint> result(maxElements);
+
+  bool useLookbackOrig = useLookback;
+  bool passed = true;
+
+  for (size_t s = 0; s < sizes.size(); s++){
+    GLuint n = sizes[s];
+    size_t bytes = size_t(n) * sizeof(GLuint);
+
+    // small values so that the totals stay within the look-back limit,
+    // except for the last run, which sums up to exactly that limit
+    bool   maxSum  = s + 1 == sizes.size();
+    GLuint segment = 0;
+    for (GLuint i = 0; i < n; i++){
+      input[i]    = maxSum ? maxTotal / n + (i < maxTotal % n ? 1 : 0) : rnd() & 15;
+      segment    += (rnd() & 63) == 0 ? 1 : 0;
+      segments[i] = segment;
+    }
+    glNamedBufferSubData(buffers[0], 0, bytes, input.data());
+    glNamedBufferSubData(buffers[3], 0, bytes, segments.data());
+
+    auto verify = [&](const char* what, const GLuint* expected, size_t count, GLuint buffer){
+      glGetNamedBufferSubData(buffer, 0, count * sizeof(GLuint), result.data());
+      for (size_t i = 0; i < count; i++){
+        if (result[i] != expected[i]){
+          LOGE("scan test: %s failed for %u elements at %zu: %u instead of %u\n", what, n, i, result[i], expected[i]);
+          passed = false;
+          return;
+        }
+      }
+    };
+
+    scanReference(input.data(), reference.data(), n);
+
+    // multi-pass
+    if ( size_t(n) < (GLuint64)BATCH_ELEMENTS*BATCH_ELEMENTS*BATCH_ELEMENTS ){
+      if (scanData(n, buffers[0], buffers[1], buffers[2])){
+        combineWithOffsets(n, buffers[1], buffers[2]);
+      }
+      verify("multi-pass", reference.data(), n, buffers[1]);
+    }
+
+    // single-pass
+    if (programs.lookback){
+      useLookback = true;
+      scanDataCombined(n, buffers[0], buffers[1], buffers[2]);
+      verify("look-back", reference.data(), n, buffers[1]);
+    }
+
+    // segmented, then the multi-pass fallback that leaves the plain scan
+    for (int pass = 0; pass < 2; pass++){
+      useLookback = pass == 0;
+      if (!useLookback && size_t(n) >= (GLuint64)BATCH_ELEMENTS*BATCH_ELEMENTS*BATCH_ELEMENTS) break;
+
+      bool segmented = scanDataSegmented(n, buffers[0], buffers[3], buffers[1], buffers[2]);
+      scanReference(input.data(), reference.data(), n, segmented ? segments.data() : nullptr);
+      verify(segmented ? "segmented" : "segmented fallback", reference.data(), n, buffers[1]);
+    }
+    useLookback = useLookbackOrig;
+
+    // compaction of odd values, the indices are kept
+    if (programs.compact){
+      GLuint kept = 0;
+      for (GLuint i = 0; i < n; i++){
+        values[i] = i;
+        input[i] &= 1;
+        if (input[i]) reference[kept++] = i;
+      }
+      glNamedBufferSubData(buffers[0], 0, bytes, input.data());
+      glNamedBufferSubData(buffers[4], 0, bytes, values.data());
+
+      compact(n, buffers[0], buffers[4], buffers[5], buffers[7], buffers[1], buffers[2]);
+      verify("compact count", &kept, 1, buffers[7]);
+      verify("compact", reference.data(), kept, buffers[5]);
+    }
+
+    // radix sort of random keys, values are the original index
+    if (programs.radixCount && programs.radixScatter){
+      for (GLuint i = 0; i < n; i++){
+        input[i]  = rnd();
+        values[i] = i;
+      }
+      glNamedBufferSubData(buffers[0], 0, bytes, input.data());
+      glNamedBufferSubData(buffers[4], 0, bytes, values.data());
+
+      radixSort(n, buffers[0], buffers[4], buffers[5], buffers[6], buffers[2]);
+
+      std::stable_sort(values.begin(), values.begin() + n, [&](GLuint a, GLuint b){ return input[a] < input[b]; });
+      for (GLuint i = 0; i < n; i++){
+        reference[i] = input[values[i]];
+      }
+      verify("radix keys", reference.data(), n, buffers[0]);
+      verify("radix values", values.data(), n, buffers[4]);
+    }
+  }
+
+  useLookback = useLookbackOrig;
+  glDeleteBuffers(8,buffers);
+
+  return passed;
+}
+
+template <typename T>
+static double measureMilliseconds(GLuint iterations, T fn)
+{
+  GLuint queries[2];
+  glGenQueries(2,queries);
+
+  // warm up
+  fn();
+
+  glQueryCounter(queries[0], GL_TIMESTAMP);
+  for (GLuint i = 0; i < iterations; i++){
+    fn();
+  }
+  glQueryCounter(queries[1], GL_TIMESTAMP);
+
+  GLuint64 begin;
+  GLuint64 end;
+  glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &begin);
+  glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+  glDeleteQueries(2,queries);
+
+  return double(end - begin) / (double(iterations) * 1000000.0);
+}
+
+void ScanSystem::benchmark( GLuint minElements, GLuint maxElements, GLuint iterations )
+{
+  size_t bufferSize  = size_t(maxElements) * sizeof(GLuint);
+  size_t scratchSize = std::max(getScratchSize(maxElements), getRadixSortTempSize(maxElements));
+
+  // input, output, scratch, segments, values, tempKeys, tempValues, count, random keys
+  GLuint buffers[9];
+  glCreateBuffers(9,buffers);
+  for (int i = 0; i < 7; i++){
+    glNamedBufferStorage(buffers[i], i == 2 ? scratchSize : bufferSize, 0, GL_DYNAMIC_STORAGE_BIT);
+  }
+  glNamedBufferStorage(buffers[7], sizeof(GLuint), 0, GL_DYNAMIC_STORAGE_BIT);
+  glNamedBufferStorage(buffers[8], bufferSize, 0, GL_DYNAMIC_STORAGE_BIT);
+
+  {
+    // values 0/1, usable as scan input and compaction flags,
+    // segments of 1000 elements
+    std::vector<GLuint> data(maxElements);
+    std::mt19937 rnd(1);
+    for (GLuint i = 0; i < maxElements; i++){
+      data[i] = rnd() & 1;
+    }
+    glNamedBufferSubData(buffers[0], 0, bufferSize, data.data());
+    for (GLuint i = 0; i < maxElements; i++){
+      data[i] = i / 1000;
+    }
+    glNamedBufferSubData(buffers[3], 0, bufferSize, data.data());
+    for (GLuint i = 0; i < maxElements; i++){
+      data[i] = rnd();
+    }
+    glNamedBufferSubData(buffers[8], 0, bufferSize, data.data());
+  }
+
+  bool useLookbackOrig = useLookback;
+
+  // bytes are counted once for every read and written element
+  LOGI("scan benchmark GB/s\n");
+  LOGI("elements, sum+offsets, combine, look-back, segmented, compact, radix sort 32-bit\n");
+  static const GLuint steps[] = {1, 2, 5};
+  for (GLuint64 decade = 1; decade * minElements <= maxElements; decade *= 10){
+    for (int step = 0; step < 3; step++){
+      GLuint64 n64 = decade * steps[step] * minElements;
+      if (n64 > maxElements) break;
+
+      GLuint n     = GLuint(n64);
+      double bytes = double(n) * sizeof(GLuint);
+      auto gbs = [&](double traffic, double ms) { return ms > 0.0 ? (traffic * bytes) / (ms * 1000000.0) : 0.0; };
+
+      double msOffsets = 0;
+      double msCombine = 0;
+      double msLookback = 0;
+      double msSegmented = 0;
+      double msCompact = 0;
+      double msRadix = 0;
+
+      if ( size_t(n) < (GLuint64)BATCH_ELEMENTS*BATCH_ELEMENTS*BATCH_ELEMENTS ){
+        msOffsets = measureMilliseconds(iterations, [&](){ scanData(n, buffers[0], buffers[1], buffers[2]); });
+        if (n > BATCH_ELEMENTS){
+          msCombine = measureMilliseconds(iterations, [&](){ combineWithOffsets(n, buffers[1], buffers[2]); });
+        }
+      }
+      if (programs.lookback){
+        useLookback = true;
+        msLookback = measureMilliseconds(iterations, [&](){ scanDataCombined(n, buffers[0], buffers[1], buffers[2]); });
+      }
+      if (programs.segmented){
+        msSegmented = measureMilliseconds(iterations, [&](){ scanDataSegmented(n, buffers[0], buffers[3], buffers[1], buffers[2]); });
+      }
+      if (programs.compact){
+        msCompact = measureMilliseconds(iterations, [&](){ compact(n, buffers[0], buffers[3], buffers[5], buffers[7], buffers[1], buffers[2]); });
+      }
+      if (programs.radixCount && programs.radixScatter){
+        // restore random keys every time, the copy is not accounted
+        auto restore = [&](){ glCopyNamedBufferSubData(buffers[8], buffers[1], 0, 0, n * sizeof(GLuint)); };
+        double msCopy = measureMilliseconds(iterations, restore);
+        msRadix = measureMilliseconds(iterations, [&](){ restore(); radixSort(n, buffers[1], buffers[4], buffers[5], buffers[6], buffers[2]); }) - msCopy;
+      }
+
+      LOGI("%u, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f\n", n,
+        gbs(2, msOffsets), gbs(2, msCombine), gbs(2, msLookback), gbs(3, msSegmented),
+        gbs(2.5, msCompact), gbs(4 * 8, msRadix));
+    }
+  }
+
+  useLookback = useLookbackOrig;
+  glDeleteBuffers(9,buffers);
+}
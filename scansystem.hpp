@@ -30,11 +30,18 @@ class ScanSystem {
 public:
   const static size_t GROUPSIZE = 512;
   const static size_t BATCH_ELEMENTS = GROUPSIZE*4;
+  const static size_t RADIX_BITS = 4;
+  const static size_t RADIX_DIGITS = 1 << RADIX_BITS;
 
   struct Programs {
     GLuint prefixsum;
     GLuint offsets;
     GLuint combine;
+    GLuint lookback;  // optional, single-pass scan
+    GLuint segmented; // single-pass segmented scan
+    GLuint compact;
+    GLuint radixCount;
+    GLuint radixScatter;
   };
 
   struct Buffer {
@@ -86,17 +93,73 @@ public:
   void init(const Programs& progs);
   void update(const Programs& progs);
 
-  void test();
+  // returns the subgroup size if scan.comp.glsl should use the
+  // KHR subgroup path, pass it as "#define SUBGROUP_SIZE n" to the programs.
+  // 0 if the NV warp shuffle path is available or KHR subgroups are
+  // not supported for compute shaders.
+  static GLuint getSubgroupSize();
+
+  // fixed checks plus randomized sizes up to maxElements (including the
+  // batch boundaries) for all primitives against the CPU reference.
+  // maxElements is run twice, the second time with a total of 2^30-1,
+  // the largest the look-back scan supports.
+  // Returns false and logs the first mismatch of a primitive.
+  bool test(GLuint maxElements = BATCH_ELEMENTS*BATCH_ELEMENTS*2, GLuint seed = 1);
+
+  // logs throughput in GB/s of every stage as CSV, for element counts
+  // in 1-2-5 steps from minElements to maxElements
+  void benchmark(GLuint minElements, GLuint maxElements, GLuint iterations = 16);
+
+  // multithreaded CPU reference of the inclusive scan,
+  // segmented if segments is provided (see scanDataSegmented)
+  static void scanReference(const GLuint* input, GLuint* output, size_t elements, const GLuint* segments = nullptr);
 
   // returns true if offsets are needed
   // the offset value needs to be added using the BATCH_ELEMENTS
   bool scanData( GLuint elements, const Buffer& input, const Buffer& output, const Buffer& offsets);
   void combineWithOffsets(GLuint elements, const Buffer& output, const Buffer& offsets);
 
+  // output is the final inclusive prefix sum, no offsets need to be added.
+  // Uses a single dispatch (decoupled look-back) if available, which has no limits
+  // on the number of elements, but the total sum must stay below 2^30.
+  // Otherwise falls back to scanData and combineWithOffsets.
+  // scratch must provide getScratchSize bytes
+  void scanDataCombined( GLuint elements, const Buffer& input, const Buffer& output, const Buffer& scratch);
+
+  // like scanDataCombined, but the sum restarts with every segment.
+  // segments provides a GLuint segment index per element, a new segment
+  // begins wherever it differs from the previous element.
+  // Single-pass, the sum must stay below 2^30 per segment.
+  // Returns false if the segmented program is not available (or useLookback
+  // is disabled), output then holds the plain scanDataCombined result and the
+  // caller subtracts the value before the first element of each segment.
+  // scratch must provide getScratchSize bytes
+  bool scanDataSegmented( GLuint elements, const Buffer& input, const Buffer& segments, const Buffer& output, const Buffer& scratch);
+
+  // keeps the input elements whose flag is 1 (flags must be 0 or 1)
+  // in their original order, count receives the number of kept elements.
+  // temp must provide elements GLuints, scratch getScratchSize bytes
+  void compact( GLuint elements, const Buffer& flags, const Buffer& input, const Buffer& output, const Buffer& count, const Buffer& temp, const Buffer& scratch);
+
+  // stable key/value sort by the lowest keyBits of the keys, RADIX_BITS per pass.
+  // keys and values are sorted in place, tempKeys and tempValues
+  // must provide elements GLuints, temp getRadixSortTempSize bytes
+  void radixSort( GLuint elements, const Buffer& keys, const Buffer& values, const Buffer& tempKeys, const Buffer& tempValues, const Buffer& temp, GLuint keyBits = 32);
+
   static size_t getOffsetSize(GLuint elements);
+  static size_t getLookbackSize(GLuint elements);
+  static size_t getScratchSize(GLuint elements);
+  static size_t getRadixSortTempSize(GLuint elements);
+
+private:
+  void testFixed();
+  void dispatchLookback( GLuint program, GLuint elements, const Buffer& input, const Buffer& output, const Buffer& scratch);
+  void dispatchGroups( GLuint groups );
 
 public:
   Programs    programs;
+  // disable to force the multi-pass scan in scanDataCombined
+  bool        useLookback;
 
   GLuint      maxGrpsPrefix;
   GLuint      maxGrpsOffsets;
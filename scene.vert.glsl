@@ -23,6 +23,7 @@
 
 #extension GL_ARB_shading_language_include : enable
 #include "common.h"
+#include "cull-common.h"
 #include "noise.glsl"
 
 in layout(location=VERTEX_POS)    vec3 pos;
@@ -49,15 +50,35 @@ mat4 getMatrix(samplerBuffer tex, int idx)
               texelFetch(tex,idx*4 + 3));
 }
 
+mat4 getMatrixRows(samplerBuffer tex, int idx)
+{
+  return transpose(mat4(texelFetch(tex,idx*3 + 0),
+                        texelFetch(tex,idx*3 + 1),
+                        texelFetch(tex,idx*3 + 2),
+                        vec4(0,0,0,1)));
+}
+
 void main()
 {
   vec3 oPos = pos;
   vec3 oNormal = normal;
   
-  vec4 wPos = getMatrix(texMatrices, matrixIndex*2+0) * vec4(oPos,1);
+#if CULLSYS_MATRIX_COMPACT
+  mat4 worldTM = getMatrixRows(texMatrices, matrixIndex);
+  // the cofactors equal the inverse-transpose scaled by the determinant,
+  // the normal is normalized in the fragment shader
+  mat3 linear  = mat3(worldTM);
+  float flip   = sign(dot(linear[0], cross(linear[1], linear[2])));
+  mat3 normalTM = mat3(cross(linear[1], linear[2]), cross(linear[2], linear[0]), cross(linear[0], linear[1])) * flip;
+#else
+  mat4 worldTM  = getMatrix(texMatrices, matrixIndex*2+0);
+  mat3 normalTM = mat3(getMatrix(texMatrices, matrixIndex*2+1));
+#endif
+  
+  vec4 wPos = worldTM * vec4(oPos,1);
   gl_Position = scene.viewProjMatrix * wPos;
   
   OUT.oPos = pos;
-  OUT.wNormal = mat3(getMatrix(texMatrices, matrixIndex*2+1)) * oNormal;
+  OUT.wNormal = normalTM * oNormal;
   OUT.color = color;
 }
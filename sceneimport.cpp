@@ -0,0 +1,698 @@
+/*
+ * Copyright (c) 2014-2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2022 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+/* Contact ckubisch@nvidia.com (Christoph Kubisch) for feedback */
+
+#include "sceneimport.hpp"
+
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+#include <glm/gtc/quaternion.hpp>
+#include <nvh/misc.hpp>
+#include <nvh/nvprint.hpp>
+
+// the implementation is compiled into nvpro_core
+#include <tiny_gltf.h>
+
+namespace sceneimport {
+
+static glm::vec4 randomColor()
+{
+  return glm::vec4(nvh::frand(), nvh::frand(), nvh::frand(), 1.0f);
+}
+
+// bboxes of all meshes starting at firstMesh
+static void computeBboxes(Scene& scene, size_t firstMesh)
+{
+  for(size_t m = firstMesh; m < scene.meshes.size(); m++)
+  {
+    Mesh& mesh   = scene.meshes[m];
+    mesh.bboxMin = glm::vec3(FLT_MAX);
+    mesh.bboxMax = glm::vec3(-FLT_MAX);
+    for(uint32_t i = 0; i < mesh.count; i++)
+    {
+      const glm::vec3& pos = scene.vertices[scene.indices[mesh.firstIndex + i]].position;
+      mesh.bboxMin         = glm::min(mesh.bboxMin, pos);
+      mesh.bboxMax         = glm::max(mesh.bboxMax, pos);
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// glTF
+
+static const unsigned char* getAccessorData(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t elementSize, size_t& stride)
+{
+  if(accessor.bufferView < 0 || accessor.sparse.isSparse)
+  {
+    return nullptr;
+  }
+
+  const tinygltf::BufferView& view   = model.bufferViews[accessor.bufferView];
+  const tinygltf::Buffer&     buffer = model.buffers[view.buffer];
+
+  int byteStride = accessor.ByteStride(view);
+  stride         = byteStride > 0 ? size_t(byteStride) : elementSize;
+
+  size_t begin = view.byteOffset + accessor.byteOffset;
+  if(accessor.count && begin + stride * (accessor.count - 1) + elementSize > buffer.data.size())
+  {
+    return nullptr;
+  }
+  return buffer.data.data() + begin;
+}
+
+static bool readVec3(const tinygltf::Model& model, int index, std::vector<glm::vec3>& values)
+{
+  if(index < 0)
+  {
+    return false;
+  }
+  const tinygltf::Accessor& accessor = model.accessors[index];
+  if(accessor.type != TINYGLTF_TYPE_VEC3 || accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT)
+  {
+    return false;
+  }
+
+  size_t               stride;
+  const unsigned char* data = getAccessorData(model, accessor, sizeof(glm::vec3), stride);
+  if(!data)
+  {
+    return false;
+  }
+
+  values.resize(accessor.count);
+  for(size_t i = 0; i < accessor.count; i++)
+  {
+    memcpy(&values[i], data + stride * i, sizeof(glm::vec3));
+  }
+  return true;
+}
+
+static bool readIndices(const tinygltf::Model& model, int index, std::vector<uint32_t>& values)
+{
+  const tinygltf::Accessor& accessor = model.accessors[index];
+
+  size_t elementSize;
+  switch(accessor.componentType)
+  {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      elementSize = 1;
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      elementSize = 2;
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+      elementSize = 4;
+      break;
+    default:
+      return false;
+  }
+
+  size_t               stride;
+  const unsigned char* data = getAccessorData(model, accessor, elementSize, stride);
+  if(!data)
+  {
+    return false;
+  }
+
+  values.resize(accessor.count);
+  for(size_t i = 0; i < accessor.count; i++)
+  {
+    const unsigned char* element = data + stride * i;
+    switch(elementSize)
+    {
+      case 1:
+        values[i] = *element;
+        break;
+      case 2:
+        values[i] = *(const uint16_t*)element;
+        break;
+      case 4:
+        values[i] = *(const uint32_t*)element;
+        break;
+    }
+  }
+  return true;
+}
+
+static glm::mat4 getNodeMatrix(const tinygltf::Node& node)
+{
+  glm::mat4 matrix(1.0f);
+  if(node.matrix.size() == 16)
+  {
+    // column-major
+    for(int i = 0; i < 16; i++)
+    {
+      matrix[i / 4][i % 4] = float(node.matrix[i]);
+    }
+    return matrix;
+  }
+
+  if(node.translation.size() == 3)
+  {
+    matrix = glm::translate(matrix, glm::vec3(float(node.translation[0]), float(node.translation[1]), float(node.translation[2])));
+  }
+  if(node.rotation.size() == 4)
+  {
+    glm::quat rotation(float(node.rotation[3]), float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2]));
+    matrix = matrix * glm::mat4_cast(rotation);
+  }
+  if(node.scale.size() == 3)
+  {
+    matrix = glm::scale(matrix, glm::vec3(float(node.scale[0]), float(node.scale[1]), float(node.scale[2])));
+  }
+  return matrix;
+}
+
+static void addNodeInstances(const tinygltf::Model& model,
+                             int                     nodeIndex,
+                             const glm::mat4&        parent,
+                             int                     parentInstance,
+                             Scene&                  scene,
+                             uint32_t                firstModel,
+                             int                     depth)
+{
+  // guards against cyclic hierarchies in broken files
+  if(depth > 256)
+  {
+    return;
+  }
+
+  const tinygltf::Node& node   = model.nodes[nodeIndex];
+  glm::mat4             matrix = parent * getNodeMatrix(node);
+
+  if(node.mesh >= 0 && scene.models[firstModel + node.mesh].numMeshes)
+  {
+    Instance instance;
+    instance.model  = firstModel + uint32_t(node.mesh);
+    instance.matrix = matrix;
+    instance.parent = parentInstance;
+    parentInstance  = int(scene.instances.size());
+    scene.instances.push_back(instance);
+  }
+
+  for(int child : node.children)
+  {
+    addNodeInstances(model, child, matrix, parentInstance, scene, firstModel, depth + 1);
+  }
+}
+
+bool loadGLTF(const char* filename, Scene& scene)
+{
+  tinygltf::Model    model;
+  tinygltf::TinyGLTF loader;
+  std::string        err;
+  std::string        warn;
+
+  std::string name   = filename;
+  bool        binary = name.size() > 4 && name.compare(name.size() - 4, 4, ".glb") == 0;
+  bool        loaded = binary ? loader.LoadBinaryFromFile(&model, &err, &warn, name) : loader.LoadASCIIFromFile(&model, &err, &warn, name);
+
+  if(!warn.empty())
+  {
+    LOGW("scene import: %s\n", warn.c_str());
+  }
+  if(!loaded)
+  {
+    LOGE("scene import: could not load %s %s\n", filename, err.c_str());
+    return false;
+  }
+
+  uint32_t firstModel = uint32_t(scene.models.size());
+  size_t   firstMesh  = scene.meshes.size();
+
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<uint32_t>  indices;
+
+  // every primitive becomes a mesh, every gltf mesh a model
+  for(const tinygltf::Mesh& gltfMesh : model.meshes)
+  {
+    Model sceneModel;
+    sceneModel.firstMesh = uint32_t(scene.meshes.size());
+    sceneModel.numMeshes = 0;
+
+    for(const tinygltf::Primitive& primitive : gltfMesh.primitives)
+    {
+      auto position = primitive.attributes.find("POSITION");
+      if(primitive.mode != TINYGLTF_MODE_TRIANGLES || position == primitive.attributes.end()
+         || !readVec3(model, position->second, positions))
+      {
+        continue;
+      }
+
+      auto normal     = primitive.attributes.find("NORMAL");
+      bool hasNormals = normal != primitive.attributes.end() && readVec3(model, normal->second, normals)
+                        && normals.size() == positions.size();
+
+      if(primitive.indices >= 0)
+      {
+        if(!readIndices(model, primitive.indices, indices))
+        {
+          continue;
+        }
+      }
+      else
+      {
+        indices.resize(positions.size());
+        for(size_t i = 0; i < indices.size(); i++)
+        {
+          indices[i] = uint32_t(i);
+        }
+      }
+
+      glm::vec4 color = randomColor();
+      if(primitive.material >= 0)
+      {
+        const std::vector<double>& factor = model.materials[primitive.material].pbrMetallicRoughness.baseColorFactor;
+        if(factor.size() == 4)
+        {
+          color = glm::vec4(float(factor[0]), float(factor[1]), float(factor[2]), 1.0f);
+        }
+      }
+
+      uint32_t firstVertex = uint32_t(scene.vertices.size());
+      for(size_t i = 0; i < positions.size(); i++)
+      {
+        Vertex vertex;
+        vertex.position = positions[i];
+        vertex.normal   = hasNormals ? normals[i] : glm::vec3(0, 1, 0);
+        vertex.color    = color;
+        scene.vertices.push_back(vertex);
+      }
+
+      Mesh mesh;
+      mesh.firstIndex = uint32_t(scene.indices.size());
+      for(size_t i = 0; i + 2 < indices.size(); i += 3)
+      {
+        if(indices[i] >= positions.size() || indices[i + 1] >= positions.size() || indices[i + 2] >= positions.size())
+        {
+          continue;
+        }
+        scene.indices.push_back(firstVertex + indices[i]);
+        scene.indices.push_back(firstVertex + indices[i + 1]);
+        scene.indices.push_back(firstVertex + indices[i + 2]);
+      }
+      mesh.count = uint32_t(scene.indices.size()) - mesh.firstIndex;
+      if(!mesh.count)
+      {
+        continue;
+      }
+
+      scene.meshes.push_back(mesh);
+      sceneModel.numMeshes++;
+    }
+
+    scene.models.push_back(sceneModel);
+  }
+
+  computeBboxes(scene, firstMesh);
+
+  int sceneIndex = model.defaultScene >= 0 ? model.defaultScene : 0;
+  if(sceneIndex < int(model.scenes.size()))
+  {
+    for(int node : model.scenes[sceneIndex].nodes)
+    {
+      addNodeInstances(model, node, glm::mat4(1.0f), -1, scene, firstModel, 0);
+    }
+  }
+  else
+  {
+    // no node hierarchy, place every mesh once
+    for(uint32_t m = firstModel; m < uint32_t(scene.models.size()); m++)
+    {
+      if(scene.models[m].numMeshes)
+      {
+        Instance instance;
+        instance.model  = m;
+        instance.matrix = glm::mat4(1.0f);
+        scene.instances.push_back(instance);
+      }
+    }
+  }
+
+  LOGI("scene import: %s, %zu models, %zu meshes, %zu instances\n", filename, scene.models.size() - firstModel,
+       scene.meshes.size() - firstMesh, scene.instances.size());
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// OBJ
+
+// resolves 1-based or negative (relative) obj indices, -1 if invalid
+static int64_t objIndex(long index, size_t count)
+{
+  if(index > 0 && size_t(index) <= count)
+  {
+    return index - 1;
+  }
+  if(index < 0 && size_t(-index) <= count)
+  {
+    return int64_t(count) + index;
+  }
+  return -1;
+}
+
+bool loadOBJ(const char* filename, Scene& scene)
+{
+  FILE* file = fopen(filename, "rt");
+  if(!file)
+  {
+    LOGE("scene import: could not open %s\n", filename);
+    return false;
+  }
+
+  uint32_t firstModel  = uint32_t(scene.models.size());
+  size_t   firstMesh   = scene.meshes.size();
+  size_t   firstVertex = scene.vertices.size();
+
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<bool>      missingNormal;  // per vertex of this file
+
+  // vertices are shared per unique position/normal pair within a mesh
+  std::unordered_map<uint64_t, uint32_t> corners;
+  std::vector<uint32_t>                  polygon;
+
+  glm::vec4 color;
+  bool      meshOpen = false;
+
+  auto closeMesh = [&]() {
+    if(meshOpen)
+    {
+      scene.meshes.back().count = uint32_t(scene.indices.size()) - scene.meshes.back().firstIndex;
+      meshOpen                  = false;
+    }
+  };
+  auto beginModel = [&]() {
+    closeMesh();
+    if(scene.models.size() == firstModel || scene.models.back().numMeshes)
+    {
+      Model model;
+      model.firstMesh = uint32_t(scene.meshes.size());
+      model.numMeshes = 0;
+      scene.models.push_back(model);
+    }
+  };
+
+  beginModel();
+
+  char line[4096];
+  while(fgets(line, sizeof(line), file))
+  {
+    const char* str = line;
+    while(*str == ' ' || *str == '\t')
+    {
+      str++;
+    }
+
+    if(str[0] == 'v' && str[1] == ' ')
+    {
+      glm::vec3 pos(0);
+      sscanf(str + 2, "%f %f %f", &pos.x, &pos.y, &pos.z);
+      positions.push_back(pos);
+    }
+    else if(str[0] == 'v' && str[1] == 'n' && str[2] == ' ')
+    {
+      glm::vec3 normal(0);
+      sscanf(str + 3, "%f %f %f", &normal.x, &normal.y, &normal.z);
+      normals.push_back(normal);
+    }
+    else if((str[0] == 'o' || str[0] == 'g') && (str[1] == ' ' || str[1] == '\n' || str[1] == '\r'))
+    {
+      beginModel();
+    }
+    else if(strncmp(str, "usemtl", 6) == 0)
+    {
+      closeMesh();
+    }
+    else if(str[0] == 'f' && str[1] == ' ')
+    {
+      polygon.clear();
+
+      char* cur = (char*)str + 2;
+      while(true)
+      {
+        char* end;
+        long  p = strtol(cur, &end, 10);
+        if(end == cur)
+        {
+          break;
+        }
+        cur    = end;
+        long n = 0;
+        if(*cur == '/')
+        {
+          cur++;
+          strtol(cur, &end, 10);  // texcoord
+          cur = end;
+          if(*cur == '/')
+          {
+            cur++;
+            n   = strtol(cur, &end, 10);
+            cur = end;
+          }
+        }
+
+        int64_t pos    = objIndex(p, positions.size());
+        int64_t normal = objIndex(n, normals.size());
+        if(pos < 0)
+        {
+          polygon.clear();
+          break;
+        }
+
+        if(!meshOpen)
+        {
+          Mesh mesh;
+          mesh.firstIndex = uint32_t(scene.indices.size());
+          mesh.count      = 0;
+          scene.meshes.push_back(mesh);
+          scene.models.back().numMeshes++;
+          corners.clear();
+          color    = randomColor();
+          meshOpen = true;
+        }
+
+        uint64_t key    = (uint64_t(pos) << 32) | uint64_t(normal + 1);
+        auto     corner = corners.find(key);
+        if(corner == corners.end())
+        {
+          Vertex vertex;
+          vertex.position = positions[pos];
+          vertex.normal   = normal >= 0 ? normals[normal] : glm::vec3(0);
+          vertex.color    = color;
+          corner          = corners.insert({key, uint32_t(scene.vertices.size())}).first;
+          scene.vertices.push_back(vertex);
+          missingNormal.push_back(normal < 0);
+        }
+        polygon.push_back(corner->second);
+      }
+
+      // triangle fan
+      for(size_t i = 2; i < polygon.size(); i++)
+      {
+        scene.indices.push_back(polygon[0]);
+        scene.indices.push_back(polygon[i - 1]);
+        scene.indices.push_back(polygon[i]);
+      }
+    }
+  }
+  fclose(file);
+
+  closeMesh();
+  if(scene.models.size() > firstModel && !scene.models.back().numMeshes)
+  {
+    scene.models.pop_back();
+  }
+
+  // corners without normals get the average of their faces
+  for(size_t m = firstMesh; m < scene.meshes.size(); m++)
+  {
+    const Mesh& mesh = scene.meshes[m];
+    for(uint32_t i = 0; i + 2 < mesh.count; i += 3)
+    {
+      const uint32_t* tri = &scene.indices[mesh.firstIndex + i];
+      glm::vec3 normal = glm::cross(scene.vertices[tri[1]].position - scene.vertices[tri[0]].position,
+                                    scene.vertices[tri[2]].position - scene.vertices[tri[0]].position);
+      for(int c = 0; c < 3; c++)
+      {
+        if(missingNormal[tri[c] - firstVertex])
+        {
+          scene.vertices[tri[c]].normal += normal;
+        }
+      }
+    }
+  }
+  for(size_t v = firstVertex; v < scene.vertices.size(); v++)
+  {
+    glm::vec3& normal = scene.vertices[v].normal;
+    if(missingNormal[v - firstVertex])
+    {
+      normal = glm::length(normal) > 0 ? glm::normalize(normal) : glm::vec3(0, 1, 0);
+    }
+  }
+
+  computeBboxes(scene, firstMesh);
+
+  for(uint32_t m = firstModel; m < uint32_t(scene.models.size()); m++)
+  {
+    Instance instance;
+    instance.model  = m;
+    instance.matrix = glm::mat4(1.0f);
+    scene.instances.push_back(instance);
+  }
+
+  LOGI("scene import: %s, %zu models, %zu meshes\n", filename, scene.models.size() - firstModel, scene.meshes.size() - firstMesh);
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// instance table
+
+bool loadInstancesCSV(const char* filename, Scene& scene)
+{
+  FILE* file = fopen(filename, "rt");
+  if(!file)
+  {
+    LOGE("scene import: could not open %s\n", filename);
+    return false;
+  }
+
+  std::vector<Instance> instances;
+
+  char   line[4096];
+  int    lineNumber = 0;
+  size_t invalid    = 0;
+  while(fgets(line, sizeof(line), file))
+  {
+    lineNumber++;
+
+    double values[13];
+    int    numValues = 0;
+    char*  cur       = line;
+    while(numValues < 13)
+    {
+      while(*cur == ' ' || *cur == '\t')
+      {
+        cur++;
+      }
+      char*  end;
+      double value = strtod(cur, &end);
+      if(end == cur)
+      {
+        break;
+      }
+      values[numValues++] = value;
+      cur                 = end;
+      while(*cur == ' ' || *cur == '\t')
+      {
+        cur++;
+      }
+      if(*cur != ',')
+      {
+        break;
+      }
+      cur++;
+    }
+
+    // empty, comment or header
+    if(numValues == 0)
+    {
+      continue;
+    }
+
+    Instance instance;
+    instance.model = uint32_t(values[0]);
+    if(values[0] < 0 || instance.model >= scene.models.size() || !(numValues == 4 || numValues == 5 || numValues == 13))
+    {
+      if(!invalid)
+      {
+        LOGW("scene import: %s line %d is not a valid instance\n", filename, lineNumber);
+      }
+      invalid++;
+      continue;
+    }
+
+    instance.matrix = glm::mat4(1.0f);
+    if(numValues == 13)
+    {
+      for(int r = 0; r < 3; r++)
+      {
+        for(int c = 0; c < 4; c++)
+        {
+          instance.matrix[c][r] = float(values[1 + r * 4 + c]);
+        }
+      }
+    }
+    else
+    {
+      instance.matrix[3] = glm::vec4(float(values[1]), float(values[2]), float(values[3]), 1.0f);
+      if(numValues == 5)
+      {
+        instance.matrix = glm::scale(instance.matrix, glm::vec3(float(values[4])));
+      }
+    }
+
+    instances.push_back(instance);
+  }
+  fclose(file);
+
+  if(invalid)
+  {
+    LOGW("scene import: %s skipped %zu invalid lines\n", filename, invalid);
+  }
+
+  scene.instances = std::move(instances);
+  LOGI("scene import: %s, %zu instances\n", filename, scene.instances.size());
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void getBounds(const Scene& scene, glm::vec3& min, glm::vec3& max)
+{
+  min = glm::vec3(FLT_MAX);
+  max = glm::vec3(-FLT_MAX);
+  for(const Instance& instance : scene.instances)
+  {
+    const Model& model = scene.models[instance.model];
+    for(uint32_t m = model.firstMesh; m < model.firstMesh + model.numMeshes; m++)
+    {
+      const Mesh& mesh = scene.meshes[m];
+      for(int c = 0; c < 8; c++)
+      {
+        glm::vec4 corner((c & 1) ? mesh.bboxMax.x : mesh.bboxMin.x, (c & 2) ? mesh.bboxMax.y : mesh.bboxMin.y,
+                         (c & 4) ? mesh.bboxMax.z : mesh.bboxMin.z, 1.0f);
+        glm::vec3 pos = glm::vec3(instance.matrix * corner);
+        min           = glm::min(min, pos);
+        max           = glm::max(max, pos);
+      }
+    }
+  }
+}
+
+}  // namespace sceneimport
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2014-2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2022 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+/* Contact ckubisch@nvidia.com (Christoph Kubisch) for feedback */
+
+#ifndef SCENEIMPORT_H__
+#define SCENEIMPORT_H__
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Loads meshes and their instances from files, so culling can be
+// evaluated on real depth complexity rather than the procedural grid.
+namespace sceneimport {
+
+struct Vertex
+{
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec4 color;
+};
+
+// one drawcall worth of triangles
+struct Mesh
+{
+  uint32_t  firstIndex;  // into Scene::indices
+  uint32_t  count;
+  glm::vec3 bboxMin;
+  glm::vec3 bboxMax;
+};
+
+// what instances refer to: a glTF mesh or an obj object/group,
+// made of one mesh per material
+struct Model
+{
+  uint32_t firstMesh;
+  uint32_t numMeshes;
+};
+
+struct Instance
+{
+  uint32_t  model;
+  glm::mat4 matrix;       // world space
+  int       parent = -1;  // instance of the closest ancestor node with a mesh
+};
+
+struct Scene
+{
+  std::vector<Vertex>   vertices;
+  std::vector<uint32_t> indices;  // triangle lists, absolute vertex indices
+  std::vector<Mesh>     meshes;
+  std::vector<Model>    models;
+  std::vector<Instance> instances;
+};
+
+// .gltf or .glb, every node with a mesh becomes an instance
+bool loadGLTF(const char* filename, Scene& scene);
+
+// every object or group becomes a model with one instance
+bool loadOBJ(const char* filename, Scene& scene);
+
+// replaces the instances with the rows of the table, one per line:
+//   model, x, y, z           translation
+//   model, x, y, z, scale    translation and uniform scale
+//   model, 12 values         row-major 3x4 matrix
+// empty lines, '#' comments and a header line are skipped
+bool loadInstancesCSV(const char* filename, Scene& scene);
+
+// world-space bounds of all instances
+void getBounds(const Scene& scene, glm::vec3& min, glm::vec3& max);
+
+}  // namespace sceneimport
+
+#endif
@@ -11,7 +11,7 @@ do
   
   local drawmodes = 4
   local results = 3
-  local methods = 3
+  local methods = 4
   
   -- functional
   for m=0,methods-1 do
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2014-2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2022 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+/* Contact ckubisch@nvidia.com (Christoph Kubisch) for feedback */
+
+#include "threadpool.hpp"
+
+static thread_local bool s_inTask = false;
+
+ThreadPool& ThreadPool::get()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool::ThreadPool()
+{
+  uint32_t numWorkers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+  for(uint32_t t = 0; t < numWorkers; t++)
+  {
+    m_threads.push_back(std::thread(&ThreadPool::workerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_quit = true;
+  }
+  m_wake.notify_all();
+  for(std::thread& thread : m_threads)
+  {
+    thread.join();
+  }
+}
+
+size_t ThreadPool::work(const std::function<void(size_t)>& fn, size_t numTasks)
+{
+  bool   wasInTask = s_inTask;
+  size_t done      = 0;
+  s_inTask         = true;
+  for(size_t task = m_next++; task < numTasks; task = m_next++)
+  {
+    fn(task);
+    done++;
+  }
+  s_inTask = wasInTask;
+  return done;
+}
+
+void ThreadPool::workerLoop()
+{
+  uint64_t generation = 0;
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(true)
+  {
+    m_wake.wait(lock, [&] { return m_quit || m_generation != generation; });
+    if(m_quit)
+    {
+      return;
+    }
+    generation = m_generation;
+
+    // a late wake-up finds the tasks taken and does nothing
+    const std::function<void(size_t)>* fn       = m_fn;
+    size_t                             numTasks = m_numTasks;
+    m_active++;
+    lock.unlock();
+
+    size_t done = fn ? work(*fn, numTasks) : 0;
+
+    lock.lock();
+    m_done += done;
+    m_active--;
+    if(m_done == m_numTasks && !m_active)
+    {
+      m_finished.notify_one();
+    }
+  }
+}
+
+void ThreadPool::run(size_t numTasks, const std::function<void(size_t)>& fn)
+{
+  if(numTasks <= 1 || m_threads.empty() || s_inTask)
+  {
+    for(size_t task = 0; task < numTasks; task++)
+    {
+      fn(task);
+    }
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_fn       = &fn;
+  m_numTasks = numTasks;
+  m_done     = 0;
+  m_next     = 0;
+  m_generation++;
+  lock.unlock();
+  m_wake.notify_all();
+
+  size_t done = work(fn, numTasks);
+
+  lock.lock();
+  m_done += done;
+  // workers still inside work could otherwise see the next run's tasks
+  m_finished.wait(lock, [&] { return m_done == m_numTasks && !m_active; });
+  m_fn = nullptr;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2014-2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2022 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+/* Contact ckubisch@nvidia.com (Christoph Kubisch) for feedback */
+
+#ifndef THREADPOOL_H__
+#define THREADPOOL_H__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+  /*
+    Persistent worker threads for the data-parallel loops on the host:
+    matrix animation, token stream generation and the scan reference.
+
+    The workers are started on first use and wait on a condition
+    variable in between, so a loop costs a wake-up instead of creating
+    and joining threads. The calling thread works on the tasks as well.
+
+    run is meant for one thread at a time. Calls from within a task run
+    serially on the calling thread instead of deadlocking.
+  */
+
+public:
+  static ThreadPool& get();
+
+  // workers plus the calling thread
+  uint32_t getNumThreads() const { return uint32_t(m_threads.size()) + 1; }
+
+  // calls fn(task) for every task in [0, numTasks), returns once all are done
+  void run(size_t numTasks, const std::function<void(size_t)>& fn);
+
+  // splits [0, count) into at most getNumThreads() ranges of at least
+  // minPerThread elements and calls fn(begin, end) for each
+  template <class F>
+  void parallelFor(size_t count, size_t minPerThread, const F& fn)
+  {
+    size_t numTasks = std::max(std::min(size_t(getNumThreads()), count / std::max(minPerThread, size_t(1))), size_t(1));
+    size_t perTask  = (count + numTasks - 1) / numTasks;
+    run(numTasks, [&](size_t task) {
+      size_t begin = std::min(perTask * task, count);
+      size_t end   = std::min(begin + perTask, count);
+      if(begin < end)
+      {
+        fn(begin, end);
+      }
+    });
+  }
+
+  ~ThreadPool();
+
+private:
+  ThreadPool();
+
+  void   workerLoop();
+  size_t work(const std::function<void(size_t)>& fn, size_t numTasks);
+
+  std::vector<std::thread> m_threads;
+  std::mutex               m_mutex;
+  std::condition_variable  m_wake;
+  std::condition_variable  m_finished;
+  bool                     m_quit       = false;
+  uint64_t                 m_generation = 0;
+
+  // current run, changed only while no worker is active
+  const std::function<void(size_t)>* m_fn       = nullptr;
+  size_t                             m_numTasks = 0;
+  size_t                             m_done     = 0;
+  uint32_t                           m_active   = 0;
+  std::atomic<size_t>                m_next{0};
+};
+
+#endif
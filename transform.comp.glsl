@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2014-2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2022 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+
+#version 430
+#extension GL_ARB_shading_language_include : enable
+#include "common.h"
+#include "cull-common.h"
+
+layout(local_size_x=TRANSFORM_THREADS) in;
+
+// one dispatch per hierarchy level, parents are always
+// written by an earlier dispatch
+layout(location=0) uniform uint  firstOrder;
+layout(location=1) uniform uint  numObjects;
+layout(location=2) uniform mat4  rootMatrix;
+layout(location=3) uniform float spinAngle;
+
+layout(std430,binding=TRANSFORM_SSBO_OBJECTS) readonly buffer objectsBuffer {
+  TransformObject objects[];
+};
+
+layout(std430,binding=TRANSFORM_SSBO_ORDER) readonly buffer orderBuffer {
+  uint order[];
+};
+
+layout(std430,binding=TRANSFORM_SSBO_MATRICES) buffer matricesBuffer {
+  MatrixData matrices[];
+};
+
+
+void main ()
+{
+  if (gl_GlobalInvocationID.x >= numObjects) return;
+  
+  uint obj = order[firstOrder + gl_GlobalInvocationID.x];
+  TransformObject object = objects[obj];
+  
+  mat4 local = transpose(mat4(object.rows[0], object.rows[1], object.rows[2], vec4(0,0,0,1)));
+  
+  float angle = spinAngle * object.spin;
+  if (angle != 0.0){
+    float c = cos(angle);
+    float s = sin(angle);
+    local = local * mat4(c,0,-s,0, 0,1,0,0, s,0,c,0, 0,0,0,1);
+  }
+  
+  mat4 world = (object.parent >= 0 ? getWorldTM(matrices[object.parent]) : rootMatrix) * local;
+  
+  // adds the inverse-transpose unless CULLSYS_MATRIX_COMPACT
+  matrices[obj] = makeMatrixData(world);
+}
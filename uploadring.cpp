@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2014-2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2022 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+/* Contact ckubisch@nvidia.com (Christoph Kubisch) for feedback */
+
+#include "uploadring.hpp"
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+#include <nvh/nvprint.hpp>
+
+void UploadRing::init(size_t frameSize, size_t maxFrameSize)
+{
+  m_maxFrameSize = std::max(frameSize, maxFrameSize);
+  if(!create(frameSize))
+  {
+    LOGW("upload ring: could not map %zu bytes, using buffer updates\n", frameSize * FRAMES);
+  }
+}
+
+void UploadRing::setMaxFrameSize(size_t maxFrameSize)
+{
+  if(!m_growFailed)
+  {
+    m_maxFrameSize = std::max(m_maxFrameSize, maxFrameSize);
+  }
+}
+
+void UploadRing::deinit()
+{
+  destroy();
+}
+
+bool UploadRing::create(size_t frameSize)
+{
+  m_frameSize = frameSize;
+  m_used      = 0;
+  m_required  = 0;
+  m_frame     = 0;
+
+  glCreateBuffers(1, &m_buffer);
+  glNamedBufferStorage(m_buffer, m_frameSize * FRAMES, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+  // fails as well if the storage could not be allocated
+  m_mapping = (uint8_t*)glMapNamedBufferRange(m_buffer, 0, m_frameSize * FRAMES,
+                                              GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+  if(!m_mapping)
+  {
+    // no ring, every alloc fails
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer    = 0;
+    m_frameSize = 0;
+    return false;
+  }
+  return true;
+}
+
+void UploadRing::destroy()
+{
+  for(int i = 0; i < FRAMES; i++)
+  {
+    if(m_fences[i])
+    {
+      glClientWaitSync(m_fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+      glDeleteSync(m_fences[i]);
+      m_fences[i] = nullptr;
+    }
+  }
+  if(m_mapping)
+  {
+    glUnmapNamedBuffer(m_buffer);
+    glDeleteBuffers(1, &m_buffer);
+  }
+  m_buffer  = 0;
+  m_mapping = nullptr;
+}
+
+void UploadRing::beginFrame()
+{
+  // grow to the peak demand, leaving some headroom
+  size_t frameSize = std::min(m_required + m_required / 4, m_maxFrameSize);
+  if(m_required > m_frameSize && frameSize > m_frameSize)
+  {
+    size_t previous = m_frameSize;
+    destroy();
+    if(!create(frameSize))
+    {
+      // stay at the previous size and stop growing
+      LOGW("upload ring: could not grow to %zu bytes\n", frameSize * FRAMES);
+      m_maxFrameSize = previous;
+      m_growFailed   = true;
+      if(previous)
+      {
+        create(previous);
+      }
+    }
+  }
+
+  m_frame = (m_frame + 1) % FRAMES;
+  if(m_fences[m_frame])
+  {
+    glClientWaitSync(m_fences[m_frame], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(m_fences[m_frame]);
+    m_fences[m_frame] = nullptr;
+  }
+  m_used     = 0;
+  m_required = 0;
+}
+
+void UploadRing::endFrame()
+{
+  assert(!m_fences[m_frame]);
+  m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void* UploadRing::alloc(size_t size, size_t alignment, size_t& offset)
+{
+  // upper bound, so the slots can grow to fit everything next time
+  m_required += size + alignment - 1;
+
+  size_t begin = (m_used + alignment - 1) / alignment * alignment;
+  if(!m_mapping || begin + size > m_frameSize)
+  {
+    return nullptr;
+  }
+
+  m_used = begin + size;
+  offset = m_frameSize * m_frame + begin;
+  return m_mapping + offset;
+}
+
+void UploadRing::upload(GLuint buffer, size_t offset, size_t size, const void* data)
+{
+  size_t ringOffset;
+  void*  ringData = alloc(size, 16, ringOffset);
+  if(ringData)
+  {
+    memcpy(ringData, data, size);
+    glCopyNamedBufferSubData(m_buffer, buffer, ringOffset, offset, size);
+  }
+  else
+  {
+    glNamedBufferSubData(buffer, offset, size, data);
+  }
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2014-2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2022 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+/* Contact ckubisch@nvidia.com (Christoph Kubisch) for feedback */
+
+#ifndef UPLOADRING_H__
+#define UPLOADRING_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <nvgl/extensions_gl.hpp>
+
+class UploadRing
+{
+  /*
+    Staging memory for data that changes every frame, shared by
+    the sample and the CullingSystem.
+
+    One persistently mapped buffer is split into FRAMES slots, the slot
+    of the current frame is sub-allocated linearly. beginFrame waits for
+    the fence of the frame that last used the slot, so writes never
+    stall on implicit synchronization.
+
+    The application writes into the returned pointer and then either
+    binds (buffer, offset) directly with glBindBufferRange, or copies
+    from it into the destination buffer on the GPU. Allocations that
+    do not fit return nullptr, the caller then falls back to a regular
+    buffer update, and the slots grow to the peak demand at the next
+    beginFrame, up to maxFrameSize. Larger frames keep using the
+    fallback for what does not fit. A grown ring has a new buffer, so
+    getBuffer must be queried after every alloc. If the buffer cannot be
+    created or mapped there is no ring and every alloc fails.
+  */
+
+public:
+  static const int    FRAMES         = 3;
+  static const size_t MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+  void init(size_t frameSize, size_t maxFrameSize = MAX_FRAME_SIZE);
+  void deinit();
+
+  // raises the growth limit, for example to the per-frame uploads of
+  // a scene, ignored once growing failed
+  void setMaxFrameSize(size_t maxFrameSize);
+
+  void beginFrame();
+  void endFrame();
+
+  // returns nullptr if the current frame has no space left
+  void* alloc(size_t size, size_t alignment, size_t& offset);
+
+  // copies data into the ring and from there into buffer,
+  // glNamedBufferSubData if the frame has no space left
+  void upload(GLuint buffer, size_t offset, size_t size, const void* data);
+
+  GLuint getBuffer() const { return m_buffer; }
+  size_t getSize() const { return m_frameSize * FRAMES; }
+
+private:
+  bool create(size_t frameSize);
+  void destroy();
+
+  GLuint   m_buffer       = 0;
+  uint8_t* m_mapping      = nullptr;
+  size_t   m_frameSize    = 0;
+  size_t   m_maxFrameSize = 0;
+  bool     m_growFailed   = false;
+  size_t   m_used         = 0;
+  size_t   m_required     = 0;  // peak demand, including failed allocations
+  int      m_frame        = 0;
+  GLsync   m_fences[FRAMES] = {};
+};
+
+#endif